@@ -45,6 +45,8 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+/* Upper half of the run time stats counter. TIM3 is 16-bit only */
+static volatile uint32_t runTimeCounterHigh;
 
 /* USER CODE END Variables */
 /* Definitions for AppTask */
@@ -64,6 +66,67 @@ void app_task(void *argument);
 
 void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
 
+/* Hook prototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
+
+/* USER CODE BEGIN 1 */
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+
+/**
+  * @brief  Start TIM3 as 1 MHz free running counter for the run time stats.
+  *         The counter is extended to 32 bits by the update interrupt
+  */
+void configureTimerForRunTimeStats(void)
+{
+  __HAL_RCC_TIM3_CLK_ENABLE();
+
+  TIM3->PSC = SystemCoreClock / 1000000U - 1U;
+  TIM3->ARR = 0xFFFFU;
+  TIM3->EGR = TIM_EGR_UG;
+  TIM3->SR = 0U;
+  TIM3->DIER = TIM_DIER_UIE;
+
+  HAL_NVIC_SetPriority(TIM3_IRQn, 3, 0);
+  HAL_NVIC_EnableIRQ(TIM3_IRQn);
+
+  TIM3->CR1 = TIM_CR1_CEN;
+}
+
+/**
+  * @brief  Get the run time stats counter value
+  * @retval Microseconds since the scheduler start
+  */
+unsigned long getRunTimeCounterValue(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t high = runTimeCounterHigh;
+  uint32_t low = TIM3->CNT;
+
+  if ((TIM3->SR & TIM_SR_UIF) != 0U)
+  {
+    /* The overflow is not handled yet */
+    low = TIM3->CNT;
+    high += 0x10000U;
+  }
+
+  __set_PRIMASK(primask);
+
+  return high | low;
+}
+
+/**
+  * @brief This function handles TIM3 global interrupt.
+  */
+void TIM3_IRQHandler(void)
+{
+  TIM3->SR = (uint32_t)~TIM_SR_UIF;
+  runTimeCounterHigh += 0x10000U;
+}
+/* USER CODE END 1 */
+
 /**
   * @brief  FreeRTOS initialization
   * @param  None
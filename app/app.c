@@ -7,6 +7,7 @@
 #include "cmsis_os.h"
 
 #include "uart-spi.h"
+#include "uart-spi-config.h"
 
 // ============================================================================
 
@@ -30,6 +31,13 @@ static int app_init(void)
 {
     int result;
 
+    // Boot straight into the saved configuration. The built-in one is used otherwise
+    uart_spi_tunables_t tunables;
+
+    if (uart_spi_config_load(&tunables) == 0) {
+        uart_spi_tunables_set(&tunables);
+    }
+
     uart_spi_params_t uart_spi_params = {
         .huart = &huart1,
         .hspi = &hspi1
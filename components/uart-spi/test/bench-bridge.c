@@ -0,0 +1,180 @@
+/**
+ * @file bench-bridge.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host cost of the whole bridge on the simulation, built generic and
+ * specialised (see the Makefile), as the proxy of the target cycles.
+ *
+ * The strings are forwarded in each direction with the silent slave. The
+ * figure is the process CPU time per forwarded byte, the minimum of several
+ * runs. It includes the simulation: the thread handoffs of the task
+ * switches cost about the same in both builds, so only the difference
+ * between the builds is meaningful. The target cost is measured on the
+ * board (see README "Compile-time specialisation").
+ */
+
+#include "bench.h"
+
+#include "sim.h"
+
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "cmsis_os.h"
+
+#include <string.h>
+
+// ============================================================================
+
+#define BENCH_BYTES         (64 * 1024)
+#define STRING_LENGTH       100
+#define RUNS                5
+
+// Sent at once, within the simulated line buffers
+#define BATCH_BYTES         (16 * 1024)
+
+#define UART_BAUD           2000000
+
+// ============================================================================
+
+typedef enum {
+    CASE_UART_TO_SPI = 0,
+    CASE_SPI_TO_UART,
+    CASE_COUNT
+} bench_case_t;
+
+static const char *case_names[CASE_COUNT] = {
+    "uart-to-spi",
+    "spi-to-uart",
+};
+
+// ============================================================================
+
+static uint8_t line_buff[BATCH_BYTES];
+
+static double best_ns[CASE_COUNT];
+
+// ============================================================================
+
+/**
+ * @brief Get the CPU time of all the process threads in seconds
+ *
+ */
+static double cpu_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Forward one batch of the strings in one direction and wait until it is delivered
+ *
+ * @return The number of the delivered bytes
+ */
+static size_t batch_run(bench_case_t bench_case)
+{
+    uint8_t string[STRING_LENGTH];
+
+    memset(string, 'a', sizeof(string) - 1);
+    string[sizeof(string) - 1] = '\0';
+
+    for (size_t sent = 0; sent + sizeof(string) <= BATCH_BYTES; sent += sizeof(string)) {
+        if (bench_case == CASE_UART_TO_SPI) {
+            sim_uart_send(string, sizeof(string));
+        }
+        else {
+            sim_spi_slave_send(string, sizeof(string));
+        }
+    }
+
+    // The '\0' are not counted: the slave drops them on MOSI
+    size_t expected = BATCH_BYTES / sizeof(string) * (sizeof(string) - 1);
+    size_t received = 0;
+
+    while (received < expected) {
+        osDelay(10);
+
+        size_t length = 0;
+
+        do {
+            length = bench_case == CASE_UART_TO_SPI ?
+                     sim_spi_slave_receive(line_buff, sizeof(line_buff)) :
+                     sim_uart_receive(line_buff, sizeof(line_buff));
+
+            for (size_t q = 0; q < length; q++) {
+                received += line_buff[q] != 0;
+            }
+        } while (length > 0);
+    }
+
+    return received;
+}
+
+/**
+ * @brief Forward the strings in one direction
+ *
+ * @return The CPU time per byte in nanoseconds
+ */
+static double case_run(bench_case_t bench_case)
+{
+    size_t received = 0;
+    double start = cpu_now();
+
+    for (size_t batch = 0; batch < BENCH_BYTES / BATCH_BYTES; batch++) {
+        received += batch_run(bench_case);
+    }
+
+    return (cpu_now() - start) * 1e9 / received;
+}
+
+static void bench_main(void *arg)
+{
+    (void)arg;
+
+    uart_spi_params_t params = {
+        .huart = &huart1,
+        .hspi = &hspi1,
+    };
+
+    uart_spi_tunables_t tunables;
+    uart_spi_tunables_get(&tunables);
+    tunables.uart_baud = UART_BAUD;
+    uart_spi_tunables_set(&tunables);
+
+    sim_spi_slave_set(SIM_SLAVE_SILENT);
+
+    if (uart_spi_start(&params) != 0) {
+        printf("start failed\n");
+        return;
+    }
+
+    for (int run = 0; run < RUNS; run++) {
+        for (int q = 0; q < CASE_COUNT; q++) {
+            double ns = case_run(q);
+
+            if (run == 0 || ns < best_ns[q]) {
+                best_ns[q] = ns;
+            }
+        }
+    }
+
+    uart_spi_stop(100);
+}
+
+int main(void)
+{
+    if (sim_run(bench_main, NULL, 0) != 0) {
+        printf("the simulation failed\n");
+        return 1;
+    }
+
+    for (int q = 0; q < CASE_COUNT; q++) {
+        printf("%-32s %8.1f ns/byte CPU\n", case_names[q], best_ns[q]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file bench-miso.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host throughput of the MISO string filter of the plain path and of the
+ * per-byte classifier of the CRC path, on the idle, the string and the
+ * dense streams.
+ *
+ * The host figures compare the two only; the target cost per byte is
+ * measured by the bridge load statistics.
+ */
+
+#include "bench.h"
+
+#include "uart-spi-miso.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define BUFF_SIZE           4096
+#define BENCH_BYTES         (256u * 1024 * 1024)
+
+// ============================================================================
+
+static volatile size_t sink;
+
+static void bench_stream(const char *name, const uint8_t *in);
+
+// ============================================================================
+
+int main(void)
+{
+    static uint8_t in[BUFF_SIZE];
+
+    // The slave is idle
+    memset(in, 0, sizeof(in));
+    bench_stream("idle", in);
+
+    // The 16 byte strings separated by the 8 byte '\0' runs
+    for (size_t q = 0; q < sizeof(in); q++) {
+        in[q] = (q % 24 < 16) ? 'a' + q % 24 : 0;
+    }
+    bench_stream("strings 16/8", in);
+
+    // The slave sends the long strings back to back
+    for (size_t q = 0; q < sizeof(in); q++) {
+        in[q] = (q % 128 == 127) ? 0 : 'a' + q % 26;
+    }
+    bench_stream("dense 127/1", in);
+
+    return 0;
+}
+
+// ============================================================================
+
+static void bench_stream(const char *name, const uint8_t *in)
+{
+    static uint8_t out[BUFF_SIZE];
+    char label[64];
+    uart_spi_miso_t miso;
+
+    uart_spi_miso_reset(&miso);
+
+    double start = bench_now();
+    for (size_t done = 0; done < BENCH_BYTES; done += BUFF_SIZE) {
+        sink += uart_spi_miso_filter(&miso, in, BUFF_SIZE, out);
+    }
+    snprintf(label, sizeof(label), "filter %s", name);
+    bench_report(label, BENCH_BYTES, bench_now() - start);
+
+    uart_spi_miso_reset(&miso);
+
+    start = bench_now();
+    for (size_t done = 0; done < BENCH_BYTES; done += BUFF_SIZE) {
+        size_t count = 0;
+
+        for (size_t q = 0; q < BUFF_SIZE; q++) {
+            if (uart_spi_miso_byte(&miso, in[q]) != UART_SPI_MISO_IDLE) {
+                out[count++] = in[q];
+            }
+        }
+
+        sink += count;
+    }
+    snprintf(label, sizeof(label), "per-byte %s", name);
+    bench_report(label, BENCH_BYTES, bench_now() - start);
+}
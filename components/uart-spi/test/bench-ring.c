@@ -0,0 +1,151 @@
+/**
+ * @file bench-ring.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host cost of the SPSC ring against the FreeRTOS stream buffer it replaced,
+ * for the byte-wise writes of the former SPI task, the 1-byte descriptors
+ * the bridge passes now and the 128-byte blocks.
+ *
+ * The stream buffer is the tree's stream_buffer.c compiled for the host.
+ * Its critical sections, scheduler suspension and task notifications are
+ * the empty stubs below, and the ring barriers are the compiler barriers,
+ * so the host figures compare the code paths only. On the Cortex-M0+ each
+ * stream buffer send and receive also masks the interrupts and suspends
+ * the scheduler, the ring pays one DMB per index update.
+ */
+
+#include "bench.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stream_buffer.h"
+
+#include "uart-spi-ring.h"
+
+// ============================================================================
+
+#define RING_SIZE           1024
+#define BENCH_OPS           (32u * 1024 * 1024)
+
+// ============================================================================
+
+static void bench_case(const char *name, size_t length);
+
+static volatile size_t sink;
+
+// ============================================================================
+
+int main(void)
+{
+    bench_case("1 byte", 1);
+    bench_case("128 bytes", 128);
+
+    return 0;
+}
+
+// ============================================================================
+
+static void bench_case(const char *name, size_t length)
+{
+    static uint8_t ring_mem[RING_SIZE];
+    static uint8_t stream_mem[RING_SIZE + 1];
+    static StaticStreamBuffer_t stream_struct;
+    uint8_t data[128] = { 0 };
+    char label[64];
+
+    size_t ops = BENCH_OPS / length;
+    if (ops > BENCH_OPS / 4) {
+        ops = BENCH_OPS / 4;
+    }
+
+    uart_spi_ring_t ring;
+    uart_spi_ring_init(&ring, ring_mem, RING_SIZE);
+
+    double start = bench_now();
+    for (size_t q = 0; q < ops; q++) {
+        uart_spi_ring_write(&ring, data, length);
+        sink += uart_spi_ring_read(&ring, data, length);
+    }
+    double seconds = bench_now() - start;
+    snprintf(label, sizeof(label), "ring %s", name);
+    printf("%-32s %8.1f ns/write+read\n", label, seconds * 1e9 / ops);
+
+    StreamBufferHandle_t stream = xStreamBufferCreateStatic(RING_SIZE, 1, stream_mem, &stream_struct);
+
+    start = bench_now();
+    for (size_t q = 0; q < ops; q++) {
+        xStreamBufferSend(stream, data, length, 0);
+        sink += xStreamBufferReceive(stream, data, length, 0);
+    }
+    seconds = bench_now() - start;
+    snprintf(label, sizeof(label), "stream buffer %s", name);
+    printf("%-32s %8.1f ns/write+read\n", label, seconds * 1e9 / ops);
+
+    start = bench_now();
+    for (size_t q = 0; q < ops; q++) {
+        xStreamBufferSendFromISR(stream, data, length, NULL);
+        sink += xStreamBufferReceive(stream, data, length, 0);
+    }
+    seconds = bench_now() - start;
+    snprintf(label, sizeof(label), "stream buffer ISR %s", name);
+    printf("%-32s %8.1f ns/write+read\n", label, seconds * 1e9 / ops);
+
+    // The former SPI task wrote the block byte by byte
+    if (length > 1) {
+        start = bench_now();
+        for (size_t q = 0; q < ops; q++) {
+            for (size_t w = 0; w < length; w++) {
+                xStreamBufferSend(stream, &data[w], 1, 0);
+            }
+            sink += xStreamBufferReceive(stream, data, length, 0);
+        }
+        seconds = bench_now() - start;
+        snprintf(label, sizeof(label), "stream buffer bytewise %s", name);
+        printf("%-32s %8.1f ns/write+read\n", label, seconds * 1e9 / ops);
+    }
+}
+
+// ============================================================================
+// Kernel stubs. The benchmark never blocks, so no task is ever notified
+
+static uint32_t critical_nesting;
+
+void vPortEnterCritical(void) { critical_nesting++; __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+void vPortExitCritical(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); critical_nesting--; }
+uint32_t ulSetInterruptMaskFromISR(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); return 0; }
+void vClearInterruptMaskFromISR(uint32_t mask) { (void)mask; __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+void vPortYield(void) {}
+void vPortYieldFromISR(BaseType_t switch_required) { (void)switch_required; }
+void __disable_irq(void) {}
+void __enable_irq(void) {}
+
+void vTaskSuspendAll(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+BaseType_t xTaskResumeAll(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); return pdFALSE; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return NULL; }
+void vTaskSetTimeOutState(TimeOut_t *timeout) { (void)timeout; }
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks) { (void)timeout; (void)ticks; return pdTRUE; }
+BaseType_t xTaskNotifyStateClear(TaskHandle_t task) { (void)task; return pdFALSE; }
+
+BaseType_t xTaskNotifyWait(uint32_t clear_entry, uint32_t clear_exit, uint32_t *value, TickType_t ticks)
+{
+    (void)clear_entry; (void)clear_exit; (void)value; (void)ticks;
+    return pdFALSE;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action, uint32_t *previous)
+{
+    (void)task; (void)value; (void)action; (void)previous;
+    return pdPASS;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                                     uint32_t *previous, BaseType_t *woken)
+{
+    (void)task; (void)value; (void)action; (void)previous; (void)woken;
+    return pdPASS;
+}
+
+void *pvPortMalloc(size_t size) { (void)size; return NULL; }
+void vPortFree(void *ptr) { (void)ptr; }
+unsigned long getRunTimeCounterValue(void) { return 0; }
@@ -0,0 +1,42 @@
+/**
+ * @file bench.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host benchmark timing
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <time.h>
+
+// ============================================================================
+
+/**
+ * @brief Get the monotonic time in seconds
+ *
+ */
+static inline double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Print the throughput line
+ *
+ * @param name The case name
+ * @param bytes The bytes processed
+ * @param seconds The time spent
+ */
+static inline void bench_report(const char *name, double bytes, double seconds)
+{
+    printf("%-32s %10.1f MB/s %8.2f ns/byte\n", name, bytes / seconds / 1e6, seconds * 1e9 / bytes);
+}
+
+#endif /* BENCH_H_ */
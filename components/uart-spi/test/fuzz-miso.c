@@ -0,0 +1,123 @@
+/**
+ * @file fuzz-miso.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * libFuzzer target of the MISO string filter.
+ *
+ * The first input byte seeds the chunk boundaries, the rest is the MISO
+ * stream. The chunked filter output must match the reference model and
+ * keep the uart-spi-miso.h guarantees.
+ *
+ * Built with clang -fsanitize=fuzzer. Without libFuzzer the FUZZ_STANDALONE
+ * driver runs the given input files or the random inputs.
+ */
+
+#include "miso-model.h"
+
+#include "uart-spi-miso.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define FUZZ_LENGTH_MAX     4096
+
+// ============================================================================
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static uint8_t out[FUZZ_LENGTH_MAX];
+    static uint8_t expected[FUZZ_LENGTH_MAX];
+
+    if (size < 1 || size > FUZZ_LENGTH_MAX) {
+        return 0;
+    }
+
+    uint32_t seed = data[0];
+    const uint8_t *in = data + 1;
+    size_t length = size - 1;
+
+    uart_spi_miso_t miso;
+    size_t out_length = 0;
+
+    uart_spi_miso_reset(&miso);
+
+    for (size_t offset = 0; offset < length; ) {
+        seed = seed * 1103515245u + 12345u;
+
+        size_t chunk = 1 + (seed >> 16) % 64;
+        if (chunk > length - offset) {
+            chunk = length - offset;
+        }
+
+        size_t count = uart_spi_miso_filter(&miso, in + offset, chunk, out + out_length);
+        if (count > chunk) {
+            abort();
+        }
+
+        out_length += count;
+        offset += chunk;
+    }
+
+    size_t expected_length = miso_model(in, length, expected);
+
+    if (out_length != expected_length || memcmp(out, expected, out_length) != 0) {
+        abort();
+    }
+
+    if (!miso_model_check(out, out_length)) {
+        abort();
+    }
+
+    return 0;
+}
+
+// ============================================================================
+
+#ifdef FUZZ_STANDALONE
+
+#define FUZZ_RUNS           200000
+
+int main(int argc, char **argv)
+{
+    static uint8_t data[FUZZ_LENGTH_MAX];
+
+    if (argc > 1) {
+        for (int q = 1; q < argc; q++) {
+            FILE *file = fopen(argv[q], "rb");
+            if (!file) {
+                perror(argv[q]);
+                return 1;
+            }
+
+            size_t size = fread(data, 1, sizeof(data), file);
+            fclose(file);
+
+            LLVMFuzzerTestOneInput(data, size);
+        }
+
+        return 0;
+    }
+
+    srand(3);
+
+    for (int run = 0; run < FUZZ_RUNS; run++) {
+        size_t size = rand() % 256;
+        int zero_percent = rand() % 101;
+
+        for (size_t q = 0; q < size; q++) {
+            data[q] = (rand() % 100 < zero_percent) ? 0 : rand() % 256;
+        }
+
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    printf("fuzz-miso: %d runs OK\n", FUZZ_RUNS);
+
+    return 0;
+}
+
+#endif
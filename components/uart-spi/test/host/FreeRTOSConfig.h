@@ -0,0 +1,53 @@
+/**
+ * @file FreeRTOSConfig.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host build configuration. Mirrors the Core/Inc one for the options the
+ * uart-spi units depend on; the kernel API is provided by the simulation
+ * (see sim.h) or by the test stubs.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+#define configUSE_PREEMPTION                     1
+#define configSUPPORT_STATIC_ALLOCATION          1
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configUSE_IDLE_HOOK                      0
+#define configUSE_TICK_HOOK                      0
+#define configCPU_CLOCK_HZ                       ( 64000000 )
+#define configTICK_RATE_HZ                       ((TickType_t)1000)
+#define configMAX_PRIORITIES                     ( 56 )
+#define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
+#define configTOTAL_HEAP_SIZE                    ((size_t)16384)
+#define configMAX_TASK_NAME_LEN                  ( 16 )
+#define configUSE_TRACE_FACILITY                 1
+#define configGENERATE_RUN_TIME_STATS            1
+#define configUSE_16_BIT_TICKS                   0
+#define configUSE_MUTEXES                        1
+#define configUSE_RECURSIVE_MUTEXES              1
+#define configUSE_COUNTING_SEMAPHORES            1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+#define configMESSAGE_BUFFER_LENGTH_TYPE         size_t
+#define configUSE_CO_ROUTINES                    0
+#define configUSE_TIMERS                         0
+#define configUSE_NEWLIB_REENTRANT               0
+
+#define INCLUDE_vTaskDelete                      1
+#define INCLUDE_vTaskSuspend                     1
+#define INCLUDE_vTaskDelay                       1
+#define INCLUDE_xTaskGetSchedulerState           1
+#define INCLUDE_uxTaskGetStackHighWaterMark      1
+#define INCLUDE_xTaskGetCurrentTaskHandle        1
+
+#include <assert.h>
+#define configASSERT( x ) assert(x)
+
+unsigned long getRunTimeCounterValue(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE getRunTimeCounterValue
+
+#endif /* FREERTOS_CONFIG_H */
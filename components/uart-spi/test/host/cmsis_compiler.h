@@ -0,0 +1,84 @@
+/**
+ * @file cmsis_compiler.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host replacement of the CMSIS compiler header and the GCC intrinsics.
+ *
+ * The simulation build includes it ahead of the device headers, so the ARM
+ * inline assembly of cmsis_gcc.h is never compiled. The interrupt mask is
+ * the simulated one (see sim.h).
+ */
+
+#ifndef __CMSIS_COMPILER_H
+#define __CMSIS_COMPILER_H
+
+// The CMSIS GCC header is replaced as a whole
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+// ============================================================================
+
+#define __ASM                   __asm
+#define __INLINE                inline
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    __attribute__((always_inline)) static inline
+#define __NO_RETURN             __attribute__((__noreturn__))
+#define __USED                  __attribute__((used))
+#define __WEAK                  __attribute__((weak))
+#define __PACKED                __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT         struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION          union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)            __attribute__((aligned(x)))
+#define __RESTRICT              __restrict
+#define __COMPILER_BARRIER()    __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#define __IO                    volatile
+
+// The single-threaded benchmarks use the compiler barrier: the host fence
+// costs far more than the single-core Cortex-M0+ DMB
+#ifdef HOST_DMB_COMPILER_BARRIER
+#define __DMB()                 __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#else
+#define __DMB()                 __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+#define __DSB()                 __DMB()
+#define __ISB()                 __DMB()
+#define __NOP()                 do {} while (0)
+#define __WFI()                 do {} while (0)
+#define __WFE()                 do {} while (0)
+#define __SEV()                 do {} while (0)
+#define __BKPT(value)           __builtin_trap()
+
+#define __REV(value)            __builtin_bswap32(value)
+#define __REV16(value)          ((uint32_t)(((value) & 0xFF00FF00UL) >> 8 | ((value) & 0x00FF00FFUL) << 8))
+#define __REVSH(value)          ((int16_t)__builtin_bswap16(value))
+#define __CLZ(value)            ((uint8_t)((value) == 0 ? 32 : __builtin_clz(value)))
+
+__STATIC_INLINE uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+    op2 %= 32U;
+    return op2 == 0U ? op1 : (op1 >> op2) | (op1 << (32U - op2));
+}
+
+__STATIC_INLINE uint32_t __RBIT(uint32_t value)
+{
+    uint32_t result = 0;
+
+    for (int q = 0; q < 32; q++) {
+        result = (result << 1) | ((value >> q) & 1U);
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Simulated core registers
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_IPSR(void);
+
+#endif /* __CMSIS_COMPILER_H */
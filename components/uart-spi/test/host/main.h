@@ -0,0 +1,48 @@
+/**
+ * @file main.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host replacement of Core/Inc/main.h for the simulation build.
+ *
+ * The real HAL headers give the handle types and the register macros.
+ * The peripherals the bridge accesses directly are redirected to the
+ * simulated registers in RAM, the HAL functions are implemented by sim-hal.c.
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include "stm32g0xx_hal.h"
+
+// ============================================================================
+
+extern USART_TypeDef sim_usart1;
+extern USART_TypeDef sim_usart2;
+extern SPI_TypeDef sim_spi1;
+extern IWDG_TypeDef sim_iwdg;
+extern RCC_TypeDef sim_rcc;
+extern CRC_TypeDef sim_crc;
+
+#undef USART1
+#undef USART2
+#undef SPI1
+#undef IWDG
+#undef RCC
+#undef CRC
+
+#define USART1              (&sim_usart1)
+#define USART2              (&sim_usart2)
+#define SPI1                (&sim_spi1)
+#define IWDG                (&sim_iwdg)
+#define RCC                 (&sim_rcc)
+#define CRC                 (&sim_crc)
+
+// The MCU reset ends the simulation
+void sim_system_reset(void);
+#undef NVIC_SystemReset
+#define NVIC_SystemReset    sim_system_reset
+
+void Error_Handler(void);
+
+#endif /* __MAIN_H */
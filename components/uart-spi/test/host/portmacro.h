@@ -0,0 +1,62 @@
+/**
+ * @file portmacro.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host port definitions. The types match the ARM_CM0 port; the critical
+ * sections and the yields are the simulation functions (see sim.h).
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#define portCHAR                char
+#define portFLOAT               float
+#define portDOUBLE              double
+#define portLONG                long
+#define portSHORT               short
+#define portSTACK_TYPE          uint32_t
+#define portBASE_TYPE           long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY           ( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH        ( -1 )
+#define portTICK_PERIOD_MS      ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT      8
+
+extern void vPortYield( void );
+extern void vPortYieldFromISR( BaseType_t xSwitchRequired );
+#define portYIELD()                             vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired ) vPortYieldFromISR( xSwitchRequired )
+#define portYIELD_FROM_ISR( x )                 portEND_SWITCHING_ISR( x )
+
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+extern uint32_t ulSetInterruptMaskFromISR( void );
+extern void vClearInterruptMaskFromISR( uint32_t ulMask );
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()       ulSetInterruptMaskFromISR()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)    vClearInterruptMaskFromISR( x )
+extern void __disable_irq( void );
+extern void __enable_irq( void );
+
+#define portDISABLE_INTERRUPTS()                __disable_irq()
+#define portENABLE_INTERRUPTS()                 __enable_irq()
+#define portENTER_CRITICAL()                    vPortEnterCritical()
+#define portEXIT_CRITICAL()                     vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#define portNOP()
+#define portMEMORY_BARRIER()    __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
+#endif /* PORTMACRO_H */
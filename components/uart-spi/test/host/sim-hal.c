@@ -0,0 +1,1121 @@
+/**
+ * @file sim-hal.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Peripherals model of the host simulation (see sim.h).
+ *
+ * The HAL functions the bridge calls are implemented on the handle states the
+ * way the HAL drives them: the transfers complete by the events scheduled at
+ * their line time and call the registered callbacks from the interrupt, wrapped
+ * in the bridge interrupt hooks as the IRQ handlers of stm32g0xx_it.c do.
+ * The faults are injected at the callback dispatch.
+ */
+
+#include "sim.h"
+
+#include "main.h"
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "uart-spi-config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define PCLK_FREQ               64000000UL
+#define LSI_FREQ                32000UL
+
+#define LINE_RING_SIZE          (64 * 1024)
+
+// The interrupt numbers reported by the IPSR
+#define USART1_IRQ              27
+#define SPI1_IRQ                25
+#define DMA_IRQ                 10
+
+#define FAULT_SEED_DEFAULT      0x2545F491U
+
+#define FAULT_PPM               1000000U
+
+// ============================================================================
+
+/**
+ * @brief Byte ring of the line model. The bytes over its size are dropped
+ *
+ */
+typedef struct {
+    uint8_t mem[LINE_RING_SIZE];
+    size_t head;
+    size_t used;
+} line_ring_t;
+
+// ============================================================================
+
+static void ring_put(line_ring_t *ring, uint8_t byte);
+static bool ring_get(line_ring_t *ring, uint8_t *byte);
+static size_t ring_take(line_ring_t *ring, void *data, size_t size);
+
+static uint64_t uart_byte_time_ns(void);
+static void uart_rx_schedule(void);
+static void uart_rx_event(void *ctx);
+static void uart_rx_deliver(uint8_t byte);
+static void uart_rx_complete(uint8_t byte);
+static void uart_rx_error(uint32_t error);
+static void uart_rx_pending_event(void *ctx);
+static void uart_rx_delayed_event(void *ctx);
+static void uart_tx_event(void *ctx);
+static void uart_tx_irq_event(void *ctx);
+static void uart_tx_emit(size_t count);
+static void uart_tx_cancel(void);
+static void uart_rx_cancel(void);
+
+static void spi_event(void *ctx);
+static void spi_irq_event(void *ctx);
+static uint8_t spi_slave_exchange(uint8_t mosi);
+
+static bool fault_hit(sim_fault_t fault);
+static void fault_flip(uint8_t *data, size_t length);
+static uint32_t fault_random(void);
+
+// ============================================================================
+
+USART_TypeDef sim_usart1;
+USART_TypeDef sim_usart2;
+SPI_TypeDef sim_spi1;
+IWDG_TypeDef sim_iwdg;
+RCC_TypeDef sim_rcc;
+CRC_TypeDef sim_crc;
+
+UART_HandleTypeDef huart1;
+SPI_HandleTypeDef hspi1;
+
+// UART RX line. The bytes sent by the test arrive one per byte time
+static line_ring_t uart_rx_line;
+static uint64_t uart_rx_free_ns;
+static uint32_t uart_rx_event_id;
+
+// Receive data register of the unarmed reception
+static bool uart_rdr_full;
+static uint8_t uart_rdr;
+static bool uart_ore;
+// The delayed receive interrupt. The reception is armed, the bytes wait in the data register
+static uint32_t uart_rx_delay_event_id;
+
+// UART TX line
+static line_ring_t uart_tx_line;
+static bool uart_loopback;
+static uint32_t uart_tx_event_id;
+static uint64_t uart_tx_start_us;
+static size_t uart_tx_emitted;
+
+// SPI slave
+static line_ring_t spi_miso_line;
+static line_ring_t spi_mosi_line;
+static sim_slave_mode_t spi_slave_mode;
+static bool spi_slave_in_string;
+static uint32_t spi_event_id;
+
+// IWDG
+static bool iwdg_started;
+static uint64_t iwdg_refresh_us;
+
+// The fault injection
+static const char *const fault_names[SIM_FAULT_COUNT] = {
+    [SIM_FAULT_UART_FRAMING] = "uart_fe",
+    [SIM_FAULT_UART_OVERRUN] = "uart_ore",
+    [SIM_FAULT_UART_TX_DROP] = "uart_tx_drop",
+    [SIM_FAULT_SPI_DROP] = "spi_drop",
+    [SIM_FAULT_SPI_ERROR] = "spi_err",
+    [SIM_FAULT_BIT_FLIP] = "flip",
+    [SIM_FAULT_IRQ_DELAY] = "irq_delay",
+};
+
+static uint32_t fault_ppm[SIM_FAULT_COUNT];
+static uint32_t fault_injected[SIM_FAULT_COUNT];
+// The xorshift32 state
+static uint32_t fault_state;
+
+static sim_stats_t hal_stats;
+
+// ============================================================================
+
+void sim_hal_init(void)
+{
+    memset(&uart_rx_line, 0, sizeof(uart_rx_line));
+    memset(&uart_tx_line, 0, sizeof(uart_tx_line));
+    memset(&spi_miso_line, 0, sizeof(spi_miso_line));
+    memset(&spi_mosi_line, 0, sizeof(spi_mosi_line));
+
+    uart_rx_free_ns = 0;
+    uart_rx_event_id = 0;
+    uart_rdr_full = false;
+    uart_ore = false;
+    uart_rx_delay_event_id = 0;
+    uart_loopback = false;
+    uart_tx_event_id = 0;
+
+    spi_slave_mode = SIM_SLAVE_ECHO;
+    spi_slave_in_string = false;
+    spi_event_id = 0;
+
+    memset(&sim_usart1, 0, sizeof(sim_usart1));
+    memset(&sim_spi1, 0, sizeof(sim_spi1));
+    memset(&sim_iwdg, 0, sizeof(sim_iwdg));
+    memset(&sim_rcc, 0, sizeof(sim_rcc));
+
+    iwdg_started = false;
+    iwdg_refresh_us = 0;
+
+    memset(fault_ppm, 0, sizeof(fault_ppm));
+    sim_fault_seed(0);
+
+    memset(&hal_stats, 0, sizeof(hal_stats));
+
+    memset(&huart1, 0, sizeof(huart1));
+    memset(&hspi1, 0, sizeof(hspi1));
+
+    MX_USART1_UART_Init();
+    MX_SPI1_Init();
+}
+
+void sim_hal_stats_get(sim_stats_t *stats)
+{
+    stats->uart_rx_overruns = hal_stats.uart_rx_overruns;
+    stats->spi_transactions = hal_stats.spi_transactions;
+    stats->iwdg_started = iwdg_started;
+}
+
+void sim_uart_send(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    for (size_t q = 0; q < length; q++) {
+        ring_put(&uart_rx_line, bytes[q]);
+    }
+
+    uart_rx_schedule();
+}
+
+size_t sim_uart_receive(void *data, size_t size)
+{
+    return ring_take(&uart_tx_line, data, size);
+}
+
+void sim_uart_loopback_set(bool loopback)
+{
+    uart_loopback = loopback;
+}
+
+void sim_spi_slave_set(sim_slave_mode_t mode)
+{
+    spi_slave_mode = mode;
+}
+
+void sim_spi_slave_send(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    for (size_t q = 0; q < length; q++) {
+        ring_put(&spi_miso_line, bytes[q]);
+    }
+}
+
+size_t sim_spi_slave_receive(void *data, size_t size)
+{
+    return ring_take(&spi_mosi_line, data, size);
+}
+
+void sim_fault_set(sim_fault_t fault, uint32_t probability_ppm)
+{
+    if (fault < SIM_FAULT_COUNT) {
+        fault_ppm[fault] = probability_ppm < FAULT_PPM ? probability_ppm : FAULT_PPM;
+    }
+}
+
+void sim_fault_seed(uint32_t seed)
+{
+    fault_state = seed != 0 ? seed : FAULT_SEED_DEFAULT;
+
+    memset(fault_injected, 0, sizeof(fault_injected));
+}
+
+const char *sim_fault_get(sim_fault_t fault, uint32_t *probability_ppm, uint32_t *injected)
+{
+    if (fault >= SIM_FAULT_COUNT) {
+        return NULL;
+    }
+
+    *probability_ppm = fault_ppm[fault];
+    *injected = fault_injected[fault];
+
+    return fault_names[fault];
+}
+
+void sim_iwdg_poll(void)
+{
+    uint64_t now = sim_time_us();
+    uint32_t key = sim_iwdg.KR;
+
+    if (key != 0) {
+        sim_iwdg.KR = 0;
+
+        if (key == 0xCCCC) {
+            iwdg_started = true;
+        }
+
+        if (key == 0xCCCC || key == 0xAAAA) {
+            iwdg_refresh_us = now;
+        }
+    }
+
+    if (!iwdg_started || sim_iwdg.RLR == 0) {
+        return;
+    }
+
+    uint64_t timeout_us = (uint64_t)(sim_iwdg.RLR + 1) * (4UL << sim_iwdg.PR) * 1000000 / LSI_FREQ;
+
+    if (now - iwdg_refresh_us > timeout_us) {
+        sim_rcc.CSR |= RCC_CSR_IWDGRSTF;
+        sim_system_reset();
+    }
+}
+
+// ============================================================================
+// The CubeMX initialization of the board
+
+void MX_USART1_UART_Init(void)
+{
+    huart1.Instance = USART1;
+    huart1.Init.BaudRate = 115200;
+    huart1.Init.WordLength = UART_WORDLENGTH_8B;
+    huart1.Init.StopBits = UART_STOPBITS_1;
+    huart1.Init.Parity = UART_PARITY_NONE;
+    huart1.Init.Mode = UART_MODE_TX_RX;
+    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart1.Init.OverSampling = UART_OVERSAMPLING_16;
+
+    if (HAL_UART_Init(&huart1) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+void MX_SPI1_Init(void)
+{
+    hspi1.Instance = SPI1;
+    hspi1.Init.Mode = SPI_MODE_MASTER;
+    hspi1.Init.Direction = SPI_DIRECTION_2LINES;
+    hspi1.Init.DataSize = SPI_DATASIZE_8BIT;
+    hspi1.Init.CLKPolarity = SPI_POLARITY_LOW;
+    hspi1.Init.CLKPhase = SPI_PHASE_1EDGE;
+    hspi1.Init.NSS = SPI_NSS_HARD_OUTPUT;
+    hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+    hspi1.Init.FirstBit = SPI_FIRSTBIT_MSB;
+
+    if (HAL_SPI_Init(&hspi1) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+void Error_Handler(void)
+{
+    abort();
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+    return PCLK_FREQ;
+}
+
+// The flash is not modelled: no configuration is stored
+int uart_spi_config_save(const uart_spi_tunables_t *tunables)
+{
+    (void)tunables;
+    return -1;
+}
+
+int uart_spi_config_load(uart_spi_tunables_t *tunables)
+{
+    (void)tunables;
+    return -1;
+}
+
+// ============================================================================
+// UART
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    if (huart == NULL) {
+        return HAL_ERROR;
+    }
+
+    if (huart->gState == HAL_UART_STATE_RESET) {
+        // The HAL resets the registered callbacks to the weak defaults
+        huart->TxCpltCallback = NULL;
+        huart->RxCpltCallback = NULL;
+        huart->ErrorCallback = NULL;
+    }
+
+    CLEAR_BIT(huart->Instance->CR3, USART_CR3_DEM | USART_CR3_HDSEL);
+    CLEAR_BIT(huart->Instance->CR1, USART_CR1_FIFOEN | USART_CR1_UESM);
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart)
+{
+    uart_tx_cancel();
+    uart_rx_cancel();
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_RESET;
+    huart->RxState = HAL_UART_STATE_RESET;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_RegisterCallback(UART_HandleTypeDef *huart, HAL_UART_CallbackIDTypeDef id,
+                                            pUART_CallbackTypeDef callback)
+{
+    if (callback == NULL || huart->gState != HAL_UART_STATE_READY) {
+        return HAL_ERROR;
+    }
+
+    switch (id) {
+        case HAL_UART_TX_COMPLETE_CB_ID: huart->TxCpltCallback = callback; break;
+        case HAL_UART_RX_COMPLETE_CB_ID: huart->RxCpltCallback = callback; break;
+        case HAL_UART_ERROR_CB_ID: huart->ErrorCallback = callback; break;
+        default: break;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if (pData == NULL || Size != 1) {
+        return HAL_ERROR;
+    }
+
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->RxXferCount = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    // The pending RXNE or ORE raises the interrupt once enabled
+    if (uart_rdr_full || uart_ore) {
+        sim_event_schedule(sim_time_us(), USART1_IRQ, uart_rx_pending_event, NULL);
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    if (huart->gState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if (pData == NULL || Size == 0) {
+        return HAL_ERROR;
+    }
+
+    huart->pTxBuffPtr = pData;
+    huart->TxXferSize = Size;
+    huart->TxXferCount = Size;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    uart_tx_start_us = sim_time_us();
+    uart_tx_emitted = 0;
+
+    uint64_t duration_us = (Size * uart_byte_time_ns() + 999) / 1000;
+
+    uart_tx_event_id = sim_event_schedule(uart_tx_start_us + duration_us, USART1_IRQ, uart_tx_event, NULL);
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit_IT(UART_HandleTypeDef *huart)
+{
+    uart_tx_cancel();
+
+    huart->gState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+    uart_rx_cancel();
+
+    huart->RxState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart)
+{
+    uart_tx_cancel();
+    uart_rx_cancel();
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+// The line modes are accepted without an effect on the model
+
+HAL_StatusTypeDef HAL_HalfDuplex_Init(UART_HandleTypeDef *huart)
+{
+    HAL_StatusTypeDef status = HAL_UART_Init(huart);
+
+    SET_BIT(huart->Instance->CR3, USART_CR3_HDSEL);
+
+    return status;
+}
+
+HAL_StatusTypeDef HAL_HalfDuplex_EnableTransmitter(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_HalfDuplex_EnableReceiver(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RS485Ex_Init(UART_HandleTypeDef *huart, uint32_t Polarity, uint32_t AssertionTime,
+                                   uint32_t DeassertionTime)
+{
+    (void)Polarity;
+    (void)AssertionTime;
+    (void)DeassertionTime;
+
+    HAL_StatusTypeDef status = HAL_UART_Init(huart);
+
+    SET_BIT(huart->Instance->CR3, USART_CR3_DEM);
+
+    return status;
+}
+
+HAL_StatusTypeDef HAL_MultiProcessor_Init(UART_HandleTypeDef *huart, uint8_t Address, uint32_t WakeUpMethod)
+{
+    (void)Address;
+    (void)WakeUpMethod;
+
+    return HAL_UART_Init(huart);
+}
+
+HAL_StatusTypeDef HAL_MultiProcessorEx_AddressLength_Set(UART_HandleTypeDef *huart, uint32_t AddressLength)
+{
+    (void)huart;
+    (void)AddressLength;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_MultiProcessor_EnableMuteMode(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+void HAL_MultiProcessor_EnterMuteMode(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_EnableFifoMode(UART_HandleTypeDef *huart)
+{
+    SET_BIT(huart->Instance->CR1, USART_CR1_FIFOEN);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_SetRxFifoThreshold(UART_HandleTypeDef *huart, uint32_t Threshold)
+{
+    (void)huart;
+    (void)Threshold;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_EnableStopMode(UART_HandleTypeDef *huart)
+{
+    SET_BIT(huart->Instance->CR1, USART_CR1_UESM);
+    return HAL_OK;
+}
+
+void HAL_UART_ReceiverTimeout_Config(UART_HandleTypeDef *huart, uint32_t TimeoutValue)
+{
+    (void)huart;
+    (void)TimeoutValue;
+}
+
+HAL_StatusTypeDef HAL_UART_EnableReceiverTimeout(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+// ============================================================================
+// SPI
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == NULL) {
+        return HAL_ERROR;
+    }
+
+    if (hspi->State == HAL_SPI_STATE_RESET) {
+        hspi->TxRxCpltCallback = NULL;
+        hspi->ErrorCallback = NULL;
+    }
+
+    hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+    hspi->State = HAL_SPI_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef *hspi)
+{
+    sim_event_cancel(spi_event_id);
+
+    hspi->State = HAL_SPI_STATE_RESET;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_RegisterCallback(SPI_HandleTypeDef *hspi, HAL_SPI_CallbackIDTypeDef CallbackID,
+                                           pSPI_CallbackTypeDef pCallback)
+{
+    if (pCallback == NULL || hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_ERROR;
+    }
+
+    switch (CallbackID) {
+        case HAL_SPI_TX_RX_COMPLETE_CB_ID: hspi->TxRxCpltCallback = pCallback; break;
+        case HAL_SPI_ERROR_CB_ID: hspi->ErrorCallback = pCallback; break;
+        default: break;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+                                              uint16_t Size)
+{
+    if (hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if (pTxData == NULL || pRxData == NULL || Size == 0) {
+        return HAL_ERROR;
+    }
+
+    hspi->pTxBuffPtr = pTxData;
+    hspi->pRxBuffPtr = pRxData;
+    hspi->TxXferSize = Size;
+    hspi->RxXferSize = Size;
+    hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+    hspi->State = HAL_SPI_STATE_BUSY_TX_RX;
+
+    uint32_t prescaler = 2UL << (hspi->Init.BaudRatePrescaler >> SPI_CR1_BR_Pos);
+    uint32_t frame_bits = (hspi->Init.DataSize >> SPI_CR2_DS_Pos) + 1;
+    uint64_t duration_us = ((uint64_t)Size * frame_bits * prescaler * 1000000 + PCLK_FREQ - 1) / PCLK_FREQ;
+
+    spi_event_id = sim_event_schedule(sim_time_us() + duration_us, DMA_IRQ, spi_event, hspi);
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi)
+{
+    // The slave data of the aborted transaction is lost
+    sim_event_cancel(spi_event_id);
+
+    if (hspi->State != HAL_SPI_STATE_RESET) {
+        hspi->State = HAL_SPI_STATE_READY;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort_IT(SPI_HandleTypeDef *hspi)
+{
+    return HAL_SPI_Abort(hspi);
+}
+
+// ============================================================================
+
+static void ring_put(line_ring_t *ring, uint8_t byte)
+{
+    if (ring->used == LINE_RING_SIZE) {
+        return;
+    }
+
+    ring->mem[(ring->head + ring->used) % LINE_RING_SIZE] = byte;
+    ring->used++;
+}
+
+static bool ring_get(line_ring_t *ring, uint8_t *byte)
+{
+    if (ring->used == 0) {
+        return false;
+    }
+
+    *byte = ring->mem[ring->head];
+    ring->head = (ring->head + 1) % LINE_RING_SIZE;
+    ring->used--;
+
+    return true;
+}
+
+static size_t ring_take(line_ring_t *ring, void *data, size_t size)
+{
+    uint8_t *bytes = data;
+    size_t count = 0;
+
+    while (count < size && ring_get(ring, &bytes[count])) {
+        count++;
+    }
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Get the UART frame time. 8N1
+ *
+ */
+static uint64_t uart_byte_time_ns(void)
+{
+    return 10ULL * 1000000000 / huart1.Init.BaudRate;
+}
+
+/**
+ * @brief Schedule the arrival of the next RX line byte
+ *
+ */
+static void uart_rx_schedule(void)
+{
+    if (uart_rx_event_id != 0 || uart_rx_line.used == 0) {
+        return;
+    }
+
+    uint64_t now_ns = sim_time_us() * 1000;
+
+    if (uart_rx_free_ns < now_ns) {
+        uart_rx_free_ns = now_ns;
+    }
+
+    uart_rx_free_ns += uart_byte_time_ns();
+
+    uart_rx_event_id = sim_event_schedule((uart_rx_free_ns + 999) / 1000, USART1_IRQ, uart_rx_event, NULL);
+}
+
+static void uart_rx_event(void *ctx)
+{
+    (void)ctx;
+
+    uart_rx_event_id = 0;
+
+    uint8_t byte;
+
+    if (ring_get(&uart_rx_line, &byte)) {
+        uart_rx_deliver(byte);
+    }
+
+    uart_rx_schedule();
+}
+
+/**
+ * @brief Receive the byte as the USART does
+ *
+ * The armed reception completes. Otherwise, or while its interrupt is delayed,
+ * the byte waits in the data register, the next one overruns it
+ */
+static void uart_rx_deliver(uint8_t byte)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    if (huart->RxState != HAL_UART_STATE_BUSY_RX || uart_rx_delay_event_id != 0) {
+        if (uart_rdr_full) {
+            uart_ore = true;
+            hal_stats.uart_rx_overruns++;
+        }
+        else {
+            uart_rdr = byte;
+            uart_rdr_full = true;
+        }
+
+        return;
+    }
+
+    if (fault_hit(SIM_FAULT_IRQ_DELAY)) {
+        uart_rdr = byte;
+        uart_rdr_full = true;
+
+        uart_rx_delay_event_id = sim_event_schedule(sim_time_us() + SIM_FAULT_DELAY_US, USART1_IRQ,
+                                                    uart_rx_delayed_event, NULL);
+        return;
+    }
+
+    uart_rx_complete(byte);
+}
+
+/**
+ * @brief Complete the armed reception with the byte
+ *
+ * The framing error is not blocking: the HAL completes the byte and then calls
+ * the error callback with the error code left by the completion callback
+ */
+static void uart_rx_complete(uint8_t byte)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    fault_flip(&byte, 1);
+
+    if (fault_hit(SIM_FAULT_UART_OVERRUN)) {
+        uart_rx_error(HAL_UART_ERROR_ORE);
+        return;
+    }
+
+    bool framing = fault_hit(SIM_FAULT_UART_FRAMING);
+
+    if (framing) {
+        huart->ErrorCode |= HAL_UART_ERROR_FE;
+    }
+
+    *huart->pRxBuffPtr = byte;
+    huart->RxXferCount = 0;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    uart_spi_isr_enter();
+
+    if (huart->RxCpltCallback) {
+        huart->RxCpltCallback(huart);
+    }
+
+    if (framing && huart->ErrorCallback) {
+        huart->ErrorCallback(huart);
+        huart->ErrorCode = HAL_UART_ERROR_NONE;
+    }
+
+    uart_spi_isr_exit();
+}
+
+/**
+ * @brief Abort the reception with the blocking error
+ *
+ */
+static void uart_rx_error(uint32_t error)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    huart->ErrorCode = error;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    uart_spi_isr_enter();
+
+    if (huart->ErrorCallback) {
+        huart->ErrorCallback(huart);
+    }
+
+    uart_spi_isr_exit();
+}
+
+/**
+ * @brief Serve the data register filled while the reception was not armed
+ *
+ * The overrun aborts the reception with the error, the HAL drops the data register
+ */
+static void uart_rx_pending_event(void *ctx)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    (void)ctx;
+
+    if (huart->RxState != HAL_UART_STATE_BUSY_RX) {
+        return;
+    }
+
+    if (uart_ore) {
+        uart_ore = false;
+        uart_rdr_full = false;
+        hal_stats.uart_rx_overruns++;
+
+        uart_rx_error(HAL_UART_ERROR_ORE);
+        return;
+    }
+
+    if (uart_rdr_full) {
+        uart_rdr_full = false;
+        uart_rx_complete(uart_rdr);
+    }
+}
+
+/**
+ * @brief Serve the delayed receive interrupt
+ *
+ */
+static void uart_rx_delayed_event(void *ctx)
+{
+    uart_rx_delay_event_id = 0;
+    uart_rx_pending_event(ctx);
+}
+
+static void uart_tx_event(void *ctx)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    (void)ctx;
+
+    uart_tx_event_id = 0;
+
+    uart_tx_emit(huart->TxXferSize);
+
+    huart->TxXferCount = 0;
+
+    if (fault_hit(SIM_FAULT_IRQ_DELAY)) {
+        uart_tx_event_id = sim_event_schedule(sim_time_us() + SIM_FAULT_DELAY_US, USART1_IRQ, uart_tx_irq_event, NULL);
+        return;
+    }
+
+    uart_tx_irq_event(NULL);
+}
+
+/**
+ * @brief Serve the transmission complete interrupt
+ *
+ * The lost interrupt leaves the transmission busy until it is aborted
+ */
+static void uart_tx_irq_event(void *ctx)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    (void)ctx;
+
+    uart_tx_event_id = 0;
+
+    if (fault_hit(SIM_FAULT_UART_TX_DROP)) {
+        return;
+    }
+
+    huart->gState = HAL_UART_STATE_READY;
+
+    uart_spi_isr_enter();
+
+    if (huart->TxCpltCallback) {
+        huart->TxCpltCallback(huart);
+    }
+
+    uart_spi_isr_exit();
+}
+
+/**
+ * @brief Put the transmitted bytes to the TX line
+ *
+ * @param count The bytes sent since the transfer start
+ */
+static void uart_tx_emit(size_t count)
+{
+    UART_HandleTypeDef *huart = &huart1;
+
+    for (; uart_tx_emitted < count; uart_tx_emitted++) {
+        uint8_t byte = huart->pTxBuffPtr[uart_tx_emitted];
+
+        ring_put(&uart_tx_line, byte);
+
+        if (uart_loopback) {
+            ring_put(&uart_rx_line, byte);
+        }
+    }
+
+    if (uart_loopback) {
+        uart_rx_schedule();
+    }
+}
+
+/**
+ * @brief Stop the transmission. The bytes already on the line are kept
+ *
+ */
+static void uart_tx_cancel(void)
+{
+    if (uart_tx_event_id == 0) {
+        return;
+    }
+
+    sim_event_cancel(uart_tx_event_id);
+    uart_tx_event_id = 0;
+
+    uint64_t sent = (sim_time_us() - uart_tx_start_us) * 1000 / uart_byte_time_ns();
+
+    uart_tx_emit(sent < huart1.TxXferSize ? sent : huart1.TxXferSize);
+}
+
+static void uart_rx_cancel(void)
+{
+    uart_ore = false;
+    uart_rdr_full = false;
+
+    sim_event_cancel(uart_rx_delay_event_id);
+    uart_rx_delay_event_id = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static void spi_event(void *ctx)
+{
+    SPI_HandleTypeDef *hspi = ctx;
+
+    spi_event_id = 0;
+    hal_stats.spi_transactions++;
+
+    for (uint16_t q = 0; q < hspi->RxXferSize; q++) {
+        hspi->pRxBuffPtr[q] = spi_slave_exchange(hspi->pTxBuffPtr[q]);
+    }
+
+    fault_flip(hspi->pRxBuffPtr, hspi->RxXferSize);
+
+    if (fault_hit(SIM_FAULT_IRQ_DELAY)) {
+        spi_event_id = sim_event_schedule(sim_time_us() + SIM_FAULT_DELAY_US, DMA_IRQ, spi_irq_event, hspi);
+        return;
+    }
+
+    spi_irq_event(hspi);
+}
+
+/**
+ * @brief Serve the DMA complete interrupt
+ *
+ * The lost interrupt leaves the transaction busy until it is aborted. The DMA error
+ * ends the transaction without the slave data
+ */
+static void spi_irq_event(void *ctx)
+{
+    SPI_HandleTypeDef *hspi = ctx;
+
+    spi_event_id = 0;
+
+    if (fault_hit(SIM_FAULT_SPI_DROP)) {
+        return;
+    }
+
+    if (fault_hit(SIM_FAULT_SPI_ERROR)) {
+        memset(hspi->pRxBuffPtr, 0, hspi->RxXferSize);
+
+        hspi->ErrorCode = HAL_SPI_ERROR_DMA;
+        hspi->State = HAL_SPI_STATE_READY;
+
+        uart_spi_isr_enter();
+
+        if (hspi->ErrorCallback) {
+            hspi->ErrorCallback(hspi);
+        }
+
+        uart_spi_isr_exit();
+        return;
+    }
+
+    hspi->State = HAL_SPI_STATE_READY;
+
+    uart_spi_isr_enter();
+
+    if (hspi->TxRxCpltCallback) {
+        hspi->TxRxCpltCallback(hspi);
+    }
+
+    uart_spi_isr_exit();
+}
+
+/**
+ * @brief Exchange one byte with the slave
+ *
+ * The slave records the data bytes it receives. In the echo mode it queues
+ * them back to MISO with a terminator per '\0' run, so they are returned
+ * by the following transactions
+ */
+static uint8_t spi_slave_exchange(uint8_t mosi)
+{
+    uint8_t miso = 0;
+
+    ring_get(&spi_miso_line, &miso);
+
+    if (mosi != 0) {
+        ring_put(&spi_mosi_line, mosi);
+    }
+
+    if ((mosi != 0 || spi_slave_in_string) && spi_slave_mode == SIM_SLAVE_ECHO) {
+        ring_put(&spi_miso_line, mosi);
+    }
+
+    spi_slave_in_string = mosi != 0;
+
+    return miso;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Decide if the fault is injected at this event
+ *
+ */
+static bool fault_hit(sim_fault_t fault)
+{
+    uint32_t ppm = fault_ppm[fault];
+
+    // Doesn't advance the sequence while the fault is off
+    if (ppm == 0 || fault_random() % FAULT_PPM >= ppm) {
+        return false;
+    }
+
+    fault_injected[fault]++;
+
+    return true;
+}
+
+/**
+ * @brief Flip a random bit of the data on the @ref SIM_FAULT_BIT_FLIP hit
+ *
+ */
+static void fault_flip(uint8_t *data, size_t length)
+{
+    if (length == 0 || !fault_hit(SIM_FAULT_BIT_FLIP)) {
+        return;
+    }
+
+    uint32_t random = fault_random();
+
+    data[(random >> 3) % length] ^= 1 << (random & 7);
+}
+
+/**
+ * @brief Get the next xorshift32 pseudo-random number
+ *
+ */
+static uint32_t fault_random(void)
+{
+    uint32_t x = fault_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fault_state = x;
+
+    return x;
+}
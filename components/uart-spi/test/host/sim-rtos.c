@@ -0,0 +1,1276 @@
+/**
+ * @file sim-rtos.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Kernel model of the host simulation (see sim.h).
+ *
+ * Each task is a thread. The threads pass the run token under one lock,
+ * so exactly one of them runs the bridge code at a time: the task holding
+ * the token or the idle loop of the main thread, which also serves the
+ * peripheral events as the interrupts. The interrupts never preempt a task,
+ * they run once all the tasks are blocked; a task readying a higher priority
+ * one is preempted unless the scheduler is suspended or the interrupts are
+ * masked, as on the target.
+ */
+
+#include "sim.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+
+#define EVENTS_MAX              64
+
+// The task thread stack. The host code needs more than the target one
+#define THREAD_STACK_SIZE       (256 * 1024)
+
+// The kernel heap overhead per task: TCB
+#define TASK_TCB_SIZE           88
+
+// ============================================================================
+
+typedef enum {
+    TASK_READY = 0,             /// Ready or running
+    TASK_BLOCKED,
+    TASK_DELETED,
+} task_state_t;
+
+typedef enum {
+    WAIT_NONE = 0,
+    WAIT_DELAY,
+    WAIT_SEMAPHORE,
+    WAIT_QUEUE_GET,
+    WAIT_QUEUE_PUT,
+    WAIT_NOTIFY,
+} wait_t;
+
+typedef struct sim_task {
+    pthread_t thread;
+    pthread_cond_t cond;        /// Signalled when the task gets the run token
+
+    osThreadFunc_t func;
+    void *arg;
+
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t number;
+    int priority;
+    uint32_t stack_size;
+
+    task_state_t state;
+    uint64_t order;             /// Readiness or blocking order. FIFO among the equal priorities
+
+    wait_t wait;
+    void *wait_object;
+    void *wait_buffer;          /// The message of the queue wait
+    uint64_t wake_us;           /// The wait timeout. UINT64_MAX - none
+    bool woken;                 /// The wait is satisfied, not timed out
+
+    bool notify_pending;
+    uint32_t notify_value;
+
+    uint32_t run_time;
+
+    struct sim_task *next;
+} sim_task_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+} sim_semaphore_t;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t msg_size;
+    uint32_t head;
+    uint32_t used;
+    uint8_t mem[];
+} sim_queue_t;
+
+typedef struct {
+    uint32_t id;                /// 0 - free
+    uint64_t time_us;
+    uint64_t order;
+    int irq;
+    sim_event_handler_t handler;
+    void *ctx;
+} sim_event_t;
+
+/**
+ * @brief Kernel heap block header. Counted by the statistics
+ *
+ */
+typedef struct {
+    size_t size;
+    uint64_t align;
+} heap_header_t;
+
+// ============================================================================
+
+static void *task_entry(void *arg);
+static void main_entry(void *arg);
+static sim_task_t *task_create(osThreadFunc_t func, void *arg, const char *name, int priority, uint32_t stack_size);
+static sim_task_t *ready_pick(void);
+static void token_pass(sim_task_t *next);
+static void task_reschedule(sim_task_t *self);
+static bool task_block(wait_t wait, void *object, void *buffer, uint32_t ticks);
+static void task_wake(sim_task_t *task);
+static sim_task_t *waiter_find(wait_t wait, void *object);
+static void preempt_check(void);
+static void tasks_reap(void);
+static void timeouts_expire(void);
+static sim_event_t *event_next(void);
+static uint64_t wall_us(void);
+static void *heap_alloc(size_t size);
+static void heap_free(void *ptr);
+
+// ============================================================================
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+static sim_task_t *tasks = NULL;
+
+// The task holding the run token. NULL - the idle loop and the interrupts
+static sim_task_t *volatile running = NULL;
+
+static uint64_t order_counter;
+static UBaseType_t task_counter;
+
+static uint64_t now_us;
+
+static int suspend_count;
+static int critical_nesting;
+static bool yield_pending;
+static uint32_t primask;
+
+static bool in_isr;
+static int isr_irq;
+
+static sim_event_t events[EVENTS_MAX];
+static uint32_t event_counter;
+
+static sim_stats_t stats;
+
+static volatile bool main_done;
+static bool reset_requested;
+
+static sim_idle_hook_t realtime_hook = NULL;
+static uint64_t wall_start_us;
+
+static void (*main_func)(void *arg);
+static void *main_arg;
+
+// ============================================================================
+
+int sim_run(void (*main)(void *arg), void *arg, uint64_t time_limit_us)
+{
+    int result = -1;
+
+    sim_hal_init();
+
+    main_func = main;
+    main_arg = arg;
+    wall_start_us = wall_us();
+
+    pthread_mutex_lock(&lock);
+
+    task_create(main_entry, NULL, "main", osPriorityNormal, configMINIMAL_STACK_SIZE * 4);
+
+    while (1) {
+        tasks_reap();
+        sim_iwdg_poll();
+
+        if (main_done) {
+            result = 0;
+            break;
+        }
+
+        if (reset_requested) {
+            break;
+        }
+
+        sim_task_t *next = ready_pick();
+
+        if (next) {
+            token_pass(next);
+
+            while (running != NULL) {
+                pthread_cond_wait(&idle_cond, &lock);
+            }
+
+            continue;
+        }
+
+        sim_event_t *event = event_next();
+
+        if (event && event->time_us <= now_us) {
+            sim_event_t copy = *event;
+            event->id = 0;
+
+            in_isr = true;
+            isr_irq = copy.irq;
+            stats.isr_count++;
+
+            // The handler calls the kernel
+            pthread_mutex_unlock(&lock);
+            copy.handler(copy.ctx);
+            pthread_mutex_lock(&lock);
+
+            in_isr = false;
+            continue;
+        }
+
+        uint64_t wake_us = event ? event->time_us : UINT64_MAX;
+
+        for (sim_task_t *task = tasks; task; task = task->next) {
+            if (task->state == TASK_BLOCKED && task->wake_us < wake_us) {
+                wake_us = task->wake_us;
+            }
+        }
+
+        if (realtime_hook) {
+            uint64_t wall = wall_us() - wall_start_us;
+
+            if (wake_us > wall) {
+                pthread_mutex_unlock(&lock);
+                realtime_hook(wake_us == UINT64_MAX ? UINT64_MAX : wake_us - wall);
+                pthread_mutex_lock(&lock);
+
+                wall = wall_us() - wall_start_us;
+            }
+
+            // Up to the next event only: it comes before the timeouts that are due by the wall clock
+            if (wall > now_us) {
+                now_us = wall < wake_us ? wall : wake_us;
+            }
+
+            timeouts_expire();
+            continue;
+        }
+
+        if (wake_us == UINT64_MAX || (time_limit_us && wake_us > time_limit_us)) {
+            // Deadlock or out of time
+            break;
+        }
+
+        if (wake_us > now_us) {
+            now_us = wake_us;
+        }
+
+        timeouts_expire();
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+uint64_t sim_time_us(void)
+{
+    return now_us;
+}
+
+void sim_realtime_set(sim_idle_hook_t hook)
+{
+    realtime_hook = hook;
+}
+
+void sim_stats_get(sim_stats_t *stats_out)
+{
+    pthread_mutex_lock(&lock);
+
+    *stats_out = stats;
+    stats_out->reset = reset_requested;
+
+    pthread_mutex_unlock(&lock);
+
+    sim_hal_stats_get(stats_out);
+}
+
+uint32_t sim_event_schedule(uint64_t time_us, int irq, sim_event_handler_t handler, void *ctx)
+{
+    pthread_mutex_lock(&lock);
+
+    sim_event_t *event = NULL;
+
+    for (size_t q = 0; q < EVENTS_MAX; q++) {
+        if (events[q].id == 0) {
+            event = &events[q];
+            break;
+        }
+    }
+
+    assert(event);
+
+    if (++event_counter == 0) {
+        event_counter = 1;
+    }
+
+    event->id = event_counter;
+    event->time_us = time_us;
+    event->order = ++order_counter;
+    event->irq = irq;
+    event->handler = handler;
+    event->ctx = ctx;
+
+    pthread_mutex_unlock(&lock);
+
+    return event->id;
+}
+
+void sim_event_cancel(uint32_t id)
+{
+    pthread_mutex_lock(&lock);
+
+    for (size_t q = 0; q < EVENTS_MAX; q++) {
+        if (id != 0 && events[q].id == id) {
+            events[q].id = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+bool sim_in_isr(void)
+{
+    return in_isr;
+}
+
+void sim_system_reset(void)
+{
+    pthread_mutex_lock(&lock);
+
+    reset_requested = true;
+
+    sim_task_t *self = running;
+
+    if (self && !in_isr) {
+        // The task never runs again. The idle loop ends the simulation
+        self->state = TASK_BLOCKED;
+        self->wait = WAIT_NONE;
+        self->wake_us = UINT64_MAX;
+        task_reschedule(self);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+// ============================================================================
+// Run time statistics and interrupt masking
+
+unsigned long getRunTimeCounterValue(void)
+{
+    // The busy waits on the counter terminate
+    now_us++;
+
+    if (running && !in_isr) {
+        running->run_time++;
+    }
+
+    return (unsigned long)(uint32_t)now_us;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return primask;
+}
+
+void __set_PRIMASK(uint32_t value)
+{
+    primask = value;
+}
+
+void __disable_irq(void)
+{
+    primask = 1;
+}
+
+void __enable_irq(void)
+{
+    primask = 0;
+}
+
+uint32_t __get_IPSR(void)
+{
+    return in_isr ? 16 + isr_irq : 0;
+}
+
+void vPortEnterCritical(void)
+{
+    primask = 1;
+    critical_nesting++;
+}
+
+void vPortExitCritical(void)
+{
+    assert(critical_nesting > 0);
+
+    if (--critical_nesting == 0) {
+        primask = 0;
+
+        pthread_mutex_lock(&lock);
+        preempt_check();
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+uint32_t ulSetInterruptMaskFromISR(void)
+{
+    uint32_t mask = primask;
+
+    primask = 1;
+
+    return mask;
+}
+
+void vClearInterruptMaskFromISR(uint32_t mask)
+{
+    primask = mask;
+}
+
+void vPortYield(void)
+{
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *self = running;
+
+    if (self && !in_isr) {
+        self->order = ++order_counter;
+        task_reschedule(self);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+void vPortYieldFromISR(BaseType_t switch_required)
+{
+    // The woken task runs once the interrupt returns to the idle loop
+    (void)switch_required;
+}
+
+// ============================================================================
+// FreeRTOS API
+
+void vTaskSuspendAll(void)
+{
+    suspend_count++;
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    assert(suspend_count > 0);
+
+    if (--suspend_count > 0) {
+        return pdFALSE;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    bool yield = yield_pending;
+    preempt_check();
+
+    pthread_mutex_unlock(&lock);
+
+    return yield ? pdTRUE : pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)running;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action, uint32_t *previous)
+{
+    sim_task_t *task = (sim_task_t *)handle;
+
+    assert(task);
+
+    pthread_mutex_lock(&lock);
+
+    assert(task->state != TASK_DELETED);
+
+    if (previous) {
+        *previous = task->notify_value;
+    }
+
+    BaseType_t result = pdPASS;
+
+    switch (action) {
+        case eSetBits: task->notify_value |= value; break;
+        case eIncrement: task->notify_value++; break;
+        case eSetValueWithOverwrite: task->notify_value = value; break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                result = pdFAIL;
+            }
+            else {
+                task->notify_value = value;
+            }
+            break;
+        default: break;
+    }
+
+    task->notify_pending = true;
+
+    if (task->state == TASK_BLOCKED && task->wait == WAIT_NOTIFY) {
+        task_wake(task);
+        preempt_check();
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t handle, uint32_t value, eNotifyAction action,
+                                     uint32_t *previous, BaseType_t *woken)
+{
+    sim_task_t *task = (sim_task_t *)handle;
+
+    assert(task);
+
+    bool waiting = task->state == TASK_BLOCKED && task->wait == WAIT_NOTIFY;
+
+    BaseType_t result = xTaskGenericNotify(handle, value, action, previous);
+
+    if (waiting && woken) {
+        *woken = pdTRUE;
+    }
+
+    return result;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *self = running;
+
+    assert(self && !in_isr);
+
+    if (!self->notify_pending) {
+        self->notify_value &= ~clear_on_entry;
+
+        if (ticks > 0) {
+            task_block(WAIT_NOTIFY, NULL, NULL, ticks);
+        }
+    }
+
+    if (value) {
+        *value = self->notify_value;
+    }
+
+    BaseType_t result = pdFALSE;
+
+    if (self->notify_pending) {
+        self->notify_value &= ~clear_on_exit;
+        self->notify_pending = false;
+        result = pdTRUE;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+void vTaskGetInfo(TaskHandle_t handle, TaskStatus_t *info, BaseType_t stack_space, eTaskState state)
+{
+    (void)stack_space;
+    (void)state;
+
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *task = handle ? (sim_task_t *)handle : running;
+
+    assert(task && task->state != TASK_DELETED);
+
+    info->xHandle = (TaskHandle_t)task;
+    info->pcTaskName = task->name;
+    info->xTaskNumber = task->number;
+    info->eCurrentState = task == running ? eRunning : task->state == TASK_READY ? eReady : eBlocked;
+    info->uxCurrentPriority = task->priority;
+    info->uxBasePriority = task->priority;
+    info->ulRunTimeCounter = task->run_time;
+    info->pxStackBase = NULL;
+
+    // Not measured on the host
+    info->usStackHighWaterMark = task->stack_size / sizeof(StackType_t);
+
+    pthread_mutex_unlock(&lock);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t * const infos, const UBaseType_t size, uint32_t * const total)
+{
+    UBaseType_t count = 0;
+
+    for (sim_task_t *task = tasks; task && count < size; task = task->next) {
+        if (task->state != TASK_DELETED) {
+            vTaskGetInfo((TaskHandle_t)task, &infos[count++], pdTRUE, eInvalid);
+        }
+    }
+
+    if (total) {
+        *total = (uint32_t)now_us;
+    }
+
+    return count;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    UBaseType_t count = 0;
+
+    for (sim_task_t *task = tasks; task; task = task->next) {
+        count += task->state != TASK_DELETED;
+    }
+
+    return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+    TaskStatus_t info;
+
+    vTaskGetInfo(handle, &info, pdTRUE, eInvalid);
+
+    return info.usStackHighWaterMark;
+}
+
+void *pvPortMalloc(size_t size)
+{
+    pthread_mutex_lock(&lock);
+
+    void *ptr = heap_alloc(size);
+
+    pthread_mutex_unlock(&lock);
+
+    return ptr;
+}
+
+void vPortFree(void *ptr)
+{
+    pthread_mutex_lock(&lock);
+
+    heap_free(ptr);
+
+    pthread_mutex_unlock(&lock);
+}
+
+// ============================================================================
+// CMSIS-RTOS2 API
+
+uint32_t osKernelGetTickCount(void)
+{
+    return (uint32_t)(now_us / 1000);
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr)
+{
+    const char *name = attr && attr->name ? attr->name : "";
+    int priority = attr && attr->priority != osPriorityNone ? attr->priority : osPriorityNormal;
+    uint32_t stack_size = attr && attr->stack_size ? attr->stack_size : configMINIMAL_STACK_SIZE * 4;
+
+    if (sim_in_isr() || func == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *task = task_create(func, argument, name, priority, stack_size);
+
+    preempt_check();
+
+    pthread_mutex_unlock(&lock);
+
+    return (osThreadId_t)task;
+}
+
+void osThreadExit(void)
+{
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *self = running;
+
+    assert(self && !in_isr);
+
+    // The memory is freed by the idle loop
+    self->state = TASK_DELETED;
+    stats.tasks--;
+
+    task_reschedule(self);
+
+    pthread_mutex_unlock(&lock);
+    pthread_exit(NULL);
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+    if (sim_in_isr()) {
+        return osErrorISR;
+    }
+
+    if (ticks == 0) {
+        return osOK;
+    }
+
+    pthread_mutex_lock(&lock);
+    task_block(WAIT_DELAY, NULL, NULL, ticks);
+    pthread_mutex_unlock(&lock);
+
+    return osOK;
+}
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr)
+{
+    (void)attr;
+
+    if (sim_in_isr() || max_count == 0 || initial_count > max_count) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    sim_semaphore_t *sem = heap_alloc(sizeof(sim_semaphore_t));
+    sem->count = initial_count;
+    sem->max = max_count;
+
+    stats.semaphores++;
+
+    pthread_mutex_unlock(&lock);
+
+    return (osSemaphoreId_t)sem;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t id, uint32_t timeout)
+{
+    sim_semaphore_t *sem = (sim_semaphore_t *)id;
+
+    if (sem == NULL) {
+        return osErrorParameter;
+    }
+
+    if (sim_in_isr() && timeout != 0) {
+        return osErrorParameter;
+    }
+
+    osStatus_t status = osOK;
+
+    pthread_mutex_lock(&lock);
+
+    if (sem->count > 0) {
+        sem->count--;
+    }
+    else if (timeout == 0) {
+        status = osErrorResource;
+    }
+    else if (!task_block(WAIT_SEMAPHORE, sem, NULL, timeout)) {
+        status = osErrorTimeout;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return status;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t id)
+{
+    sim_semaphore_t *sem = (sim_semaphore_t *)id;
+
+    if (sem == NULL) {
+        return osErrorParameter;
+    }
+
+    osStatus_t status = osOK;
+
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *waiter = waiter_find(WAIT_SEMAPHORE, sem);
+
+    if (waiter) {
+        // The count is passed to the waiter directly
+        task_wake(waiter);
+        preempt_check();
+    }
+    else if (sem->count < sem->max) {
+        sem->count++;
+    }
+    else {
+        status = osErrorResource;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return status;
+}
+
+osStatus_t osSemaphoreDelete(osSemaphoreId_t id)
+{
+    sim_semaphore_t *sem = (sim_semaphore_t *)id;
+
+    if (sim_in_isr()) {
+        return osErrorISR;
+    }
+
+    if (sem == NULL) {
+        return osErrorParameter;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    assert(waiter_find(WAIT_SEMAPHORE, sem) == NULL);
+
+    heap_free(sem);
+    stats.semaphores--;
+
+    pthread_mutex_unlock(&lock);
+
+    return osOK;
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr)
+{
+    (void)attr;
+
+    if (sim_in_isr() || msg_count == 0 || msg_size == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    sim_queue_t *queue = heap_alloc(sizeof(sim_queue_t) + (size_t)msg_count * msg_size);
+    queue->capacity = msg_count;
+    queue->msg_size = msg_size;
+    queue->head = 0;
+    queue->used = 0;
+
+    stats.queues++;
+
+    pthread_mutex_unlock(&lock);
+
+    return (osMessageQueueId_t)queue;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t id, const void *msg, uint8_t prio, uint32_t timeout)
+{
+    sim_queue_t *queue = (sim_queue_t *)id;
+
+    (void)prio;
+
+    if (queue == NULL || msg == NULL || (sim_in_isr() && timeout != 0)) {
+        return osErrorParameter;
+    }
+
+    osStatus_t status = osOK;
+
+    pthread_mutex_lock(&lock);
+
+    sim_task_t *waiter = waiter_find(WAIT_QUEUE_GET, queue);
+
+    if (waiter) {
+        memcpy(waiter->wait_buffer, msg, queue->msg_size);
+        task_wake(waiter);
+        preempt_check();
+    }
+    else if (queue->used < queue->capacity) {
+        uint32_t tail = (queue->head + queue->used) % queue->capacity;
+
+        memcpy(queue->mem + (size_t)tail * queue->msg_size, msg, queue->msg_size);
+        queue->used++;
+    }
+    else if (timeout == 0) {
+        status = osErrorResource;
+    }
+    else if (!task_block(WAIT_QUEUE_PUT, queue, (void *)msg, timeout)) {
+        status = osErrorTimeout;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return status;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t id, void *msg, uint8_t *prio, uint32_t timeout)
+{
+    sim_queue_t *queue = (sim_queue_t *)id;
+
+    if (queue == NULL || msg == NULL || (sim_in_isr() && timeout != 0)) {
+        return osErrorParameter;
+    }
+
+    if (prio) {
+        *prio = 0;
+    }
+
+    osStatus_t status = osOK;
+
+    pthread_mutex_lock(&lock);
+
+    if (queue->used > 0) {
+        memcpy(msg, queue->mem + (size_t)queue->head * queue->msg_size, queue->msg_size);
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->used--;
+
+        // The blocked sender takes the freed slot
+        sim_task_t *waiter = waiter_find(WAIT_QUEUE_PUT, queue);
+
+        if (waiter) {
+            uint32_t tail = (queue->head + queue->used) % queue->capacity;
+
+            memcpy(queue->mem + (size_t)tail * queue->msg_size, waiter->wait_buffer, queue->msg_size);
+            queue->used++;
+
+            task_wake(waiter);
+            preempt_check();
+        }
+    }
+    else if (timeout == 0) {
+        status = osErrorResource;
+    }
+    else if (!task_block(WAIT_QUEUE_GET, queue, msg, timeout)) {
+        status = osErrorTimeout;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return status;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t id)
+{
+    sim_queue_t *queue = (sim_queue_t *)id;
+
+    return queue ? queue->used : 0;
+}
+
+// ============================================================================
+
+static void *task_entry(void *arg)
+{
+    sim_task_t *self = arg;
+
+    pthread_mutex_lock(&lock);
+
+    while (running != self) {
+        pthread_cond_wait(&self->cond, &lock);
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    self->func(self->arg);
+
+    osThreadExit();
+
+    return NULL;
+}
+
+static void main_entry(void *arg)
+{
+    (void)arg;
+
+    main_func(main_arg);
+
+    main_done = true;
+}
+
+/**
+ * @brief Create the ready task. Called with the lock held
+ *
+ */
+static sim_task_t *task_create(osThreadFunc_t func, void *arg, const char *name, int priority, uint32_t stack_size)
+{
+    sim_task_t *task = calloc(1, sizeof(sim_task_t));
+    assert(task);
+
+    pthread_cond_init(&task->cond, NULL);
+
+    task->func = func;
+    task->arg = arg;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->number = ++task_counter;
+    task->priority = priority;
+    task->stack_size = stack_size;
+    task->state = TASK_READY;
+    task->order = ++order_counter;
+    task->wake_us = UINT64_MAX;
+
+    task->next = tasks;
+    tasks = task;
+
+    // The kernel allocates the TCB and the stack on its heap
+    stats.tasks++;
+    stats.heap_blocks += 2;
+    stats.heap_bytes += TASK_TCB_SIZE + stack_size;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    int status = pthread_create(&task->thread, &attr, task_entry, task);
+    assert(status == 0);
+    (void)status;
+
+    pthread_attr_destroy(&attr);
+
+    return task;
+}
+
+/**
+ * @brief Find the highest priority ready task. The earliest readied among the equal ones
+ *
+ */
+static sim_task_t *ready_pick(void)
+{
+    sim_task_t *best = NULL;
+
+    for (sim_task_t *task = tasks; task; task = task->next) {
+        if (task->state != TASK_READY) {
+            continue;
+        }
+
+        if (best == NULL || task->priority > best->priority ||
+            (task->priority == best->priority && task->order < best->order)) {
+            best = task;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Pass the run token. Called with the lock held
+ *
+ * @param next The task. NULL - the idle loop
+ */
+static void token_pass(sim_task_t *next)
+{
+    running = next;
+
+    if (next) {
+        pthread_cond_signal(&next->cond);
+    }
+    else {
+        pthread_cond_signal(&idle_cond);
+    }
+}
+
+/**
+ * @brief Run the next task and wait for the token back. Called by the running task with the lock held
+ *
+ */
+static void task_reschedule(sim_task_t *self)
+{
+    sim_task_t *next = ready_pick();
+
+    if (next == self) {
+        return;
+    }
+
+    token_pass(next);
+
+    if (self->state == TASK_DELETED) {
+        return;
+    }
+
+    while (running != self) {
+        pthread_cond_wait(&self->cond, &lock);
+    }
+}
+
+/**
+ * @brief Block the running task. Called with the lock held
+ *
+ * @return true - woken, false - timeout
+ */
+static bool task_block(wait_t wait, void *object, void *buffer, uint32_t ticks)
+{
+    sim_task_t *self = running;
+
+    // Blocking is not allowed in the interrupts, with the scheduler suspended or the interrupts masked
+    assert(self && !in_isr);
+    assert(suspend_count == 0 && critical_nesting == 0);
+
+    self->state = TASK_BLOCKED;
+    self->wait = wait;
+    self->wait_object = object;
+    self->wait_buffer = buffer;
+    self->woken = false;
+    self->order = ++order_counter;
+
+    // The tick period boundaries as the tick interrupt
+    self->wake_us = ticks == osWaitForever ? UINT64_MAX : (now_us / 1000 + ticks) * 1000;
+
+    task_reschedule(self);
+
+    return self->woken;
+}
+
+/**
+ * @brief Ready the blocked task with its wait satisfied. Called with the lock held
+ *
+ */
+static void task_wake(sim_task_t *task)
+{
+    task->state = TASK_READY;
+    task->wait = WAIT_NONE;
+    task->wake_us = UINT64_MAX;
+    task->woken = true;
+    task->order = ++order_counter;
+}
+
+/**
+ * @brief Find the highest priority task waiting for the object. The earliest blocked among the equal ones
+ *
+ */
+static sim_task_t *waiter_find(wait_t wait, void *object)
+{
+    sim_task_t *best = NULL;
+
+    for (sim_task_t *task = tasks; task; task = task->next) {
+        if (task->state != TASK_BLOCKED || task->wait != wait || task->wait_object != object) {
+            continue;
+        }
+
+        if (best == NULL || task->priority > best->priority ||
+            (task->priority == best->priority && task->order < best->order)) {
+            best = task;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Switch to the higher priority ready task. Called with the lock held
+ *
+ * Deferred while the scheduler is suspended or the interrupts are masked.
+ * The interrupts switch on the return to the idle loop
+ */
+static void preempt_check(void)
+{
+    sim_task_t *self = running;
+
+    if (self == NULL || in_isr) {
+        return;
+    }
+
+    sim_task_t *best = ready_pick();
+
+    if (best == NULL || best == self || best->priority <= self->priority) {
+        return;
+    }
+
+    if (suspend_count > 0 || critical_nesting > 0) {
+        yield_pending = true;
+        return;
+    }
+
+    yield_pending = false;
+
+    self->order = ++order_counter;
+    task_reschedule(self);
+}
+
+/**
+ * @brief Free the deleted tasks as the idle task does
+ *
+ */
+static void tasks_reap(void)
+{
+    sim_task_t **link = &tasks;
+
+    while (*link) {
+        sim_task_t *task = *link;
+
+        if (task->state != TASK_DELETED) {
+            link = &task->next;
+            continue;
+        }
+
+        *link = task->next;
+
+        stats.heap_blocks -= 2;
+        stats.heap_bytes -= TASK_TCB_SIZE + task->stack_size;
+
+        // The thread has released the lock for the last time
+        pthread_cond_destroy(&task->cond);
+        free(task);
+    }
+}
+
+static void timeouts_expire(void)
+{
+    for (sim_task_t *task = tasks; task; task = task->next) {
+        if (task->state == TASK_BLOCKED && task->wake_us <= now_us) {
+            task->state = TASK_READY;
+            task->wait = WAIT_NONE;
+            task->wake_us = UINT64_MAX;
+            task->woken = false;
+            task->order = ++order_counter;
+        }
+    }
+}
+
+static sim_event_t *event_next(void)
+{
+    sim_event_t *next = NULL;
+
+    for (size_t q = 0; q < EVENTS_MAX; q++) {
+        sim_event_t *event = &events[q];
+
+        if (event->id != 0 &&
+            (next == NULL || event->time_us < next->time_us ||
+             (event->time_us == next->time_us && event->order < next->order))) {
+            next = event;
+        }
+    }
+
+    return next;
+}
+
+static uint64_t wall_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *heap_alloc(size_t size)
+{
+    heap_header_t *header = malloc(sizeof(heap_header_t) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = size;
+
+    stats.heap_blocks++;
+    stats.heap_bytes += size;
+
+    return header + 1;
+}
+
+static void heap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    heap_header_t *header = (heap_header_t *)ptr - 1;
+
+    stats.heap_blocks--;
+    stats.heap_bytes -= header->size;
+
+    free(header);
+}
@@ -0,0 +1,239 @@
+/**
+ * @file sim.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host simulation of the kernel and the bridge peripherals.
+ *
+ * The bridge units are compiled unchanged against the real HAL and CMSIS-RTOS2
+ * headers. sim-rtos.c implements the kernel calls they use: each task is a
+ * thread, one of them runs at a time, the highest priority ready task first.
+ * The time is virtual and moves on only when all the tasks are blocked,
+ * to the next peripheral event or the task timeout. The peripheral events
+ * are served as the interrupts between the task runs.
+ *
+ * sim-hal.c models the USART (the bytes take their line time at the
+ * configured baud rate, 8N1) and the SPI master with its slave (the
+ * transaction takes its clock time at the configured prescaler of 64 MHz).
+ * Only the full-duplex UART link is modelled: the half-duplex, RS-485 and
+ * low power reception calls succeed without an effect on the line.
+ *
+ * The model keeps the interfaces and the ordering of the target, not its
+ * timing: the code runs in zero virtual time apart from one microsecond per
+ * run time counter read. The task stacks are not measured.
+ *
+ * The peripherals model injects the faults with the configured probabilities
+ * (see \ref sim_fault_set): the HAL callbacks are dropped, delayed or called
+ * with the errors, the received data is corrupted. The bridge takes them as
+ * the hardware faults. The pseudo-random sequence is reproducible from the seed.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+/**
+ * @brief SPI slave behaviour
+ *
+ */
+typedef enum {
+    SIM_SLAVE_ECHO = 0,         /// Returns each string received on MOSI
+    SIM_SLAVE_SILENT,           /// Sends the data pushed by \ref sim_spi_slave_send only
+} sim_slave_mode_t;
+
+/**
+ * @brief Fault types. The probabilities are per event: per received UART byte,
+ * per UART transmission, per SPI transaction and per interrupt
+ *
+ */
+typedef enum {
+    SIM_FAULT_UART_FRAMING = 0, /// The received UART byte has the framing error
+    SIM_FAULT_UART_OVERRUN,     /// The received UART byte is lost by the overrun
+    SIM_FAULT_UART_TX_DROP,     /// The UART transmission complete interrupt is lost
+    SIM_FAULT_SPI_DROP,         /// The SPI DMA complete interrupt is lost
+    SIM_FAULT_SPI_ERROR,        /// The SPI transaction ends with the DMA error. The slave data is lost
+    SIM_FAULT_BIT_FLIP,         /// A bit of the received UART byte or the SPI transaction data is flipped
+    SIM_FAULT_IRQ_DELAY,        /// The interrupt is served \ref SIM_FAULT_DELAY_US later
+    SIM_FAULT_COUNT
+} sim_fault_t;
+
+/**
+ * @brief Simulation counters
+ *
+ */
+typedef struct {
+    size_t tasks;               /// The tasks alive
+    size_t heap_blocks;         /// The kernel heap blocks in use
+    size_t heap_bytes;
+    size_t semaphores;          /// The semaphores and the message queues alive
+    size_t queues;
+    uint32_t isr_count;         /// The interrupts served
+    uint32_t uart_rx_overruns;  /// The UART bytes lost: the reception was not armed
+    uint32_t spi_transactions;
+    bool iwdg_started;
+    bool reset;                 /// The MCU reset by the watchdog or the software
+} sim_stats_t;
+
+/**
+ * @brief Idle hook of the real-time mode. Called with the time to wait
+ *
+ * @param timeout_us The time to the next event. UINT64_MAX - no events
+ */
+typedef void (*sim_idle_hook_t)(uint64_t timeout_us);
+
+// ============================================================================
+
+// The delay of the delayed interrupt. The UART receiver keeps receiving meanwhile
+#define SIM_FAULT_DELAY_US      200
+
+// ============================================================================
+
+/**
+ * @brief Run the function as the first task until it returns
+ *
+ * The other tasks are left blocked, so one simulation runs per process
+ *
+ * @param main The task function
+ * @param arg The task argument
+ * @param time_limit_us The virtual time limit. 0 - none
+ * @return 0 - the function has returned, -1 - the time limit, the deadlock or the reset
+ */
+int sim_run(void (*main)(void *arg), void *arg, uint64_t time_limit_us);
+
+/**
+ * @brief Get the virtual time
+ *
+ */
+uint64_t sim_time_us(void);
+
+/**
+ * @brief Follow the wall clock instead of jumping to the next event
+ *
+ * The hook is called by the idle loop instead of the sleep. It may push
+ * the UART and SPI input
+ */
+void sim_realtime_set(sim_idle_hook_t hook);
+
+void sim_stats_get(sim_stats_t *stats);
+
+// ----------------------------------------------------------------------------
+// The line models. Called from the tasks or the idle hook
+
+/**
+ * @brief Send the bytes to the UART RX line. They arrive at the line rate
+ *
+ */
+void sim_uart_send(const void *data, size_t length);
+
+/**
+ * @brief Take the bytes transmitted to the UART TX line
+ *
+ * @return The number of bytes taken
+ */
+size_t sim_uart_receive(void *data, size_t size);
+
+/**
+ * @brief Wire the UART TX to RX
+ *
+ */
+void sim_uart_loopback_set(bool loopback);
+
+void sim_spi_slave_set(sim_slave_mode_t mode);
+
+/**
+ * @brief Queue the slave data to MISO. It is clocked out by the next transactions
+ *
+ */
+void sim_spi_slave_send(const void *data, size_t length);
+
+/**
+ * @brief Take the bytes the slave received on MOSI. The '\0' bytes are dropped
+ *
+ * The bridge forwards the UART bytes as they arrive, so a string may be split
+ * by the '\0' of the polling at any byte
+ *
+ * @return The number of bytes taken
+ */
+size_t sim_spi_slave_receive(void *data, size_t size);
+
+// ----------------------------------------------------------------------------
+// The fault injection. Reset to none by \ref sim_run
+
+/**
+ * @brief Set the fault probability
+ *
+ * @param fault The fault type
+ * @param probability_ppm The probability per event in parts per million. 0 - never
+ */
+void sim_fault_set(sim_fault_t fault, uint32_t probability_ppm);
+
+/**
+ * @brief Restart the pseudo-random sequence and clear the injected faults counters
+ *
+ * @param seed The seed. 0 - the default one
+ */
+void sim_fault_seed(uint32_t seed);
+
+/**
+ * @brief Get the fault probability and the number of the injected faults
+ *
+ * @return The fault name, NULL - no such fault
+ */
+const char *sim_fault_get(sim_fault_t fault, uint32_t *probability_ppm, uint32_t *injected);
+
+// ----------------------------------------------------------------------------
+// The kernel internals used by the peripheral model
+
+/**
+ * @brief Peripheral event handler. Runs as the interrupt
+ *
+ */
+typedef void (*sim_event_handler_t)(void *ctx);
+
+/**
+ * @brief Schedule the peripheral event
+ *
+ * @param time_us The event time
+ * @param irq The interrupt number reported by the IPSR
+ * @return The event id. Never 0
+ */
+uint32_t sim_event_schedule(uint64_t time_us, int irq, sim_event_handler_t handler, void *ctx);
+
+/**
+ * @brief Cancel the event if it is still pending
+ *
+ */
+void sim_event_cancel(uint32_t id);
+
+/**
+ * @brief Check if the caller is the interrupt
+ *
+ */
+bool sim_in_isr(void);
+
+/**
+ * @brief Reset the peripherals model. Called by \ref sim_run
+ *
+ */
+void sim_hal_init(void);
+
+/**
+ * @brief Poll the watchdog registers. Called by the idle loop
+ *
+ */
+void sim_iwdg_poll(void);
+
+/**
+ * @brief Add the peripherals counters
+ *
+ */
+void sim_hal_stats_get(sim_stats_t *stats);
+
+void sim_system_reset(void);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,18 @@
+/**
+ * @file spi.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host replacement of Core/Inc/spi.h. The handle is defined by sim-hal.c
+ */
+
+#ifndef __SPI_H__
+#define __SPI_H__
+
+#include "main.h"
+
+extern SPI_HandleTypeDef hspi1;
+
+void MX_SPI1_Init(void);
+
+#endif /* __SPI_H__ */
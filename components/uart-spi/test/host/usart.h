@@ -0,0 +1,18 @@
+/**
+ * @file usart.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host replacement of Core/Inc/usart.h. The handle is defined by sim-hal.c
+ */
+
+#ifndef __USART_H__
+#define __USART_H__
+
+#include "main.h"
+
+extern UART_HandleTypeDef huart1;
+
+void MX_USART1_UART_Init(void);
+
+#endif /* __USART_H__ */
@@ -0,0 +1,70 @@
+/**
+ * @file miso-model.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Reference model of the MISO string filter written straight from the
+ * uart-spi-miso.h definition: the stream is split into the non-zero runs,
+ * each run followed by a '\0' is output with one terminator, the trailing
+ * unterminated run is output as is.
+ */
+
+#ifndef MISO_MODEL_H_
+#define MISO_MODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+// ============================================================================
+
+/**
+ * @brief Filter the whole stream started from the reset state
+ *
+ * @return The output length
+ */
+static inline size_t miso_model(const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t count = 0;
+    size_t q = 0;
+
+    while (q < length) {
+        // Skip the '\0' run
+        while (q < length && in[q] == '\0') {
+            q++;
+        }
+
+        size_t start = q;
+        while (q < length && in[q] != '\0') {
+            q++;
+        }
+
+        memcpy(out + count, in + start, q - start);
+        count += q - start;
+
+        if (q < length) {
+            out[count++] = '\0';
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Check the output guarantees that do not depend on the input
+ *
+ * @return true - no empty strings and no '\0' runs
+ */
+static inline bool miso_model_check(const uint8_t *out, size_t length)
+{
+    for (size_t q = 0; q < length; q++) {
+        if (out[q] == '\0' && (q == 0 || out[q - 1] == '\0')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* MISO_MODEL_H_ */
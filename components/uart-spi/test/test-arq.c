@@ -0,0 +1,598 @@
+/**
+ * @file test-arq.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the ARQ sender against a selective repeat receiver model.
+ *
+ * The fixed cases check the selective acknowledgement fast retransmission,
+ * the retransmission timeout doubling and its limit. The random runs pass
+ * the frames and the acknowledgements over a lossy link with random delays,
+ * so both are dropped and reordered. The receiver must get every string
+ * exactly once and in order.
+ */
+
+#include "test.h"
+
+#include "uart-spi-arq.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define RUNS                40
+#define STRINGS_PER_RUN     300
+#define STRING_LENGTH_MAX   300
+#define LINK_EVENTS_MAX     4096
+#define RUN_TIME_MAX_MS     600000
+
+// The receiver keeps the frames up to the selective acknowledgement range ahead
+#define RX_AHEAD            33
+
+#define BYTE_RATE           11520
+
+// ============================================================================
+
+/**
+ * @brief Frame or acknowledgement in flight
+ *
+ */
+typedef struct {
+    uint32_t arrival_ms;
+    size_t length;
+    uint8_t data[UART_SPI_ARQ_FRAME_SIZE];
+} link_event_t;
+
+typedef struct {
+    link_event_t events[LINK_EVENTS_MAX];
+    size_t count;
+    unsigned loss;              /// The loss probability in percents
+    uint32_t delay_min_ms;
+    uint32_t delay_max_ms;
+} link_t;
+
+/**
+ * @brief Selective repeat receiver model
+ *
+ */
+typedef struct {
+    uint8_t next;               /// The next expected sequence number
+    bool held[RX_AHEAD];        /// The frames received out of order. Index n - \c next + 1 + n
+    uint8_t frames[RX_AHEAD][UART_SPI_ARQ_FRAME_SIZE];
+    size_t lengths[RX_AHEAD];
+
+    uint8_t string[STRING_LENGTH_MAX + UART_SPI_ARQ_FRAME_SIZE];
+    size_t string_length;
+
+    size_t received;            /// The number of the strings reassembled
+    size_t duplicates;
+    bool failed;
+} receiver_t;
+
+// ============================================================================
+
+static void test_parse(void);
+static void test_sack_retransmit(void);
+static void test_rto_backoff(void);
+static void test_stale_ack(void);
+static void test_wrap(void);
+static void test_random(unsigned loss, uint32_t delay_min_ms, uint32_t delay_max_ms);
+
+static void link_push(link_t *link, const void *data, size_t length, uint32_t now_ms);
+static bool link_pop(link_t *link, uint32_t now_ms, link_event_t *event);
+
+static void receiver_frame(receiver_t *rx, const uint8_t *frame, size_t length,
+    const uint8_t (*strings)[STRING_LENGTH_MAX + 1], const size_t *lengths, size_t count);
+static size_t receiver_ack(const receiver_t *rx, uint8_t *ack);
+static void ack_pass(uart_spi_arq_t *arq, const uint8_t *ack, size_t length, uint32_t now_ms);
+static uint8_t frame_seq(const uint8_t *frame);
+static uint32_t random_range(uint32_t min, uint32_t max);
+
+// ============================================================================
+
+static link_t frames_link;
+static link_t acks_link;
+
+static uint8_t strings[STRINGS_PER_RUN][STRING_LENGTH_MAX + 1];
+static size_t string_lengths[STRINGS_PER_RUN];
+
+// ============================================================================
+
+int main(void)
+{
+    srand(2026);
+
+    test_parse();
+    test_sack_retransmit();
+    test_rto_backoff();
+    test_stale_ack();
+    test_wrap();
+
+    // Clean link, then the loss and the reordering of both directions
+    test_random(0, 5, 5);
+    test_random(0, 2, 40);
+    test_random(10, 5, 30);
+    test_random(30, 1, 60);
+
+    return test_done("arq");
+}
+
+// ============================================================================
+
+static void test_parse(void)
+{
+    uint8_t next;
+    uint32_t sack;
+
+    TEST_CHECK(uart_spi_arq_ack_parse("1f80000001", 10, &next, &sack) == 0);
+    TEST_CHECK(next == 0x1F && sack == 0x80000001);
+
+    TEST_CHECK(uart_spi_arq_ack_parse("A0DEADbeef", 10, &next, &sack) == 0);
+    TEST_CHECK(next == 0xA0 && sack == 0xDEADBEEF);
+
+    TEST_CHECK(uart_spi_arq_ack_parse("1f8000000", 9, &next, &sack) == -1);
+    TEST_CHECK(uart_spi_arq_ack_parse("1g80000001", 10, &next, &sack) == -1);
+}
+
+/**
+ * @brief The frame sent before the selectively acknowledged one is retransmitted at once
+ *
+ */
+static void test_sack_retransmit(void)
+{
+    uart_spi_arq_t arq;
+    uart_spi_arq_init(&arq, BYTE_RATE);
+
+    TEST_CHECK(arq.window >= 4);
+
+    for (int q = 0; q < 4; q++) {
+        TEST_CHECK(uart_spi_arq_append(&arq, "ab", 3) == 3);
+    }
+
+    size_t length;
+    for (int q = 0; q < 4; q++) {
+        const uint8_t *frame = uart_spi_arq_next(&arq, q, &length);
+        TEST_CHECK(frame && frame_seq(frame) == q && length == 6);
+    }
+
+    TEST_CHECK(uart_spi_arq_next(&arq, 4, &length) == NULL);
+
+    // Frame 0 received, 1 lost, 2 received out of order
+    uart_spi_arq_ack(&arq, 1, 0x1, 20);
+
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 3);
+    TEST_CHECK(uart_spi_arq_timeout(&arq, 20) == 0);
+
+    const uint8_t *frame = uart_spi_arq_next(&arq, 20, &length);
+    TEST_CHECK(frame && frame_seq(frame) == 1);
+    TEST_CHECK(arq.retransmissions == 1 && arq.timeouts == 0);
+
+    // Frame 3 is not known lost: it is sent after frame 2
+    TEST_CHECK(uart_spi_arq_next(&arq, 20, &length) == NULL);
+
+    uart_spi_arq_ack(&arq, 4, 0, 40);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 0);
+    TEST_CHECK(uart_spi_arq_timeout(&arq, 40) == UINT32_MAX);
+}
+
+/**
+ * @brief The timeout doubles on each expiration up to the limit and resets on the sample
+ *
+ */
+static void test_rto_backoff(void)
+{
+    uart_spi_arq_t arq;
+    uart_spi_arq_init(&arq, BYTE_RATE);
+
+    TEST_CHECK(uart_spi_arq_append(&arq, "x", 2) == 2);
+
+    uint32_t now = 0;
+    uint32_t rto = UART_SPI_ARQ_RTO_INITIAL_MS;
+    size_t length;
+
+    TEST_CHECK(uart_spi_arq_next(&arq, now, &length) != NULL);
+
+    for (int q = 0; q < 8; q++) {
+        TEST_CHECK(arq.rto == rto);
+        TEST_CHECK(uart_spi_arq_timeout(&arq, now + 1) == rto - 1);
+        TEST_CHECK(uart_spi_arq_next(&arq, now + rto - 1, &length) == NULL);
+
+        now += rto;
+
+        const uint8_t *frame = uart_spi_arq_next(&arq, now, &length);
+        TEST_CHECK(frame && frame_seq(frame) == 0);
+        TEST_CHECK(arq.timeouts == (uint32_t)q + 1);
+
+        rto = rto * 2 > UART_SPI_ARQ_RTO_MAX_MS ? UART_SPI_ARQ_RTO_MAX_MS : rto * 2;
+    }
+
+    TEST_CHECK(arq.rto == UART_SPI_ARQ_RTO_MAX_MS);
+
+    // The retransmitted frame gives no sample (Karn's rule), the timeout stays
+    uart_spi_arq_ack(&arq, 1, 0, now + 5);
+    TEST_CHECK(arq.rto == UART_SPI_ARQ_RTO_MAX_MS);
+
+    // A frame transmitted once does
+    TEST_CHECK(uart_spi_arq_append(&arq, "y", 2) == 2);
+    TEST_CHECK(uart_spi_arq_next(&arq, now + 10, &length) != NULL);
+    uart_spi_arq_ack(&arq, 2, 0, now + 30);
+
+    TEST_CHECK(arq.rto >= UART_SPI_ARQ_RTO_MIN_MS && arq.rto < 100);
+}
+
+/**
+ * @brief The acknowledgements outside the window are ignored
+ *
+ */
+static void test_stale_ack(void)
+{
+    uart_spi_arq_t arq;
+    uart_spi_arq_init(&arq, BYTE_RATE);
+
+    size_t length;
+
+    TEST_CHECK(uart_spi_arq_append(&arq, "a", 2) == 2);
+    TEST_CHECK(uart_spi_arq_append(&arq, "b", 2) == 2);
+    TEST_CHECK(uart_spi_arq_next(&arq, 0, &length) != NULL);
+
+    // Frame 1 is not transmitted yet
+    uart_spi_arq_ack(&arq, 2, 0, 1);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 2);
+
+    uart_spi_arq_ack(&arq, 0x80, 0, 1);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 2);
+
+    uart_spi_arq_ack(&arq, 1, 0, 2);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 1);
+
+    // The late duplicate acknowledgement is behind the base now
+    uart_spi_arq_ack(&arq, 0, 0, 3);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 1);
+}
+
+/**
+ * @brief The full window wraps the sequence numbers past 255
+ *
+ * Each frame carries its own sequence number as the data, so a frame
+ * overwritten or acknowledged for another one in the same slot shows up
+ */
+static void test_wrap(void)
+{
+    // The bandwidth-delay product of the fast line covers the largest window
+    uart_spi_arq_t arq;
+    uart_spi_arq_init(&arq, BYTE_RATE * 100);
+
+    size_t length;
+    uint32_t now = 0;
+    uint8_t start = 256 - UART_SPI_ARQ_WINDOW_MAX / 2;
+
+    // Move the base to the end of the sequence numbers one frame at a time
+    for (unsigned q = 0; q < start; q++) {
+        TEST_CHECK(uart_spi_arq_append(&arq, "", 1) == 1);
+        TEST_CHECK(uart_spi_arq_next(&arq, now, &length) != NULL);
+
+        now += 10;
+        uart_spi_arq_ack(&arq, q + 1, 0, now);
+    }
+
+    TEST_CHECK(arq.base == start && arq.window == UART_SPI_ARQ_WINDOW_MAX);
+
+    for (unsigned q = 0; q < UART_SPI_ARQ_WINDOW_MAX; q++) {
+        char text[3];
+        snprintf(text, sizeof(text), "%02x", (uint8_t)(start + q));
+        TEST_CHECK(uart_spi_arq_append(&arq, text, sizeof(text)) == sizeof(text));
+    }
+
+    TEST_CHECK(uart_spi_arq_append(&arq, "x", 2) == 0);
+
+    for (unsigned q = 0; q < UART_SPI_ARQ_WINDOW_MAX; q++) {
+        const uint8_t *frame = uart_spi_arq_next(&arq, now, &length);
+        TEST_CHECK(frame && frame_seq(frame) == (uint8_t)(start + q));
+        TEST_CHECK(frame && memcmp(frame + UART_SPI_ARQ_HEADER_LENGTH, frame + 1, 2) == 0);
+    }
+
+    // The first frame is lost, the rest of the window is received
+    uart_spi_arq_ack(&arq, start, (1UL << (UART_SPI_ARQ_WINDOW_MAX - 1)) - 1, now + 10);
+
+    const uint8_t *frame = uart_spi_arq_next(&arq, now + 10, &length);
+    TEST_CHECK(frame && frame_seq(frame) == start);
+    TEST_CHECK(frame && memcmp(frame + UART_SPI_ARQ_HEADER_LENGTH, frame + 1, 2) == 0);
+    TEST_CHECK(uart_spi_arq_next(&arq, now + 10, &length) == NULL);
+
+    uart_spi_arq_ack(&arq, start + UART_SPI_ARQ_WINDOW_MAX, 0, now + 20);
+    TEST_CHECK(uart_spi_arq_in_flight(&arq) == 0);
+    TEST_CHECK(arq.base == (uint8_t)(start + UART_SPI_ARQ_WINDOW_MAX));
+}
+
+/**
+ * @brief Pass random strings over the lossy reordering link
+ *
+ * @param loss The frame and acknowledgement loss probability in percents
+ */
+static void test_random(unsigned loss, uint32_t delay_min_ms, uint32_t delay_max_ms)
+{
+    size_t retransmissions = 0;
+
+    for (int run = 0; run < RUNS; run++) {
+        for (size_t q = 0; q < STRINGS_PER_RUN; q++) {
+            string_lengths[q] = random_range(0, STRING_LENGTH_MAX);
+
+            for (size_t w = 0; w < string_lengths[q]; w++) {
+                strings[q][w] = random_range(1, 255);
+            }
+            strings[q][string_lengths[q]] = '\0';
+        }
+
+        static uart_spi_arq_t arq;
+        static receiver_t rx;
+
+        uart_spi_arq_init(&arq, BYTE_RATE);
+        memset(&rx, 0, sizeof(rx));
+
+        frames_link = (link_t){ .loss = loss, .delay_min_ms = delay_min_ms, .delay_max_ms = delay_max_ms };
+        acks_link = frames_link;
+
+        size_t string = 0;
+        size_t offset = 0;
+        uint32_t now = 0;
+        uint32_t line_free_ms = 0;
+
+        while ((string < STRINGS_PER_RUN || uart_spi_arq_in_flight(&arq) > 0) && now < RUN_TIME_MAX_MS && !rx.failed) {
+            link_event_t event;
+
+            while (link_pop(&acks_link, now, &event)) {
+                ack_pass(&arq, event.data, event.length, now);
+            }
+
+            // The strings come in random pieces, some of them are flushed unfinished
+            while (string < STRINGS_PER_RUN) {
+                size_t left = string_lengths[string] + 1 - offset;
+                size_t piece = random_range(1, left);
+
+                size_t appended = uart_spi_arq_append(&arq, strings[string] + offset, piece);
+                if (appended == 0) {
+                    break;
+                }
+
+                TEST_CHECK(appended <= piece);
+
+                offset += appended;
+                if (offset == string_lengths[string] + 1) {
+                    string++;
+                    offset = 0;
+                }
+                else if (random_range(0, 9) == 0) {
+                    uart_spi_arq_flush(&arq);
+                }
+            }
+
+            if (string == STRINGS_PER_RUN) {
+                uart_spi_arq_flush(&arq);
+            }
+
+            // The line transmits one frame at a time at the line rate
+            if (now >= line_free_ms) {
+                size_t length;
+                const uint8_t *frame = uart_spi_arq_next(&arq, now, &length);
+
+                if (frame) {
+                    TEST_CHECK(length >= UART_SPI_ARQ_HEADER_LENGTH + 1 && length <= UART_SPI_ARQ_FRAME_SIZE);
+                    TEST_CHECK(frame[length - 1] == '\0');
+                    TEST_CHECK(memchr(frame, '\0', length) == frame + length - 1);
+
+                    link_push(&frames_link, frame, length, now);
+                    line_free_ms = now + (uint32_t)(length * 1000 / BYTE_RATE) + 1;
+                }
+            }
+
+            while (link_pop(&frames_link, now, &event)) {
+                receiver_frame(&rx, event.data, event.length, strings, string_lengths, STRINGS_PER_RUN);
+
+                uint8_t ack[UART_SPI_ARQ_ACK_LENGTH + 2];
+                link_push(&acks_link, ack, receiver_ack(&rx, ack), now);
+            }
+
+            // The window shrinks with the round-trip time, the frames in flight stay
+            TEST_CHECK(uart_spi_arq_in_flight(&arq) <= UART_SPI_ARQ_WINDOW_MAX);
+
+            now++;
+        }
+
+        TEST_CHECK(!rx.failed);
+        TEST_CHECK(rx.received == STRINGS_PER_RUN);
+        TEST_CHECK(uart_spi_arq_in_flight(&arq) == 0);
+        TEST_CHECK(arq.rto >= UART_SPI_ARQ_RTO_MIN_MS && arq.rto <= UART_SPI_ARQ_RTO_MAX_MS);
+
+        if (loss == 0 && delay_min_ms == delay_max_ms) {
+            TEST_CHECK(arq.retransmissions == 0 && rx.duplicates == 0);
+        }
+
+        retransmissions += arq.retransmissions;
+    }
+
+    if (loss > 0) {
+        TEST_CHECK(retransmissions > 0);
+    }
+}
+
+// ============================================================================
+
+static void link_push(link_t *link, const void *data, size_t length, uint32_t now_ms)
+{
+    if (random_range(0, 99) < link->loss) {
+        return;
+    }
+
+    TEST_CHECK(link->count < LINK_EVENTS_MAX);
+    if (link->count == LINK_EVENTS_MAX) {
+        return;
+    }
+
+    link_event_t *event = &link->events[link->count++];
+
+    event->arrival_ms = now_ms + random_range(link->delay_min_ms, link->delay_max_ms);
+    event->length = length;
+    memcpy(event->data, data, length);
+}
+
+/**
+ * @brief Get the earliest event arrived by now
+ *
+ */
+static bool link_pop(link_t *link, uint32_t now_ms, link_event_t *event)
+{
+    size_t found = link->count;
+
+    for (size_t q = 0; q < link->count; q++) {
+        if (link->events[q].arrival_ms <= now_ms &&
+            (found == link->count || link->events[q].arrival_ms < link->events[found].arrival_ms)) {
+            found = q;
+        }
+    }
+
+    if (found == link->count) {
+        return false;
+    }
+
+    *event = link->events[found];
+    link->events[found] = link->events[--link->count];
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Receive the frame, reassemble and verify the strings
+ *
+ */
+static void receiver_frame(receiver_t *rx, const uint8_t *frame, size_t length,
+    const uint8_t (*expected)[STRING_LENGTH_MAX + 1], const size_t *lengths, size_t count)
+{
+    uint8_t seq = frame_seq(frame);
+    uint8_t ahead = seq - rx->next;
+
+    if (ahead > RX_AHEAD) {
+        rx->duplicates++;
+        return;
+    }
+
+    if (ahead > 0) {
+        if (rx->held[ahead - 1]) {
+            rx->duplicates++;
+        }
+
+        rx->held[ahead - 1] = true;
+        memcpy(rx->frames[ahead - 1], frame, length);
+        rx->lengths[ahead - 1] = length;
+        return;
+    }
+
+    // In order. Deliver it and the held frames following it
+    for (;;) {
+        size_t payload = length - UART_SPI_ARQ_HEADER_LENGTH - 1;
+
+        if (rx->string_length + payload > sizeof(rx->string)) {
+            rx->failed = true;
+            return;
+        }
+
+        memcpy(rx->string + rx->string_length, frame + UART_SPI_ARQ_HEADER_LENGTH, payload);
+        rx->string_length += payload;
+
+        if (frame[0] == UART_SPI_ARQ_FRAME_END) {
+            size_t q = rx->received;
+
+            if (q >= count || rx->string_length != lengths[q] ||
+                memcmp(rx->string, expected[q], lengths[q]) != 0) {
+                rx->failed = true;
+                return;
+            }
+
+            rx->received++;
+            rx->string_length = 0;
+        }
+        else if (frame[0] != UART_SPI_ARQ_FRAME_MORE) {
+            rx->failed = true;
+            return;
+        }
+
+        rx->next++;
+
+        bool held = rx->held[0];
+        static uint8_t next_frame[UART_SPI_ARQ_FRAME_SIZE];
+        size_t next_length = rx->lengths[0];
+
+        if (held) {
+            memcpy(next_frame, rx->frames[0], next_length);
+        }
+
+        memmove(rx->held, rx->held + 1, sizeof(rx->held) - sizeof(rx->held[0]));
+        memmove(rx->frames, rx->frames + 1, sizeof(rx->frames) - sizeof(rx->frames[0]));
+        memmove(rx->lengths, rx->lengths + 1, sizeof(rx->lengths) - sizeof(rx->lengths[0]));
+        rx->held[RX_AHEAD - 1] = false;
+
+        if (!held) {
+            return;
+        }
+
+        frame = next_frame;
+        length = next_length;
+    }
+}
+
+/**
+ * @brief Build the acknowledgement string
+ *
+ * @return The length including the first byte and the terminator
+ */
+static size_t receiver_ack(const receiver_t *rx, uint8_t *ack)
+{
+    uint32_t sack = 0;
+
+    // Bit n - the frame next + 1 + n. The frame next itself is never held
+    for (size_t n = 0; n < 32; n++) {
+        if (rx->held[n]) {
+            sack |= 1UL << n;
+        }
+    }
+
+    ack[0] = UART_SPI_ARQ_ACK;
+    snprintf((char *)ack + 1, UART_SPI_ARQ_ACK_LENGTH + 1, "%02x%08lx", rx->next, (unsigned long)sack);
+
+    return UART_SPI_ARQ_ACK_LENGTH + 2;
+}
+
+static void ack_pass(uart_spi_arq_t *arq, const uint8_t *ack, size_t length, uint32_t now_ms)
+{
+    uint8_t next;
+    uint32_t sack;
+
+    TEST_CHECK(ack[0] == UART_SPI_ARQ_ACK && ack[length - 1] == '\0');
+
+    int result = uart_spi_arq_ack_parse((const char *)ack + 1, length - 2, &next, &sack);
+    TEST_CHECK(result == 0);
+
+    if (result == 0) {
+        uart_spi_arq_ack(arq, next, sack, now_ms);
+    }
+}
+
+static uint8_t frame_seq(const uint8_t *frame)
+{
+    uint8_t next;
+    uint32_t sack;
+    char text[UART_SPI_ARQ_ACK_LENGTH];
+
+    // Reuse the acknowledgement parser for the two hex digits
+    memcpy(text, frame + 1, 2);
+    memset(text + 2, '0', sizeof(text) - 2);
+
+    return uart_spi_arq_ack_parse(text, sizeof(text), &next, &sack) == 0 ? next : 0xFF;
+}
+
+static uint32_t random_range(uint32_t min, uint32_t max)
+{
+    return min + (uint32_t)rand() % (max - min + 1);
+}
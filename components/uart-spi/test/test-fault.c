@@ -0,0 +1,266 @@
+/**
+ * @file test-fault.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the fault injection scenarios on the simulation.
+ *
+ * Each scenario sets the fault of the peripherals model (see sim.h), runs the
+ * loopback benchmark and checks the statistics deltas against the number of
+ * the injected faults:
+ *
+ * - spi_drop on the SPI loop: one SPI deadline miss per lost interrupt,
+ *   one recovery per three of them in a row, no data loss: the transaction
+ *   itself is complete, so only the strings latency grows by the deadline
+ * - uart_fe on the UART loop with the discard policy: one framing error per
+ *   fault, at most one string lost or corrupted per fault
+ * - irq_delay on the paced UART loop: the delay is over two byte times, so the
+ *   bytes received meanwhile overrun the data register. At most one overrun
+ *   error per delayed interrupt. The overrun of the terminator discards the
+ *   next string as well: at most two strings lost or corrupted per overrun
+ */
+
+#include "test.h"
+
+#include "sim.h"
+
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "uart-spi-bench.h"
+#include "cmsis_os.h"
+
+#include <stdio.h>
+
+// ============================================================================
+
+#define TIME_LIMIT_US       (120ULL * 1000000)
+
+// The strings in flight at the fault switch off
+#define DRAIN_MS            50
+
+// The shortest SPI transaction deadline: its margin
+#define DEADLINE_MIN_US     2000
+
+// ============================================================================
+
+static uart_spi_params_t params;
+
+static int result = 1;
+
+// ============================================================================
+
+static void tap_stub(const uart_spi_view_t *view, void *ctx)
+{
+    (void)view;
+    (void)ctx;
+}
+
+/**
+ * @brief Set the fault probability and restart its sequence, which clears the counters
+ *
+ */
+static void fault_arm(sim_fault_t fault, uint32_t ppm)
+{
+    sim_fault_seed(1);
+    sim_fault_set(fault, ppm);
+}
+
+/**
+ * @brief Switch the fault off and get the number of its injections
+ *
+ */
+static uint32_t fault_disarm(sim_fault_t fault)
+{
+    uint32_t ppm;
+    uint32_t injected;
+
+    sim_fault_set(fault, 0);
+    sim_fault_get(fault, &ppm, &injected);
+
+    return injected;
+}
+
+/**
+ * @brief Run the benchmark in the test task
+ *
+ */
+static void bench_run(uart_spi_dir_t dir, uint32_t count, uart_spi_bench_result_t *bench_result)
+{
+    uart_spi_bench_params_t bench_params = {
+        .dir = dir,
+        .count = count,
+        .length_min = 16,
+        .length_max = 64,
+        .window = 4,
+        .seed = 1
+    };
+
+    TEST_CHECK(uart_spi_bench_run(&bench_params, bench_result) == 0);
+    TEST_CHECK(bench_result->sent == count);
+    TEST_CHECK(bench_result->received + bench_result->corrupted + bench_result->lost == count);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The SPI complete interrupt is lost. The deadline ends the wait for it
+ *
+ */
+static void scenario_spi_drop(void)
+{
+    uart_spi_stats_t before;
+    uart_spi_stats_t after;
+    uart_spi_bench_result_t bench_result;
+
+    sim_spi_slave_set(SIM_SLAVE_ECHO);
+    sim_uart_loopback_set(false);
+
+    uart_spi_get_stats(&before);
+    fault_arm(SIM_FAULT_SPI_DROP, 20000);
+
+    bench_run(UART_SPI_DIR_UART_TO_SPI, 500, &bench_result);
+
+    // Off before the counters are read: the slave is still polled
+    uint32_t injected = fault_disarm(SIM_FAULT_SPI_DROP);
+    osDelay(DRAIN_MS);
+
+    uart_spi_get_stats(&after);
+
+    uint32_t misses = after.spi_deadline_misses - before.spi_deadline_misses;
+    uint32_t recoveries = after.spi_recoveries - before.spi_recoveries;
+
+    printf("spi_drop: %u injected, %u deadline misses, %u recoveries, latency max %u us\n",
+           (unsigned)injected, (unsigned)misses, (unsigned)recoveries, (unsigned)bench_result.latency_max_us);
+
+    TEST_CHECK(injected > 0);
+    TEST_CHECK(misses == injected);
+    TEST_CHECK(recoveries <= injected / 3);
+    TEST_CHECK(bench_result.lost + bench_result.corrupted == 0);
+    TEST_CHECK(bench_result.latency_max_us >= DEADLINE_MIN_US);
+}
+
+/**
+ * @brief The received UART byte has the framing error. The rest of its string is discarded
+ *
+ */
+static void scenario_uart_fe(void)
+{
+    uart_spi_stats_t before;
+    uart_spi_stats_t after;
+    uart_spi_bench_result_t bench_result;
+
+    sim_spi_slave_set(SIM_SLAVE_SILENT);
+    sim_uart_loopback_set(true);
+
+    uart_spi_get_stats(&before);
+    fault_arm(SIM_FAULT_UART_FRAMING, 2000);
+
+    bench_run(UART_SPI_DIR_SPI_TO_UART, 500, &bench_result);
+
+    uint32_t injected = fault_disarm(SIM_FAULT_UART_FRAMING);
+    sim_uart_loopback_set(false);
+    osDelay(DRAIN_MS);
+
+    uart_spi_get_stats(&after);
+
+    uint32_t errors = after.uart_framing_errors - before.uart_framing_errors;
+    uint32_t discarded = after.uart_rx_discarded - before.uart_rx_discarded;
+
+    printf("uart_fe: %u injected, %u framing errors, %u bytes discarded, %u lost, %u corrupted\n",
+           (unsigned)injected, (unsigned)errors, (unsigned)discarded,
+           (unsigned)bench_result.lost, (unsigned)bench_result.corrupted);
+
+    TEST_CHECK(injected > 0);
+    TEST_CHECK(errors == injected);
+    TEST_CHECK(discarded > 0);
+    TEST_CHECK(bench_result.lost + bench_result.corrupted > 0);
+    TEST_CHECK(bench_result.lost + bench_result.corrupted <= injected);
+}
+
+/**
+ * @brief The interrupt is served later. The bytes received meanwhile overrun the data register
+ *
+ */
+static void scenario_irq_delay(void)
+{
+    uart_spi_stats_t before;
+    uart_spi_stats_t after;
+    uart_spi_bench_result_t bench_result;
+
+    sim_spi_slave_set(SIM_SLAVE_SILENT);
+    sim_uart_loopback_set(true);
+
+    // The delayed receive interrupt inside a string overlaps its next bytes
+    uart_spi_bench_params_t bench_params = {
+        .dir = UART_SPI_DIR_SPI_TO_UART,
+        .count = 300,
+        .length_min = 32,
+        .length_max = 32,
+        .gap_ms = 10,
+        .window = 1,
+        .seed = 1
+    };
+
+    uart_spi_get_stats(&before);
+    fault_arm(SIM_FAULT_IRQ_DELAY, 2000);
+
+    TEST_CHECK(uart_spi_bench_run(&bench_params, &bench_result) == 0);
+    TEST_CHECK(bench_result.received + bench_result.corrupted + bench_result.lost == bench_params.count);
+
+    uint32_t injected = fault_disarm(SIM_FAULT_IRQ_DELAY);
+    sim_uart_loopback_set(false);
+    osDelay(DRAIN_MS);
+
+    uart_spi_get_stats(&after);
+
+    uint32_t overruns = after.uart_overrun_errors - before.uart_overrun_errors;
+
+    printf("irq_delay: %u injected, %u overruns, %u lost, %u corrupted\n",
+           (unsigned)injected, (unsigned)overruns, (unsigned)bench_result.lost, (unsigned)bench_result.corrupted);
+
+    TEST_CHECK(injected > 0);
+    TEST_CHECK(overruns > 0);
+    TEST_CHECK(overruns <= injected);
+    TEST_CHECK(bench_result.lost + bench_result.corrupted <= overruns * 2);
+}
+
+// ----------------------------------------------------------------------------
+
+static void test_main(void *arg)
+{
+    (void)arg;
+
+    params.huart = &huart1;
+    params.hspi = &hspi1;
+    params.rx_error_policy = UART_SPI_RX_ERROR_DISCARD;
+
+    TEST_CHECK(uart_spi_start(&params) == 0);
+
+    // The benchmark doesn't take the application observer over
+    uart_spi_bench_params_t bench_params = { .count = 1, .length_min = 16, .length_max = 16 };
+    uart_spi_bench_result_t bench_result;
+
+    TEST_CHECK(uart_spi_tap_register(tap_stub, NULL) == 0);
+    TEST_CHECK(uart_spi_bench_run(&bench_params, &bench_result) == -1);
+    TEST_CHECK(uart_spi_bench_start(&bench_params) == -1);
+    TEST_CHECK(uart_spi_tap_register(NULL, NULL) == 0);
+
+    scenario_spi_drop();
+    scenario_uart_fe();
+    scenario_irq_delay();
+
+    TEST_CHECK(uart_spi_stop(100) == 0);
+
+    result = 0;
+}
+
+int main(void)
+{
+    int status = sim_run(test_main, NULL, TIME_LIMIT_US);
+
+    TEST_CHECK(status == 0);
+    TEST_CHECK(result == 0);
+
+    return test_done("fault");
+}
@@ -0,0 +1,170 @@
+/**
+ * @file test-inject.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the strings the bridge originates on the simulation.
+ *
+ * The application messages to both directions and the management replies
+ * must carry the valid CRC trailer on each non-empty string once the
+ * generation is enabled, and must be sent as is otherwise. The zero-copy
+ * message buffer is released right away when the trailers are added.
+ */
+
+#include "test.h"
+
+#include "sim.h"
+
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "uart-spi-crc.h"
+#include "uart-spi-mgmt.h"
+#include "cmsis_os.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define TIME_LIMIT_US       (10ULL * 1000000)
+
+#define LINE_BUFF_SIZE      4096
+#define TRAILER_LENGTH      8
+
+// The transmission of all the test strings
+#define SETTLE_MS           200
+
+// ============================================================================
+
+static uint8_t line_buff[LINE_BUFF_SIZE];
+
+static unsigned zc_released;
+
+static int result = 1;
+
+// ============================================================================
+
+static void zc_release(const void *data, void *ctx)
+{
+    (void)data;
+    (void)ctx;
+
+    zc_released++;
+}
+
+/**
+ * @brief Check the trailer of the string
+ *
+ */
+static bool trailer_valid(const char *string, size_t length)
+{
+    if (length <= TRAILER_LENGTH) {
+        return false;
+    }
+
+    char expected[TRAILER_LENGTH + 1];
+    snprintf(expected, sizeof(expected), "%08x", (unsigned)uart_spi_crc32(string, length - TRAILER_LENGTH));
+
+    return memcmp(string + length - TRAILER_LENGTH, expected, TRAILER_LENGTH) == 0;
+}
+
+/**
+ * @brief Check the trailers of all the strings of the line data
+ *
+ * @param data The line data. The '\0' runs separate the strings
+ * @param crc_generate The trailers are expected
+ * @return The number of the strings
+ */
+static unsigned line_check(const uint8_t *data, size_t length, bool crc_generate)
+{
+    unsigned strings = 0;
+    size_t start = 0;
+
+    for (size_t q = 0; q < length; q++) {
+        if (data[q] != 0) {
+            continue;
+        }
+
+        if (q > start) {
+            bool valid = trailer_valid((const char *)data + start, q - start);
+
+            if (valid != crc_generate) {
+                fprintf(stderr, "string '%.*s': trailer %s\n", (int)(q - start), data + start,
+                        valid ? "not expected" : "wrong");
+            }
+
+            TEST_CHECK(valid == crc_generate);
+            strings++;
+        }
+
+        start = q + 1;
+    }
+
+    return strings;
+}
+
+/**
+ * @brief Send the messages and the management command through the bridge
+ *
+ * @param crc_generate Generate the CRC trailers
+ */
+static void messages_run(bool crc_generate)
+{
+    static const char messages[] = "first\0\0second\0third";
+    static const char zc_message[] = "zero-copy";
+    static const char spi_message[] = "to-spi";
+    static const char command[] = UART_SPI_MGMT_PREFIX "get";
+
+    uart_spi_params_t params = {
+        .huart = &huart1,
+        .hspi = &hspi1,
+        .crc_generate = crc_generate
+    };
+
+    zc_released = 0;
+
+    TEST_CHECK(uart_spi_start(&params) == 0);
+
+    TEST_CHECK(uart_spi_send_to_uart(messages, sizeof(messages), 0) == 0);
+    TEST_CHECK(uart_spi_send_to_uart_zc(zc_message, sizeof(zc_message), zc_release, NULL, 0) == 0);
+    TEST_CHECK(zc_released == (crc_generate ? 1 : 0));
+    TEST_CHECK(uart_spi_send_to_spi(spi_message, sizeof(spi_message), 0) == 0);
+
+    sim_uart_send(command, sizeof(command));
+
+    osDelay(SETTLE_MS);
+
+    TEST_CHECK(uart_spi_stop(100) == 0);
+    TEST_CHECK(zc_released == 1);
+
+    // Three message strings, the zero-copy one, the tunables and "ok"
+    size_t length = sim_uart_receive(line_buff, sizeof(line_buff));
+    TEST_CHECK(line_check(line_buff, length, crc_generate) > 4);
+
+    length = sim_spi_slave_receive(line_buff, sizeof(line_buff));
+    line_buff[length++] = '\0';
+    TEST_CHECK(line_check(line_buff, length, crc_generate) == 1);
+}
+
+static void test_main(void *arg)
+{
+    (void)arg;
+
+    sim_spi_slave_set(SIM_SLAVE_SILENT);
+
+    messages_run(false);
+    messages_run(true);
+
+    result = 0;
+}
+
+int main(void)
+{
+    int status = sim_run(test_main, NULL, TIME_LIMIT_US);
+
+    TEST_CHECK(status == 0);
+    TEST_CHECK(result == 0);
+
+    return test_done("inject");
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test-lifecycle.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the bridge start and stop cycles on the simulation.
+ *
+ * The bridge is started and stopped thousands of times: idle, with the
+ * strings forwarded and echoed back by the SPI slave, stopped in the middle
+ * of the transfers and restarted. The kernel objects and the heap must come
+ * back to the level of the first cycle, the forwarded strings must arrive
+ * at the slave and back at the UART line.
+ */
+
+#include "test.h"
+
+#include "sim.h"
+
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "cmsis_os.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define CYCLES              2000
+#define TIME_LIMIT_US       (600ULL * 1000000)
+
+#define STRING_SIZE         32
+#define LINE_BUFF_SIZE      (64 * 1024)
+
+// The forwarded string round trip: the UART line, the SPI slave echo and the UART line back
+#define ROUND_TRIP_MS       20
+
+#define DRAIN_TIMEOUT_MS    100
+
+// ============================================================================
+
+typedef enum {
+    CYCLE_IDLE = 0,             /// Stopped right after the start
+    CYCLE_FORWARD,              /// The string is forwarded both ways before the stop
+    CYCLE_ABORT,                /// Stopped without the drain while the string is received
+    CYCLE_RESTART,              /// Restarted, then the string and the application message are forwarded
+    CYCLE_KINDS
+} cycle_kind_t;
+
+// ============================================================================
+
+static uart_spi_params_t params;
+
+static uint8_t line_buff[LINE_BUFF_SIZE];
+
+static int result = 1;
+
+// ============================================================================
+
+/**
+ * @brief Check if the line data contains the string
+ *
+ * The string may be split by the '\0' of the SPI polling at any byte,
+ * so they are skipped
+ */
+static bool line_contains(uint8_t *data, size_t length, const char *string)
+{
+    size_t string_length = strlen(string);
+    size_t data_length = 0;
+
+    for (size_t q = 0; q < length; q++) {
+        if (data[q] != 0) {
+            data[data_length++] = data[q];
+        }
+    }
+
+    length = data_length;
+
+    for (size_t q = 0; q + string_length <= length; q++) {
+        if (memcmp(&data[q], string, string_length) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool snapshot_equal(const sim_stats_t *a, const sim_stats_t *b)
+{
+    return a->tasks == b->tasks &&
+           a->heap_blocks == b->heap_blocks &&
+           a->heap_bytes == b->heap_bytes &&
+           a->semaphores == b->semaphores &&
+           a->queues == b->queues;
+}
+
+/**
+ * @brief Run one start-stop cycle
+ *
+ * @param cycle The cycle number
+ */
+static void cycle_run(unsigned cycle)
+{
+    cycle_kind_t kind = cycle % CYCLE_KINDS;
+
+    char string[STRING_SIZE];
+    snprintf(string, sizeof(string), "<uart-%u>", cycle);
+
+    char message[STRING_SIZE];
+    snprintf(message, sizeof(message), "<app-%u>", cycle);
+
+    // Every 16th cycle polls the slave continuously
+    uart_spi_tunables_t tunables;
+    uart_spi_tunables_get(&tunables);
+    tunables.poll_period_ms = cycle % 16 < CYCLE_KINDS ? 0 : 1;
+    TEST_CHECK(uart_spi_tunables_set(&tunables) == 0);
+
+    // Drop the data of the previous cycles
+    while (sim_spi_slave_receive(line_buff, sizeof(line_buff)) > 0) {}
+    while (sim_uart_receive(line_buff, sizeof(line_buff)) > 0) {}
+
+    TEST_CHECK(uart_spi_start(&params) == 0);
+
+    switch (kind) {
+        case CYCLE_IDLE:
+            TEST_CHECK(uart_spi_stop(DRAIN_TIMEOUT_MS) == 0);
+            return;
+
+        case CYCLE_ABORT:
+            sim_uart_send(string, strlen(string) + 1);
+            osDelay(cycle % 3);
+            TEST_CHECK(uart_spi_stop(0) == 0);
+            return;
+
+        case CYCLE_RESTART:
+            TEST_CHECK(uart_spi_restart(DRAIN_TIMEOUT_MS) == 0);
+            TEST_CHECK(uart_spi_send_to_spi(message, strlen(message) + 1, 0) == 0);
+            break;
+
+        default:
+            break;
+    }
+
+    sim_uart_send(string, strlen(string) + 1);
+    osDelay(ROUND_TRIP_MS);
+
+    TEST_CHECK(uart_spi_stop(DRAIN_TIMEOUT_MS) == 0);
+
+    size_t length = sim_spi_slave_receive(line_buff, sizeof(line_buff));
+    TEST_CHECK(line_contains(line_buff, length, string));
+
+    if (kind == CYCLE_RESTART) {
+        TEST_CHECK(line_contains(line_buff, length, message));
+    }
+
+    length = sim_uart_receive(line_buff, sizeof(line_buff));
+    TEST_CHECK(line_contains(line_buff, length, string));
+}
+
+static void test_main(void *arg)
+{
+    (void)arg;
+
+    params.huart = &huart1;
+    params.hspi = &hspi1;
+
+    // The objects created once on the first start survive the stops
+    cycle_run(0);
+
+    sim_stats_t baseline;
+    sim_stats_get(&baseline);
+
+    for (unsigned cycle = 1; cycle < CYCLES; cycle++) {
+        cycle_run(cycle);
+
+        sim_stats_t stats;
+        sim_stats_get(&stats);
+
+        if (!snapshot_equal(&stats, &baseline)) {
+            fprintf(stderr, "cycle %u: %zu tasks, %zu heap blocks (%zu bytes), %zu semaphores, %zu queues. "
+                            "Expected %zu, %zu (%zu), %zu, %zu\n",
+                    cycle, stats.tasks, stats.heap_blocks, stats.heap_bytes, stats.semaphores, stats.queues,
+                    baseline.tasks, baseline.heap_blocks, baseline.heap_bytes, baseline.semaphores, baseline.queues);
+            TEST_CHECK(false);
+            break;
+        }
+    }
+
+    // The stopped bridge keeps the supervisor only
+    TEST_CHECK(uart_spi_stop(0) == -1);
+    TEST_CHECK(baseline.tasks == 2);
+
+    uart_spi_stats_t bridge_stats;
+    uart_spi_get_stats(&bridge_stats);
+    TEST_CHECK(bridge_stats.uart_recoveries == 0);
+    TEST_CHECK(bridge_stats.spi_recoveries == 0);
+
+    result = 0;
+}
+
+int main(void)
+{
+    int status = sim_run(test_main, NULL, TIME_LIMIT_US);
+
+    sim_stats_t stats;
+    sim_stats_get(&stats);
+
+    TEST_CHECK(status == 0);
+    TEST_CHECK(!stats.reset);
+    TEST_CHECK(result == 0);
+
+    printf("lifecycle: %u cycles in %.1f s of the simulated time, %u interrupts\n",
+           CYCLES, sim_time_us() / 1e6, stats.isr_count);
+
+    return test_done("lifecycle");
+}
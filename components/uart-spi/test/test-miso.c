@@ -0,0 +1,168 @@
+/**
+ * @file test-miso.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the MISO string filter against the reference model.
+ *
+ * The random streams are fed to the filter in random chunks, so the strings
+ * and the '\0' runs are split at every possible transaction boundary.
+ */
+
+#include "test.h"
+#include "miso-model.h"
+
+#include "uart-spi-miso.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+#define STREAM_LENGTH_MAX   512
+#define ROUNDS              20000
+
+// ============================================================================
+
+static void test_fixed(void);
+static void test_random(void);
+static void test_byte_class(void);
+
+// ============================================================================
+
+int main(void)
+{
+    test_fixed();
+    test_random();
+    test_byte_class();
+
+    return test_done("miso");
+}
+
+// ============================================================================
+
+static void test_fixed(void)
+{
+    static const struct {
+        const char *in;
+        size_t in_length;
+        const char *out;
+        size_t out_length;
+    } cases[] = {
+        { "", 0, "", 0 },
+        { "\0\0\0", 3, "", 0 },
+        { "abc", 3, "abc", 3 },
+        { "abc\0", 4, "abc\0", 4 },
+        { "\0\0abc\0\0\0de\0", 12, "abc\0de\0", 7 },
+        { "a\0b\0\0c", 6, "a\0b\0c", 5 },
+    };
+
+    for (size_t q = 0; q < sizeof(cases) / sizeof(cases[0]); q++) {
+        uart_spi_miso_t miso;
+        uint8_t out[16];
+
+        uart_spi_miso_reset(&miso);
+        size_t length = uart_spi_miso_filter(&miso, (const uint8_t *)cases[q].in, cases[q].in_length, out);
+
+        TEST_CHECK(length == cases[q].out_length);
+        TEST_CHECK(memcmp(out, cases[q].out, cases[q].out_length) == 0);
+    }
+}
+
+static void test_random(void)
+{
+    static uint8_t in[STREAM_LENGTH_MAX];
+    static uint8_t out[STREAM_LENGTH_MAX];
+    static uint8_t in_place[STREAM_LENGTH_MAX];
+    static uint8_t expected[STREAM_LENGTH_MAX];
+
+    srand(1);
+
+    for (int round = 0; round < ROUNDS; round++) {
+        size_t length = rand() % STREAM_LENGTH_MAX;
+        int zero_percent = rand() % 101;
+
+        for (size_t q = 0; q < length; q++) {
+            in[q] = (rand() % 100 < zero_percent) ? 0 : 1 + rand() % 255;
+        }
+
+        size_t expected_length = miso_model(in, length, expected);
+
+        // Chunked to a separate buffer and in place
+        uart_spi_miso_t miso;
+        uart_spi_miso_t miso_in_place;
+        size_t out_length = 0;
+        size_t in_place_length = 0;
+
+        uart_spi_miso_reset(&miso);
+        uart_spi_miso_reset(&miso_in_place);
+        memcpy(in_place, in, length);
+
+        for (size_t offset = 0; offset < length; ) {
+            size_t chunk = 1 + rand() % (length - offset);
+            if (rand() % 2) {
+                chunk = 1 + chunk % 8;
+                if (chunk > length - offset) {
+                    chunk = length - offset;
+                }
+            }
+
+            size_t count = uart_spi_miso_filter(&miso, in + offset, chunk, out + out_length);
+            TEST_CHECK(count <= chunk);
+            out_length += count;
+
+            count = uart_spi_miso_filter(&miso_in_place, in_place + offset, chunk, in_place + offset);
+            memmove(in_place + in_place_length, in_place + offset, count);
+            in_place_length += count;
+
+            offset += chunk;
+        }
+
+        TEST_CHECK(out_length == expected_length);
+        TEST_CHECK(memcmp(out, expected, expected_length) == 0);
+        TEST_CHECK(in_place_length == expected_length);
+        TEST_CHECK(memcmp(in_place, expected, expected_length) == 0);
+        TEST_CHECK(miso_model_check(out, out_length));
+    }
+}
+
+static void test_byte_class(void)
+{
+    static uint8_t in[STREAM_LENGTH_MAX];
+    static uint8_t out[STREAM_LENGTH_MAX];
+
+    srand(2);
+
+    for (int round = 0; round < ROUNDS / 10; round++) {
+        size_t length = rand() % STREAM_LENGTH_MAX;
+
+        for (size_t q = 0; q < length; q++) {
+            in[q] = (rand() % 2) ? 0 : rand() % 256;
+        }
+
+        uart_spi_miso_t miso;
+        uart_spi_miso_t miso_byte;
+
+        uart_spi_miso_reset(&miso);
+        uart_spi_miso_reset(&miso_byte);
+
+        size_t out_length = uart_spi_miso_filter(&miso, in, length, out);
+        size_t count = 0;
+
+        // The per-byte classifier keeps exactly the bytes the filter outputs
+        for (size_t q = 0; q < length; q++) {
+            uart_spi_miso_class_t class = uart_spi_miso_byte(&miso_byte, in[q]);
+
+            if (class == UART_SPI_MISO_IDLE) {
+                continue;
+            }
+
+            TEST_CHECK(count < out_length && out[count] == in[q]);
+            TEST_CHECK((class == UART_SPI_MISO_END) == (in[q] == '\0'));
+            count++;
+        }
+
+        TEST_CHECK(count == out_length);
+        TEST_CHECK(miso.receiving == miso_byte.receiving);
+    }
+}
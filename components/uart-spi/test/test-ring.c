@@ -0,0 +1,243 @@
+/**
+ * @file test-ring.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Host test of the SPSC ring: the single-threaded edge cases and the
+ * two-thread stress run with the random write and read lengths and the
+ * wakeup requests. A lost wakeup is detected by the wait timeout.
+ */
+
+#include "test.h"
+
+#include "uart-spi-ring.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+// ============================================================================
+
+#define STRESS_BYTES        (2u * 1024 * 1024)
+#define WAKEUP_TIMEOUT_S    5
+
+// ============================================================================
+
+typedef struct {
+    uart_spi_ring_t ring;
+    sem_t wakeup;
+    unsigned int seed;
+    size_t chunk_max;
+} stress_t;
+
+static void test_edges(void);
+static void test_stress(size_t size);
+static void *stress_producer(void *arg);
+static void stress_hook(void *ctx);
+
+static inline uint8_t stream_byte(size_t position)
+{
+    return (uint8_t)(position ^ (position >> 8) ^ (position >> 16));
+}
+
+// ============================================================================
+
+int main(void)
+{
+    test_edges();
+
+    static const size_t sizes[] = { 2, 16, 256, 4096 };
+
+    for (size_t q = 0; q < sizeof(sizes) / sizeof(sizes[0]); q++) {
+        test_stress(sizes[q]);
+    }
+
+    return test_done("ring");
+}
+
+// ============================================================================
+
+static int hook_calls;
+
+static void count_hook(void *ctx)
+{
+    (void)ctx;
+    hook_calls++;
+}
+
+static void test_edges(void)
+{
+    uint8_t mem[8];
+    uint8_t data[16];
+    uart_spi_ring_t ring;
+
+    uart_spi_ring_init(&ring, mem, sizeof(mem));
+    uart_spi_ring_hook_set(&ring, count_hook, NULL);
+
+    TEST_CHECK(uart_spi_ring_used(&ring) == 0);
+    TEST_CHECK(uart_spi_ring_free(&ring) == 8);
+    TEST_CHECK(uart_spi_ring_read(&ring, data, 1) == 0);
+
+    // Partial write of the full ring
+    for (size_t q = 0; q < sizeof(data); q++) {
+        data[q] = q;
+    }
+    TEST_CHECK(uart_spi_ring_write(&ring, data, 10) == 8);
+    TEST_CHECK(uart_spi_ring_write(&ring, data, 1) == 0);
+    TEST_CHECK(uart_spi_ring_free(&ring) == 0);
+
+    // Wrap-around
+    uint8_t out[16];
+    TEST_CHECK(uart_spi_ring_read(&ring, out, 5) == 5);
+    TEST_CHECK(memcmp(out, data, 5) == 0);
+    TEST_CHECK(uart_spi_ring_write(&ring, data + 8, 5) == 5);
+    TEST_CHECK(uart_spi_ring_read(&ring, out, 16) == 8);
+    TEST_CHECK(memcmp(out, data + 5, 8) == 0);
+
+    // The hook is called once when the armed level is reached
+    hook_calls = 0;
+    TEST_CHECK(!uart_spi_ring_wait_arm(&ring, 3));
+    uart_spi_ring_write(&ring, data, 2);
+    TEST_CHECK(hook_calls == 0);
+    uart_spi_ring_write(&ring, data, 1);
+    TEST_CHECK(hook_calls == 1);
+    uart_spi_ring_write(&ring, data, 1);
+    TEST_CHECK(hook_calls == 1);
+
+    // The level is already reached
+    TEST_CHECK(uart_spi_ring_wait_arm(&ring, 4));
+    uart_spi_ring_wait_disarm(&ring);
+    uart_spi_ring_write(&ring, data, 1);
+    TEST_CHECK(hook_calls == 1);
+
+    // Disarmed before the data comes
+    uart_spi_ring_read(&ring, out, sizeof(out));
+    TEST_CHECK(!uart_spi_ring_wait_arm(&ring, 1));
+    uart_spi_ring_wait_disarm(&ring);
+    uart_spi_ring_write(&ring, data, 1);
+    TEST_CHECK(hook_calls == 1);
+
+    // The level 0 means 1
+    uart_spi_ring_read(&ring, out, sizeof(out));
+    TEST_CHECK(!uart_spi_ring_wait_arm(&ring, 0));
+    uart_spi_ring_write(&ring, data, 1);
+    TEST_CHECK(hook_calls == 2);
+}
+
+// ----------------------------------------------------------------------------
+
+static void test_stress(size_t size)
+{
+    static stress_t stress;
+    uint8_t *mem = malloc(size);
+    pthread_t producer;
+
+    uart_spi_ring_init(&stress.ring, mem, size);
+    uart_spi_ring_hook_set(&stress.ring, stress_hook, &stress);
+    sem_init(&stress.wakeup, 0, 0);
+    stress.chunk_max = size * 2 < 300 ? size * 2 : 300;
+    stress.seed = size;
+
+    pthread_create(&producer, NULL, stress_producer, &stress);
+
+    unsigned int seed = ~size;
+    uint8_t data[300];
+    size_t position = 0;
+    int mismatches = 0;
+    int timeouts = 0;
+
+    while (position < STRESS_BYTES && timeouts == 0) {
+        size_t used = uart_spi_ring_used(&stress.ring);
+        if (used > size) {
+            mismatches++;
+        }
+
+        if (rand_r(&seed) % 8 == 0) {
+            size_t level = 1 + rand_r(&seed) % size;
+            if (level > STRESS_BYTES - position) {
+                level = STRESS_BYTES - position;
+            }
+
+            if (!uart_spi_ring_wait_arm(&stress.ring, level)) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += WAKEUP_TIMEOUT_S;
+
+                while (sem_timedwait(&stress.wakeup, &deadline) != 0) {
+                    if (errno == ETIMEDOUT) {
+                        timeouts++;
+                        break;
+                    }
+                }
+            }
+
+            uart_spi_ring_wait_disarm(&stress.ring);
+        }
+
+        size_t length = uart_spi_ring_read(&stress.ring, data, 1 + rand_r(&seed) % stress.chunk_max);
+
+        for (size_t q = 0; q < length; q++) {
+            if (data[q] != stream_byte(position + q)) {
+                mismatches++;
+            }
+        }
+
+        position += length;
+
+        if (length == 0) {
+            sched_yield();
+        }
+    }
+
+    pthread_join(producer, NULL);
+
+    if (mismatches || timeouts) {
+        fprintf(stderr, "ring size %zu: %d mismatches, %d lost wakeups\n", size, mismatches, timeouts);
+    }
+
+    TEST_CHECK(mismatches == 0);
+    TEST_CHECK(timeouts == 0);
+    TEST_CHECK(position == STRESS_BYTES);
+    TEST_CHECK(uart_spi_ring_used(&stress.ring) == 0);
+
+    sem_destroy(&stress.wakeup);
+    free(mem);
+}
+
+static void *stress_producer(void *arg)
+{
+    stress_t *stress = arg;
+    uint8_t data[300];
+    size_t position = 0;
+
+    while (position < STRESS_BYTES) {
+        size_t length = 1 + rand_r(&stress->seed) % stress->chunk_max;
+        if (length > STRESS_BYTES - position) {
+            length = STRESS_BYTES - position;
+        }
+
+        for (size_t q = 0; q < length; q++) {
+            data[q] = stream_byte(position + q);
+        }
+
+        size_t written = uart_spi_ring_write(&stress->ring, data, length);
+        position += written;
+
+        if (written < length) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void stress_hook(void *ctx)
+{
+    stress_t *stress = ctx;
+
+    sem_post(&stress->wakeup);
+}
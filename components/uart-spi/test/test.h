@@ -0,0 +1,44 @@
+/**
+ * @file test.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Minimal host test checks. A failed check is reported and counted,
+ * the test continues.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+// ============================================================================
+
+static int test_failures;
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            test_failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+/**
+ * @brief Report the test result
+ *
+ * @param name The test name
+ * @return The process exit code
+ */
+static inline int test_done(const char *name)
+{
+    if (test_failures) {
+        printf("%s: %d checks FAILED\n", name, test_failures);
+        return 1;
+    }
+
+    printf("%s: OK\n", name);
+    return 0;
+}
+
+#endif /* TEST_H_ */
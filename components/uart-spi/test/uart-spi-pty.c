@@ -0,0 +1,395 @@
+/**
+ * @file uart-spi-pty.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * The bridge emulation on a Linux pseudo-terminal.
+ *
+ * The bridge units run unchanged on the simulation (host/sim.h) in the
+ * real-time mode, their UART line is the pty. The host software opens the
+ * printed pty path instead of the bridge UART and gets the bridge itself:
+ * the MISO filter, the management channel and the benchmark. The bridge has
+ * no hardware flow control, so the pty has none
+ * either: the simulated UART TX line drops the data once the host is 64 KB
+ * behind.
+ *
+ * The SPI slave modes:
+ *     echo            Returns each received string (default)
+ *     silent          Never sends
+ *     <capture.usc>   Sends the SPI-to-UART spans of the capture file
+ *                     (see tools/uart-spi-capture.py) at their original timing
+ *
+ * The faults of the peripherals model (see sim.h) are set by the options
+ * <name>=<ppm> with the fault names uart_fe, uart_ore, uart_tx_drop, spi_drop,
+ * spi_err, flip and irq_delay, and seed=<value> of their sequence.
+ *
+ * Usage: uart-spi-pty [baud] [echo | silent | capture.usc] [<fault>=<ppm> ...] [seed=<value>]
+ */
+
+#include "sim.h"
+
+#include "usart.h"
+#include "spi.h"
+#include "uart-spi.h"
+#include "cmsis_os.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+
+// ============================================================================
+
+#define BAUD_DEFAULT            115200
+
+#define CAPTURE_MAGIC           "USC1"
+#define CAPTURE_HEADER_SIZE     6
+#define CAPTURE_DIR_SPI_TO_UART 1
+
+// The pty is not opened by the host yet
+#define REOPEN_WAIT_US          100000
+
+#define PTY_BUFF_SIZE           4096
+
+#define USAGE                   "Usage: %s [baud] [echo | silent | capture.usc] [<fault>=<ppm> ...] [seed=<value>]\n"
+
+// ============================================================================
+
+/**
+ * @brief The SPI-to-UART span of the capture
+ *
+ */
+typedef struct {
+    uint64_t time_us;           /// The simulation time to send the span
+    const uint8_t *data;
+    size_t length;
+} capture_span_t;
+
+// ============================================================================
+
+static int pty_master = -1;
+
+// The UART TX line data not taken by the pty yet
+static uint8_t pty_tx[PTY_BUFF_SIZE];
+static size_t pty_tx_length;
+static size_t pty_tx_offset;
+
+static capture_span_t *spans;
+static size_t span_count;
+static size_t span_next;
+
+static uint32_t uart_baud = BAUD_DEFAULT;
+
+static uint32_t fault_ppm[SIM_FAULT_COUNT];
+static uint32_t fault_seed;
+
+// ============================================================================
+
+/**
+ * @brief Read the SPI-to-UART spans of the capture file
+ *
+ * The 32-bit microsecond timestamps are extended. The first span is sent right away
+ *
+ * @return 0 - success, -1 - not a capture file
+ */
+static int capture_read(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    uint8_t *content = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    while (!feof(file)) {
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            content = realloc(content, capacity);
+        }
+
+        size += fread(content + size, 1, capacity - size, file);
+
+        if (ferror(file)) {
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+
+    if (size < strlen(CAPTURE_MAGIC) || memcmp(content, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC)) != 0) {
+        return -1;
+    }
+
+    uint64_t offset = 0;
+    uint64_t first = 0;
+    uint32_t prev = 0;
+    size_t capacity_spans = 0;
+
+    for (size_t pos = strlen(CAPTURE_MAGIC); pos + CAPTURE_HEADER_SIZE <= size;) {
+        uint32_t timestamp = content[pos] | content[pos + 1] << 8 | content[pos + 2] << 16 |
+                             (uint32_t)content[pos + 3] << 24;
+        uint16_t info = content[pos + 4] | content[pos + 5] << 8;
+        size_t length = info & 0x7FFF;
+
+        pos += CAPTURE_HEADER_SIZE;
+
+        if (pos + length > size) {
+            length = size - pos;
+        }
+
+        if (timestamp < prev) {
+            offset += 1ULL << 32;
+        }
+
+        prev = timestamp;
+
+        if (info >> 15 == CAPTURE_DIR_SPI_TO_UART) {
+            if (span_count == 0) {
+                first = offset + timestamp;
+            }
+
+            if (span_count == capacity_spans) {
+                capacity_spans = capacity_spans ? capacity_spans * 2 : 256;
+                spans = realloc(spans, capacity_spans * sizeof(spans[0]));
+            }
+
+            spans[span_count++] = (capture_span_t) {
+                .time_us = offset + timestamp - first,
+                .data = content + pos,
+                .length = length
+            };
+        }
+
+        pos += length;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Pass the UART TX line data to the pty while it takes them
+ *
+ */
+static void pty_flush(void)
+{
+    while (1) {
+        if (pty_tx_offset == pty_tx_length) {
+            pty_tx_offset = 0;
+            pty_tx_length = sim_uart_receive(pty_tx, sizeof(pty_tx));
+
+            if (pty_tx_length == 0) {
+                return;
+            }
+        }
+
+        ssize_t count = write(pty_master, pty_tx + pty_tx_offset, pty_tx_length - pty_tx_offset);
+
+        if (count <= 0) {
+            return;
+        }
+
+        pty_tx_offset += count;
+    }
+}
+
+/**
+ * @brief Pass the data between the pty and the simulated lines. The idle hook
+ *
+ * Waits for the host data up to the next simulation event
+ */
+static void pty_idle(uint64_t timeout_us)
+{
+    uint8_t buff[PTY_BUFF_SIZE];
+
+    pty_flush();
+
+    uint64_t now_us = sim_time_us();
+
+    while (span_next < span_count && spans[span_next].time_us <= now_us) {
+        sim_spi_slave_send(spans[span_next].data, spans[span_next].length);
+        span_next++;
+    }
+
+    if (span_next < span_count && spans[span_next].time_us - now_us < timeout_us) {
+        timeout_us = spans[span_next].time_us - now_us;
+    }
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(pty_master, &readable);
+
+    fd_set writable;
+    FD_ZERO(&writable);
+
+    if (pty_tx_offset < pty_tx_length) {
+        FD_SET(pty_master, &writable);
+    }
+
+    struct timeval tv = {
+        .tv_sec = timeout_us / 1000000,
+        .tv_usec = timeout_us % 1000000
+    };
+
+    if (select(pty_master + 1, &readable, &writable, NULL, timeout_us == UINT64_MAX ? NULL : &tv) <= 0 ||
+        !FD_ISSET(pty_master, &readable)) {
+        return;
+    }
+
+    ssize_t count = read(pty_master, buff, sizeof(buff));
+
+    if (count > 0) {
+        sim_uart_send(buff, count);
+    }
+    else if (count < 0 && errno == EIO) {
+        usleep(REOPEN_WAIT_US);
+    }
+}
+
+/**
+ * @brief Parse the fault option "<name>=<ppm>" or "seed=<value>"
+ *
+ * @return 0 - success, -1 - not a fault option
+ */
+static int fault_option(const char *option)
+{
+    const char *value = strchr(option, '=');
+
+    if (value == NULL || value[1] == '\0') {
+        return -1;
+    }
+
+    char *end;
+    unsigned long number = strtoul(value + 1, &end, 0);
+
+    if (*end != '\0') {
+        return -1;
+    }
+
+    size_t length = value - option;
+
+    if (length == 4 && strncmp(option, "seed", 4) == 0) {
+        fault_seed = number;
+        return 0;
+    }
+
+    for (int fault = 0; fault < SIM_FAULT_COUNT; fault++) {
+        uint32_t ppm;
+        uint32_t injected;
+        const char *name = sim_fault_get(fault, &ppm, &injected);
+
+        if (strlen(name) == length && strncmp(name, option, length) == 0) {
+            fault_ppm[fault] = number;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Start the bridge and keep it running
+ *
+ * @param arg The slave echoes. Set here with the faults: the simulation start resets the peripherals
+ */
+static void pty_main(void *arg)
+{
+    sim_spi_slave_set(*(bool *)arg ? SIM_SLAVE_ECHO : SIM_SLAVE_SILENT);
+
+    sim_fault_seed(fault_seed);
+
+    for (int fault = 0; fault < SIM_FAULT_COUNT; fault++) {
+        sim_fault_set(fault, fault_ppm[fault]);
+    }
+
+    uart_spi_tunables_t tunables;
+    uart_spi_tunables_get(&tunables);
+    tunables.uart_baud = uart_baud;
+
+    if (uart_spi_tunables_set(&tunables) != 0) {
+        fprintf(stderr, "baud rate %u is not supported\n", (unsigned)uart_baud);
+        return;
+    }
+
+    uart_spi_params_t params = {
+        .huart = &huart1,
+        .hspi = &hspi1,
+    };
+
+    if (uart_spi_start(&params) != 0) {
+        fprintf(stderr, "the bridge start failed\n");
+        return;
+    }
+
+    while (1) {
+        osDelay(1000);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mode = "echo";
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        fprintf(stderr, USAGE, argv[0]);
+        return 1;
+    }
+
+    // The fault options follow the positional ones
+    int positional = 1;
+
+    while (positional < argc && positional < 3 && strchr(argv[positional], '=') == NULL) {
+        positional++;
+    }
+
+    for (int q = positional; q < argc; q++) {
+        if (fault_option(argv[q]) != 0) {
+            fprintf(stderr, USAGE, argv[0]);
+            return 1;
+        }
+    }
+
+    if (positional > 1) {
+        uart_baud = strtoul(argv[1], NULL, 0);
+    }
+
+    if (positional > 2) {
+        mode = argv[2];
+    }
+
+    bool echo = strcmp(mode, "echo") == 0;
+
+    if (!echo && strcmp(mode, "silent") != 0 && capture_read(mode) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", mode);
+        return 1;
+    }
+
+    int pty_slave = -1;
+
+    if (openpty(&pty_master, &pty_slave, NULL, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+
+    struct termios termios;
+    tcgetattr(pty_slave, &termios);
+    cfmakeraw(&termios);
+    tcsetattr(pty_slave, TCSANOW, &termios);
+
+    fcntl(pty_master, F_SETFL, fcntl(pty_master, F_GETFL) | O_NONBLOCK);
+
+    printf("%s\n", ttyname(pty_slave));
+    fflush(stdout);
+
+    sim_realtime_set(pty_idle);
+
+    return sim_run(pty_main, &echo, 0) == 0 ? 0 : 1;
+}
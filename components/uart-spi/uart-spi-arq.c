@@ -0,0 +1,442 @@
+/**
+ * @file uart-spi-arq.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-arq.h"
+
+#include <assert.h>
+#include <string.h>
+
+// ============================================================================
+
+// The slot index is the 8-bit sequence number modulo the slots, so they must divide 256
+#if UART_SPI_ARQ_WINDOW_MAX < 2 || UART_SPI_ARQ_WINDOW_MAX > 32 || \
+    (UART_SPI_ARQ_WINDOW_MAX & (UART_SPI_ARQ_WINDOW_MAX - 1)) != 0
+#error "UART_SPI_ARQ_WINDOW_MAX must be a power of two 2 - 32"
+#endif
+
+// ============================================================================
+
+typedef enum {
+    ARQ_SLOT_FREE = 0,
+    ARQ_SLOT_FILLING,           /// The frame is being filled
+    ARQ_SLOT_READY,             /// Closed, never transmitted
+    ARQ_SLOT_SENT,              /// Waits for the acknowledgement
+    ARQ_SLOT_LOST,              /// The retransmission is due
+} arq_slot_state_t;
+
+// ============================================================================
+
+static uart_spi_arq_slot_t *arq_slot(uart_spi_arq_t *arq, uint8_t seq);
+static void arq_close(uart_spi_arq_t *arq, uart_spi_arq_slot_t *slot);
+static void arq_expire(uart_spi_arq_t *arq, uint32_t now_ms);
+static void arq_rtt_update(uart_spi_arq_t *arq, uint32_t rtt);
+static void arq_window_update(uart_spi_arq_t *arq);
+static int hex_digit(char c);
+
+// ============================================================================
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// ============================================================================
+
+void uart_spi_arq_init(uart_spi_arq_t *arq, uint32_t byte_rate)
+{
+    assert(arq);
+
+    for (size_t q = 0; q < UART_SPI_ARQ_WINDOW_MAX; q++) {
+        arq->slots[q].state = ARQ_SLOT_FREE;
+    }
+
+    arq->base = 0;
+    arq->next = 0;
+    arq->open = 0;
+
+    arq->frame_avg = UART_SPI_ARQ_FRAME_SIZE << 3;
+
+    arq->srtt = 0;
+    arq->rttvar = 0;
+    arq->rto = UART_SPI_ARQ_RTO_INITIAL_MS;
+    arq->sent_order = 0;
+
+    arq->retransmissions = 0;
+    arq->timeouts = 0;
+
+    uart_spi_arq_rate_set(arq, byte_rate);
+}
+
+void uart_spi_arq_rate_set(uart_spi_arq_t *arq, uint32_t byte_rate)
+{
+    assert(byte_rate > 0);
+
+    arq->byte_rate = byte_rate;
+
+    arq_window_update(arq);
+}
+
+size_t uart_spi_arq_append(uart_spi_arq_t *arq, const void *data, size_t length)
+{
+    if (length == 0) {
+        return 0;
+    }
+
+    if (arq->open == arq->next) {
+        if (uart_spi_arq_in_flight(arq) >= arq->window) {
+            return 0;
+        }
+
+        // The window never exceeds the slots, so the slot is free
+        uart_spi_arq_slot_t *slot = arq_slot(arq, arq->next);
+        assert(slot->state == ARQ_SLOT_FREE);
+
+        slot->state = ARQ_SLOT_FILLING;
+        slot->sacked = false;
+        slot->transmissions = 0;
+
+        slot->data[0] = UART_SPI_ARQ_FRAME_MORE;
+        slot->data[1] = hex_digits[arq->next >> 4];
+        slot->data[2] = hex_digits[arq->next & 0x0F];
+        slot->length = UART_SPI_ARQ_HEADER_LENGTH;
+
+        arq->open = arq->next;
+        arq->next++;
+    }
+
+    uart_spi_arq_slot_t *slot = arq_slot(arq, arq->open);
+
+    // The last byte is kept for the terminator
+    size_t space = UART_SPI_ARQ_FRAME_SIZE - 1 - slot->length;
+
+    const uint8_t *bytes = data;
+    const uint8_t *end = memchr(bytes, '\0', length);
+
+    if (end && (size_t)(end - bytes) <= space) {
+        // The string ends in this frame. Its terminator is the frame terminator
+        length = end - bytes + 1;
+
+        memcpy(slot->data + slot->length, bytes, length);
+        slot->length += length;
+
+        slot->data[0] = UART_SPI_ARQ_FRAME_END;
+        arq_close(arq, slot);
+
+        return length;
+    }
+
+    if (length > space) {
+        length = space;
+    }
+
+    memcpy(slot->data + slot->length, bytes, length);
+    slot->length += length;
+
+    if (slot->length == UART_SPI_ARQ_FRAME_SIZE - 1) {
+        slot->data[slot->length++] = '\0';
+        arq_close(arq, slot);
+    }
+
+    return length;
+}
+
+void uart_spi_arq_flush(uart_spi_arq_t *arq)
+{
+    if (arq->open == arq->next) {
+        return;
+    }
+
+    uart_spi_arq_slot_t *slot = arq_slot(arq, arq->open);
+
+    slot->data[slot->length++] = '\0';
+    arq_close(arq, slot);
+}
+
+const uint8_t *uart_spi_arq_next(uart_spi_arq_t *arq, uint32_t now_ms, size_t *length)
+{
+    arq_expire(arq, now_ms);
+
+    uart_spi_arq_slot_t *found = NULL;
+
+    // The retransmissions go first. The new frames are transmitted in order
+    for (uint8_t seq = arq->base; seq != arq->next; seq++) {
+        uart_spi_arq_slot_t *slot = arq_slot(arq, seq);
+
+        if (slot->state == ARQ_SLOT_LOST) {
+            found = slot;
+            break;
+        }
+
+        if (slot->state == ARQ_SLOT_READY && found == NULL) {
+            found = slot;
+        }
+    }
+
+    if (found == NULL) {
+        return NULL;
+    }
+
+    if (found->transmissions > 0) {
+        arq->retransmissions++;
+    }
+
+    found->state = ARQ_SLOT_SENT;
+    found->transmissions++;
+    found->sent_ms = now_ms;
+    found->sent_order = ++arq->sent_order;
+
+    *length = found->length;
+
+    return found->data;
+}
+
+void uart_spi_arq_ack(uart_spi_arq_t *arq, uint8_t next, uint32_t sack, uint32_t now_ms)
+{
+    size_t in_flight = uart_spi_arq_in_flight(arq);
+    size_t acked = (uint8_t)(next - arq->base);
+
+    if (acked > in_flight) {
+        // Outside the window. Stale or corrupted
+        return;
+    }
+
+    for (size_t q = 0; q < acked; q++) {
+        uint8_t state = arq_slot(arq, arq->base + q)->state;
+
+        if (state != ARQ_SLOT_SENT && state != ARQ_SLOT_LOST) {
+            return;
+        }
+    }
+
+    // The newest frame transmitted once gives the round-trip time sample (Karn's rule)
+    uart_spi_arq_slot_t *sample = NULL;
+
+    for (size_t q = 0; q < acked; q++) {
+        uart_spi_arq_slot_t *slot = arq_slot(arq, arq->base + q);
+
+        if (slot->transmissions == 1 && (sample == NULL || slot->sent_order > sample->sent_order)) {
+            sample = slot;
+        }
+
+        slot->state = ARQ_SLOT_FREE;
+    }
+
+    arq->base = next;
+    in_flight -= acked;
+
+    // The last transmission order of the frames received out of order
+    uint32_t sacked_order = 0;
+
+    for (size_t n = 0; n < 32 && n + 1 < in_flight; n++) {
+        uart_spi_arq_slot_t *slot = arq_slot(arq, next + 1 + n);
+
+        if ((sack & (1UL << n)) == 0 || (slot->state != ARQ_SLOT_SENT && slot->state != ARQ_SLOT_LOST)) {
+            continue;
+        }
+
+        slot->state = ARQ_SLOT_SENT;
+        slot->sacked = true;
+
+        if (slot->sent_order > sacked_order) {
+            sacked_order = slot->sent_order;
+        }
+
+        if (slot->transmissions == 1 && (sample == NULL || slot->sent_order > sample->sent_order)) {
+            sample = slot;
+        }
+    }
+
+    // The frames transmitted before the one received are lost
+    for (uint8_t seq = arq->base; seq != arq->next; seq++) {
+        uart_spi_arq_slot_t *slot = arq_slot(arq, seq);
+
+        if (slot->state == ARQ_SLOT_SENT && !slot->sacked && slot->sent_order < sacked_order) {
+            slot->state = ARQ_SLOT_LOST;
+        }
+    }
+
+    if (sample) {
+        arq_rtt_update(arq, now_ms - sample->sent_ms);
+    }
+}
+
+uint32_t uart_spi_arq_timeout(const uart_spi_arq_t *arq, uint32_t now_ms)
+{
+    uint32_t timeout = UINT32_MAX;
+
+    for (uint8_t seq = arq->base; seq != arq->next; seq++) {
+        const uart_spi_arq_slot_t *slot = &arq->slots[seq % UART_SPI_ARQ_WINDOW_MAX];
+
+        if (slot->state == ARQ_SLOT_LOST) {
+            return 0;
+        }
+
+        if (slot->state == ARQ_SLOT_SENT && !slot->sacked) {
+            uint32_t elapsed = now_ms - slot->sent_ms;
+            uint32_t left = elapsed < arq->rto ? arq->rto - elapsed : 0;
+
+            if (left < timeout) {
+                timeout = left;
+            }
+        }
+    }
+
+    return timeout;
+}
+
+int uart_spi_arq_ack_parse(const char *text, size_t length, uint8_t *next, uint32_t *sack)
+{
+    if (length != UART_SPI_ARQ_ACK_LENGTH) {
+        return -1;
+    }
+
+    uint32_t value = 0;
+
+    for (size_t q = 0; q < length; q++) {
+        int digit = hex_digit(text[q]);
+        if (digit < 0) {
+            return -1;
+        }
+
+        value = (value << 4) | digit;
+
+        if (q == 1) {
+            *next = value;
+            value = 0;
+        }
+    }
+
+    *sack = value;
+
+    return 0;
+}
+
+// ============================================================================
+
+static uart_spi_arq_slot_t *arq_slot(uart_spi_arq_t *arq, uint8_t seq)
+{
+    return &arq->slots[seq % UART_SPI_ARQ_WINDOW_MAX];
+}
+
+/**
+ * @brief Pass the filled frame to the transmission
+ *
+ */
+static void arq_close(uart_spi_arq_t *arq, uart_spi_arq_slot_t *slot)
+{
+    slot->state = ARQ_SLOT_READY;
+    arq->open = arq->next;
+
+    // Short frames need more of them in flight
+    arq->frame_avg += slot->length - (arq->frame_avg >> 3);
+    arq_window_update(arq);
+}
+
+/**
+ * @brief Mark the frames not acknowledged within the retransmission timeout as lost
+ *
+ * The timeout is doubled on each expiration until the next round-trip time sample
+ */
+static void arq_expire(uart_spi_arq_t *arq, uint32_t now_ms)
+{
+    bool expired = false;
+
+    for (uint8_t seq = arq->base; seq != arq->next; seq++) {
+        uart_spi_arq_slot_t *slot = arq_slot(arq, seq);
+
+        if (slot->state == ARQ_SLOT_SENT && !slot->sacked && now_ms - slot->sent_ms >= arq->rto) {
+            slot->state = ARQ_SLOT_LOST;
+            expired = true;
+        }
+    }
+
+    if (expired) {
+        arq->timeouts++;
+
+        arq->rto *= 2;
+        if (arq->rto > UART_SPI_ARQ_RTO_MAX_MS) {
+            arq->rto = UART_SPI_ARQ_RTO_MAX_MS;
+        }
+    }
+}
+
+/**
+ * @brief Update the round-trip time estimation and the retransmission timeout (RFC 6298)
+ *
+ * @param rtt The round-trip time sample in ms
+ */
+static void arq_rtt_update(uart_spi_arq_t *arq, uint32_t rtt)
+{
+    if (rtt == 0) {
+        // Below the tick resolution
+        rtt = 1;
+    }
+
+    if (arq->srtt == 0) {
+        arq->srtt = rtt << 3;
+        arq->rttvar = rtt << 1;
+    }
+    else {
+        int32_t error = (int32_t)rtt - (int32_t)(arq->srtt >> 3);
+
+        arq->srtt += error;
+
+        if (error < 0) {
+            error = -error;
+        }
+
+        arq->rttvar += error - (arq->rttvar >> 2);
+    }
+
+    // SRTT + 4 * RTTVAR
+    arq->rto = (arq->srtt >> 3) + (arq->rttvar > 0 ? arq->rttvar : 1);
+
+    if (arq->rto < UART_SPI_ARQ_RTO_MIN_MS) {
+        arq->rto = UART_SPI_ARQ_RTO_MIN_MS;
+    }
+    else if (arq->rto > UART_SPI_ARQ_RTO_MAX_MS) {
+        arq->rto = UART_SPI_ARQ_RTO_MAX_MS;
+    }
+
+    arq_window_update(arq);
+}
+
+/**
+ * @brief Size the window to the bandwidth-delay product
+ *
+ * The window covers the frames the line transmits within the round-trip time,
+ * the frame being transmitted and one more for the jitter
+ */
+static void arq_window_update(uart_spi_arq_t *arq)
+{
+    uint32_t rtt = arq->srtt > 0 ? arq->srtt >> 3 : UART_SPI_ARQ_RTO_INITIAL_MS;
+    if (rtt > UART_SPI_ARQ_RTO_MAX_MS) {
+        rtt = UART_SPI_ARQ_RTO_MAX_MS;
+    }
+
+    // Both factors are limited, so the product fits
+    uint32_t bdp = rtt * (arq->byte_rate / 8) / 125;
+
+    size_t window = (bdp << 3) / arq->frame_avg + 2;
+
+    if (window > UART_SPI_ARQ_WINDOW_MAX) {
+        window = UART_SPI_ARQ_WINDOW_MAX;
+    }
+
+    arq->window = window;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    c |= 0x20;
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file uart-spi-arq.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Selective repeat ARQ sender of the SPI-to-UART direction.
+ *
+ * The forwarded strings are cut into numbered frames. Each frame is a null
+ * terminated string, so the frames never break the string framing of the link:
+ *
+ *     <type> <seq: 2 hex digits> <payload> '\0'
+ *
+ * The type is @ref UART_SPI_ARQ_FRAME_END for the last frame of the string
+ * and @ref UART_SPI_ARQ_FRAME_MORE for the frame the string continues in the
+ * next one. The frame terminator is the string terminator.
+ *
+ * The peer acknowledges the frames by the strings
+ *
+ *     <UART_SPI_ARQ_ACK> <next: 2 hex digits> <sack: 8 hex digits> '\0'
+ *
+ * where \c next is the next expected sequence number (all the previous frames
+ * are received) and the \c sack bit n is set if the frame \c next + 1 + n
+ * is received out of order.
+ *
+ * The frames are retained in the send window until they are acknowledged.
+ * A frame is retransmitted once a frame sent after it is acknowledged
+ * selectively, or on the retransmission timeout derived from the measured
+ * round-trip time. The window is sized to the bandwidth-delay product of the link,
+ * so the sender keeps the line busy while waiting for the acknowledgements.
+ *
+ * The sender has no RTOS or HAL dependencies. The time is passed by the caller.
+ */
+
+#ifndef UART_SPI_ARQ_H_
+#define UART_SPI_ARQ_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+// The frame type bytes. STX and ETB are never sent by the text terminals
+#define UART_SPI_ARQ_FRAME_END      0x02
+#define UART_SPI_ARQ_FRAME_MORE     0x17
+
+// The acknowledgement string first byte (ACK)
+#define UART_SPI_ARQ_ACK            0x06
+
+// The acknowledgement length without the first byte and the terminator
+#define UART_SPI_ARQ_ACK_LENGTH     10
+
+// The frame header length: the type and the sequence number
+#define UART_SPI_ARQ_HEADER_LENGTH  3
+
+// The maximum frame length including the header and the terminator
+#define UART_SPI_ARQ_FRAME_SIZE     128
+
+// The maximum send window in frames. A power of two up to 32: the slots are indexed by the
+// sequence number modulo the window, the selective acknowledgement has 32 bits
+#define UART_SPI_ARQ_WINDOW_MAX     16
+
+// Retransmission timeout limits
+#define UART_SPI_ARQ_RTO_MIN_MS     10
+#define UART_SPI_ARQ_RTO_MAX_MS     1000
+#define UART_SPI_ARQ_RTO_INITIAL_MS 100
+
+// ============================================================================
+
+/**
+ * @brief Retained frame. The fields are private
+ *
+ */
+typedef struct {
+    uint8_t state;              /// The \c arq_slot_state_t
+    bool sacked;                /// Acknowledged selectively. Kept until the cumulative acknowledgement
+    uint8_t transmissions;      /// The number of the frame transmissions
+    uint16_t length;
+    uint32_t sent_ms;           /// The last transmission time
+    uint32_t sent_order;        /// The last transmission order number
+    uint8_t data[UART_SPI_ARQ_FRAME_SIZE];
+} uart_spi_arq_slot_t;
+
+/**
+ * @brief Sender structure. The fields are private
+ *
+ */
+typedef struct {
+    uart_spi_arq_slot_t slots[UART_SPI_ARQ_WINDOW_MAX];     /// Indexed by the sequence number modulo the size
+
+    uint8_t base;               /// The oldest not acknowledged sequence number
+    uint8_t next;               /// The sequence number of the next new frame
+    uint8_t open;               /// The frame being filled. \c next - no frame
+
+    uint32_t byte_rate;         /// The line rate in bytes per second
+    size_t window;              /// The current window in frames
+    uint32_t frame_avg;         /// The average frame length. Scaled by 8
+
+    uint32_t srtt;              /// The smoothed round-trip time. Scaled by 8. 0 - no samples yet
+    uint32_t rttvar;            /// The round-trip time variation. Scaled by 4
+    uint32_t rto;               /// The retransmission timeout in ms
+    uint32_t sent_order;        /// The transmissions counter
+
+    uint32_t retransmissions;   /// The number of the frames retransmitted
+    uint32_t timeouts;          /// The number of the retransmission timeouts
+} uart_spi_arq_t;
+
+// ============================================================================
+
+/**
+ * @brief Initialize the sender. The window is empty
+ *
+ * @param arq The pointer to the sender
+ * @param byte_rate The line rate in bytes per second
+ */
+void uart_spi_arq_init(uart_spi_arq_t *arq, uint32_t byte_rate);
+
+/**
+ * @brief Set the line rate after the link reconfiguration
+ *
+ */
+void uart_spi_arq_rate_set(uart_spi_arq_t *arq, uint32_t byte_rate);
+
+/**
+ * @brief Append the forwarded string bytes to the frame being filled
+ *
+ * The new frame is opened if the window allows. The frame is closed once
+ * the string terminator is appended or the frame is full. The bytes after
+ * the terminator are not appended
+ *
+ * @param arq The pointer to the sender
+ * @param data The pointer to the bytes
+ * @param length The number of bytes
+ * @return The number of bytes appended. 0 - the window is full
+ */
+size_t uart_spi_arq_append(uart_spi_arq_t *arq, const void *data, size_t length);
+
+/**
+ * @brief Close the frame being filled if any. The string continues in the next frame
+ *
+ * Passes the string part to the peer without waiting for the rest
+ */
+void uart_spi_arq_flush(uart_spi_arq_t *arq);
+
+/**
+ * @brief Get the next frame to transmit
+ *
+ * The frames due for the retransmission go first, then the new frames in order.
+ * The frame is accounted as transmitted at \c now_ms
+ *
+ * @param arq The pointer to the sender
+ * @param now_ms The current time
+ * @param length The frame length including the terminator
+ * @return The pointer to the frame, NULL - nothing to transmit.
+ * Valid until the next acknowledgement is passed
+ */
+const uint8_t *uart_spi_arq_next(uart_spi_arq_t *arq, uint32_t now_ms, size_t *length);
+
+/**
+ * @brief Process the acknowledgement
+ *
+ * The acknowledgement of the frames not transmitted yet is ignored
+ *
+ * @param arq The pointer to the sender
+ * @param next The next sequence number the peer expects
+ * @param sack The frames received out of order. Bit n - the frame \c next + 1 + n
+ * @param now_ms The current time
+ */
+void uart_spi_arq_ack(uart_spi_arq_t *arq, uint8_t next, uint32_t sack, uint32_t now_ms);
+
+/**
+ * @brief Get the time until the next retransmission timeout
+ *
+ * @return The time in ms, UINT32_MAX - no frames wait for the acknowledgement
+ */
+uint32_t uart_spi_arq_timeout(const uart_spi_arq_t *arq, uint32_t now_ms);
+
+/**
+ * @brief Get the number of the frames in the window including the frame being filled
+ *
+ */
+static inline size_t uart_spi_arq_in_flight(const uart_spi_arq_t *arq)
+{
+    return (uint8_t)(arq->next - arq->base);
+}
+
+/**
+ * @brief Parse the acknowledgement
+ *
+ * @param text The acknowledgement without the first byte and the terminator
+ * @param length The text length
+ * @param next The next sequence number the peer expects
+ * @param sack The selective acknowledgement bits
+ * @return 0 - on success, -1 - on error
+ */
+int uart_spi_arq_ack_parse(const char *text, size_t length, uint8_t *next, uint32_t *sack);
+
+#endif /* UART_SPI_ARQ_H_ */
@@ -0,0 +1,507 @@
+/**
+ * @file uart-spi-bench.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-bench.h"
+
+#if UART_SPI_BENCH
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+#include "cmsis_compiler.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+#define BENCH_TASK_STACK_SIZE       (128 * 4)
+
+#define BENCH_WINDOW_DEFAULT        4
+#define BENCH_TIMEOUT_DEFAULT_MS    1000
+
+// The maximum time to wait for the free application message slot
+#define BENCH_SEND_TIMEOUT_MS       100
+
+// The sequence number length in hex digits
+#define BENCH_HEADER_LENGTH         4
+
+// ============================================================================
+
+/**
+ * @brief Benchmark run state
+ *
+ */
+typedef struct {
+    uart_spi_bench_params_t params;
+    uart_spi_bench_result_t *result;
+    uart_spi_dir_t rx_dir;      /// The looped back strings direction
+
+    uint16_t expected;          /// The sequence number of the next string to come back
+    uint32_t completed;         /// The number of strings received, corrupted or lost
+    uint32_t sent_us[UART_SPI_BENCH_WINDOW_MAX];    /// Indexed by the sequence number modulo the size
+
+    uint8_t rx[UART_SPI_BENCH_LENGTH_MAX];          /// The string being received
+    size_t rx_length;
+    bool rx_overflow;           /// The string is longer than the buffer
+
+    uint32_t samples_seen;      /// The number of the latency samples offered to the reservoir
+    uint16_t sample_state;      /// The reservoir sampling generator state
+} bench_t;
+
+// ============================================================================
+
+static bool bench_acquire(void);
+static int bench_execute(const uart_spi_bench_params_t *params, uart_spi_bench_result_t *result);
+static void bench_task(void *argument);
+static bool bench_wait(void);
+static void bench_poll(uint32_t time_ms);
+static void bench_tap(const uart_spi_view_t *view, void *ctx);
+static void bench_string_complete(void);
+static void bench_string_corrupted(void);
+static void bench_sample(uint32_t latency_us);
+static void bench_latency_report(uart_spi_bench_result_t *result);
+static size_t bench_generate(uint16_t seq, uint8_t *data);
+static uint8_t prbs15_byte(uint16_t *state);
+
+// ============================================================================
+
+static bench_t bench;
+
+static uint32_t bench_samples[UART_SPI_BENCH_SAMPLES];
+
+// The string being sent. Then the expected string of the verification
+static uint8_t bench_string[UART_SPI_BENCH_LENGTH_MAX];
+
+static volatile bool bench_running = false;
+
+// The benchmark run by the task
+static uart_spi_bench_params_t bench_task_params;
+static uart_spi_bench_result_t bench_task_result;
+static volatile bool bench_task_done = false;
+
+// ============================================================================
+
+int uart_spi_bench_run(const uart_spi_bench_params_t *params, uart_spi_bench_result_t *result)
+{
+    if (!bench_acquire()) {
+        return -1;
+    }
+
+    int status = bench_execute(params, result);
+
+    bench_running = false;
+
+    return status;
+}
+
+int uart_spi_bench_start(const uart_spi_bench_params_t *params)
+{
+    if (uart_spi_tap_registered() || !bench_acquire()) {
+        return -1;
+    }
+
+    bench_task_params = *params;
+    bench_task_done = false;
+
+    const osThreadAttr_t bench_task_attributes = {
+        .name = "uart-spi-bench",
+        .stack_size = BENCH_TASK_STACK_SIZE
+    };
+
+    if (osThreadNew(bench_task, NULL, &bench_task_attributes) == NULL) {
+        bench_running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+int uart_spi_bench_result(uart_spi_bench_result_t *result)
+{
+    if (bench_running || !bench_task_done) {
+        return -1;
+    }
+
+    *result = bench_task_result;
+
+    return 0;
+}
+
+// ============================================================================
+
+/**
+ * @brief Take the benchmark state. One benchmark runs at a time
+ *
+ */
+static bool bench_acquire(void)
+{
+    bool acquired = false;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!bench_running) {
+        bench_running = true;
+        acquired = true;
+    }
+
+    __set_PRIMASK(primask);
+
+    return acquired;
+}
+
+static void bench_task(void *argument)
+{
+    (void)argument;
+
+    bench_task_done = bench_execute(&bench_task_params, &bench_task_result) == 0;
+    bench_running = false;
+
+    osThreadExit();
+}
+
+static int bench_execute(const uart_spi_bench_params_t *params, uart_spi_bench_result_t *result)
+{
+    if (params->dir >= UART_SPI_DIR_COUNT || params->count == 0 ||
+        params->length_min < UART_SPI_BENCH_LENGTH_MIN || params->length_max > UART_SPI_BENCH_LENGTH_MAX ||
+        params->length_min > params->length_max || params->window > UART_SPI_BENCH_WINDOW_MAX) {
+        return -1;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    memset(result, 0, sizeof(*result));
+
+    bench.params = *params;
+    bench.result = result;
+    bench.rx_dir = params->dir == UART_SPI_DIR_UART_TO_SPI ? UART_SPI_DIR_SPI_TO_UART : UART_SPI_DIR_UART_TO_SPI;
+    bench.sample_state = 1;
+
+    if (bench.params.window == 0) {
+        bench.params.window = BENCH_WINDOW_DEFAULT;
+    }
+
+    if (bench.params.timeout_ms == 0) {
+        bench.params.timeout_ms = BENCH_TIMEOUT_DEFAULT_MS;
+    }
+
+    if (uart_spi_tap_registered()) {
+        // The application observer
+        return -1;
+    }
+
+    if (uart_spi_tap_register(bench_tap, &bench) != 0) {
+        // The module is not started
+        return -1;
+    }
+
+    uint32_t start = osKernelGetTickCount();
+
+    for (uint32_t seq = 0; seq < bench.params.count; seq++) {
+        while (result->sent - bench.completed >= bench.params.window) {
+            if (!bench_wait()) {
+                // The oldest string is lost. It is ignored if it comes back later
+                bench.expected++;
+                bench.completed++;
+                result->lost++;
+            }
+        }
+
+        size_t length = bench_generate((uint16_t)seq, bench_string);
+
+        bench.sent_us[seq % UART_SPI_BENCH_WINDOW_MAX] = portGET_RUN_TIME_COUNTER_VALUE();
+
+        int status = bench.params.dir == UART_SPI_DIR_UART_TO_SPI ?
+            uart_spi_send_to_spi(bench_string, length, BENCH_SEND_TIMEOUT_MS) :
+            uart_spi_send_to_uart(bench_string, length, BENCH_SEND_TIMEOUT_MS);
+
+        if (status != 0) {
+            // The module is stopped or stuck. Report the strings sent so far
+            break;
+        }
+
+        result->sent++;
+
+        bench_poll(bench.params.gap_ms);
+    }
+
+    // The strings in flight
+    while (bench.completed < result->sent && bench_wait()) {
+    }
+
+    result->elapsed_ms = (osKernelGetTickCount() - start) * portTICK_PERIOD_MS;
+
+    uart_spi_tap_register(NULL, NULL);
+
+    result->lost += result->sent - bench.completed;
+
+    if (result->elapsed_ms > 0) {
+        result->byte_rate = (uint64_t)result->bytes * 1000 / result->elapsed_ms;
+    }
+
+    if (result->sent > 0) {
+        result->error_ppm = (uint64_t)(result->corrupted + result->lost) * 1000000 / result->sent;
+    }
+
+    bench_latency_report(result);
+
+    result->stack_free = uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t);
+
+    return 0;
+}
+
+/**
+ * @brief Dispatch the looped back data until a string is completed
+ *
+ * @return true - a string is completed, false - timeout
+ */
+static bool bench_wait(void)
+{
+    uint32_t completed = bench.completed;
+    uint32_t start = osKernelGetTickCount();
+
+    while (bench.completed == completed) {
+        if (osKernelGetTickCount() - start >= pdMS_TO_TICKS(bench.params.timeout_ms)) {
+            return false;
+        }
+
+        uart_spi_tap_dispatch(1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Dispatch the looped back data for the given time. At least the pending views
+ *
+ */
+static void bench_poll(uint32_t time_ms)
+{
+    uint32_t start = osKernelGetTickCount();
+
+    while (uart_spi_tap_dispatch(0) == 0) {
+    }
+
+    while (osKernelGetTickCount() - start < pdMS_TO_TICKS(time_ms)) {
+        uart_spi_tap_dispatch(1);
+    }
+}
+
+/**
+ * @brief Assemble the looped back strings. Called by the tap dispatch in the benchmark task
+ *
+ */
+static void bench_tap(const uart_spi_view_t *view, void *ctx)
+{
+    (void)ctx;
+
+    if (view->dir != bench.rx_dir) {
+        return;
+    }
+
+    for (size_t q = 0; q < view->length; q++) {
+        uint8_t byte = view->data[q];
+
+        if (bench.rx_length < sizeof(bench.rx)) {
+            bench.rx[bench.rx_length++] = byte;
+        }
+        else {
+            bench.rx_overflow = true;
+        }
+
+        if (byte == '\0') {
+            bench_string_complete();
+
+            bench.rx_length = 0;
+            bench.rx_overflow = false;
+        }
+    }
+}
+
+/**
+ * @brief Verify the received string against the regenerated one
+ *
+ * The strings come back in order. The skipped sequence numbers are lost
+ */
+static void bench_string_complete(void)
+{
+    uart_spi_bench_result_t *result = bench.result;
+    uint32_t now_us = portGET_RUN_TIME_COUNTER_VALUE();
+
+    if (bench.completed >= result->sent) {
+        // Not a benchmark string
+        return;
+    }
+
+    uint16_t seq = 0;
+
+    if (bench.rx_overflow || bench.rx_length <= BENCH_HEADER_LENGTH) {
+        bench_string_corrupted();
+        return;
+    }
+
+    for (size_t q = 0; q < BENCH_HEADER_LENGTH; q++) {
+        uint8_t digit = bench.rx[q];
+
+        if (digit >= '0' && digit <= '9') {
+            seq = seq << 4 | (digit - '0');
+        }
+        else if (digit >= 'a' && digit <= 'f') {
+            seq = seq << 4 | (digit - 'a' + 10);
+        }
+        else {
+            bench_string_corrupted();
+            return;
+        }
+    }
+
+    int16_t skipped = (int16_t)(seq - bench.expected);
+
+    if (skipped < 0) {
+        // Late. Already counted as lost
+        return;
+    }
+
+    if ((uint32_t)skipped >= result->sent - bench.completed) {
+        // Not sent yet. The sequence number is corrupted
+        bench_string_corrupted();
+        return;
+    }
+
+    result->lost += skipped;
+    bench.completed += skipped + 1;
+    bench.expected = seq + 1;
+
+    size_t length = bench_generate(seq, bench_string);
+
+    if (length != bench.rx_length || memcmp(bench.rx, bench_string, length) != 0) {
+        result->corrupted++;
+        return;
+    }
+
+    result->received++;
+    result->bytes += length;
+
+    bench_sample(now_us - bench.sent_us[seq % UART_SPI_BENCH_WINDOW_MAX]);
+}
+
+/**
+ * @brief Account the string that can't be verified as the expected one
+ *
+ */
+static void bench_string_corrupted(void)
+{
+    bench.result->corrupted++;
+    bench.completed++;
+    bench.expected++;
+}
+
+/**
+ * @brief Offer the latency to the reservoir of the samples
+ *
+ */
+static void bench_sample(uint32_t latency_us)
+{
+    if (latency_us > bench.result->latency_max_us) {
+        bench.result->latency_max_us = latency_us;
+    }
+
+    uint32_t seen = bench.samples_seen++;
+
+    if (seen < UART_SPI_BENCH_SAMPLES) {
+        bench_samples[seen] = latency_us;
+        return;
+    }
+
+    uint32_t random = prbs15_byte(&bench.sample_state) | prbs15_byte(&bench.sample_state) << 8 |
+                      prbs15_byte(&bench.sample_state) << 16;
+
+    uint32_t slot = random % (seen + 1);
+
+    if (slot < UART_SPI_BENCH_SAMPLES) {
+        bench_samples[slot] = latency_us;
+    }
+}
+
+static void bench_latency_report(uart_spi_bench_result_t *result)
+{
+    size_t count = bench.samples_seen < UART_SPI_BENCH_SAMPLES ? bench.samples_seen : UART_SPI_BENCH_SAMPLES;
+
+    if (count == 0) {
+        return;
+    }
+
+    // Insertion sort. The samples are few
+    for (size_t q = 1; q < count; q++) {
+        uint32_t sample = bench_samples[q];
+        size_t w = q;
+
+        for (; w > 0 && bench_samples[w - 1] > sample; w--) {
+            bench_samples[w] = bench_samples[w - 1];
+        }
+
+        bench_samples[w] = sample;
+    }
+
+    result->latency_p50_us = bench_samples[(count - 1) * 50 / 100];
+    result->latency_p90_us = bench_samples[(count - 1) * 90 / 100];
+    result->latency_p99_us = bench_samples[(count - 1) * 99 / 100];
+}
+
+/**
+ * @brief Generate the string of the sequence number
+ *
+ * @param seq The sequence number
+ * @param data The buffer of @ref UART_SPI_BENCH_LENGTH_MAX bytes
+ * @return The string length including the terminator
+ */
+static size_t bench_generate(uint16_t seq, uint8_t *data)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    uint32_t seed = bench.params.seed ^ bench.params.seed >> 16;
+    uint16_t state = (uint16_t)(seed + seq * 0x2F1DU) & 0x7FFF;
+
+    if (state == 0) {
+        state = 1;
+    }
+
+    size_t span = bench.params.length_max - bench.params.length_min + 1;
+    size_t length = bench.params.length_min + (prbs15_byte(&state) | prbs15_byte(&state) << 8) % span;
+
+    for (size_t q = 0; q < BENCH_HEADER_LENGTH; q++) {
+        data[q] = digits[seq >> (12 - 4 * q) & 0xF];
+    }
+
+    // The payload never contains the terminator
+    for (size_t q = BENCH_HEADER_LENGTH; q < length - 1; q++) {
+        data[q] = prbs15_byte(&state) % 255 + 1;
+    }
+
+    data[length - 1] = '\0';
+
+    return length;
+}
+
+/**
+ * @brief Get the next 8 bits of the PRBS-15 sequence (x^15 + x^14 + 1)
+ *
+ */
+static uint8_t prbs15_byte(uint16_t *state)
+{
+    uint8_t byte = 0;
+
+    for (int q = 0; q < 8; q++) {
+        uint16_t bit = (*state >> 14 ^ *state >> 13) & 1;
+
+        *state = (uint16_t)(*state << 1 | bit) & 0x7FFF;
+        byte = byte << 1 | bit;
+    }
+
+    return byte;
+}
+
+#endif /* UART_SPI_BENCH */
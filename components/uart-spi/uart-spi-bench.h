@@ -0,0 +1,126 @@
+/**
+ * @file uart-spi-bench.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Optional loopback self-benchmark of the \c uart-spi module.
+ *
+ * Enabled by the \c UART_SPI_BENCH=1 definition. The benchmark generates the
+ * strings in one direction and verifies them when they come back forwarded
+ * in the other one, so the opposite peripheral must be looped back:
+ *
+ * - toward the UART (@ref UART_SPI_DIR_SPI_TO_UART): the UART TX wired to RX
+ * - toward the SPI (@ref UART_SPI_DIR_UART_TO_SPI): the SPI slave echoing MOSI
+ *   or MOSI wired to MISO
+ *
+ * Each string is
+ *
+ *     <sequence number: 4 hex digits> <PRBS-15 payload: bytes 1 - 255> '\0'
+ *
+ * The string length is uniformly distributed between the limits. The length
+ * and the payload are derived from the seed and the sequence number, so the
+ * received string is verified without keeping its copy.
+ *
+ * The generated strings are sent as the application messages and received by
+ * the tap observer. The benchmark doesn't run while the application observer
+ * is registered: its dispatch would pass the benchmark views to the
+ * application task.
+ */
+
+#ifndef UART_SPI_BENCH_H_
+#define UART_SPI_BENCH_H_
+
+#include "uart-spi.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+#ifndef UART_SPI_BENCH
+#define UART_SPI_BENCH              0
+#endif
+
+// The string length limits including the sequence number and the terminator
+#define UART_SPI_BENCH_LENGTH_MIN   5
+#define UART_SPI_BENCH_LENGTH_MAX   256
+
+// The maximum number of the strings in flight
+#define UART_SPI_BENCH_WINDOW_MAX   16
+
+// The number of the latency samples kept for the percentiles. Sampled uniformly from all the strings
+#define UART_SPI_BENCH_SAMPLES      256
+
+// ============================================================================
+
+/**
+ * @brief Benchmark parameters
+ *
+ */
+typedef struct {
+    uart_spi_dir_t dir;         /// The generated strings direction
+    uint32_t count;             /// The number of strings
+    uint16_t length_min;        /// The minimum string length
+    uint16_t length_max;        /// The maximum string length
+    uint16_t gap_ms;            /// The pause after each string. 0 - back to back
+    uint8_t window;             /// The maximum number of strings in flight. 1 - 16. 0 - 4
+    uint32_t seed;              /// The generator seed
+    uint32_t timeout_ms;        /// The time to wait for a string to come back. 0 - 1000 ms
+} uart_spi_bench_params_t;
+
+/**
+ * @brief Benchmark result
+ *
+ */
+typedef struct {
+    uint32_t sent;              /// The number of strings sent
+    uint32_t received;          /// The number of strings looped back intact
+    uint32_t corrupted;         /// The number of strings looped back with the wrong length or content
+    uint32_t lost;              /// The number of strings not looped back
+    uint32_t bytes;             /// The number of bytes looped back intact
+    uint32_t elapsed_ms;        /// The benchmark duration
+    uint32_t byte_rate;         /// The looped back intact bytes per second
+    uint32_t error_ppm;         /// The corrupted and lost strings per million sent
+    uint32_t latency_p50_us;    /// The string round-trip time percentiles, from the send call to the terminator
+    uint32_t latency_p90_us;
+    uint32_t latency_p99_us;
+    uint32_t latency_max_us;
+    uint32_t stack_free;        /// The minimum free stack of the task that ran the benchmark in bytes
+} uart_spi_bench_result_t;
+
+// ============================================================================
+
+#if UART_SPI_BENCH
+
+/**
+ * @brief Run the benchmark in the calling task
+ *
+ * The module must be started
+ *
+ * @param params The pointer to the parameters
+ * @param result The pointer to the result
+ * @return 0 - on success, -1 - on error, another benchmark running or the tap observer registered
+ */
+int uart_spi_bench_run(const uart_spi_bench_params_t *params, uart_spi_bench_result_t *result);
+
+/**
+ * @brief Run the benchmark in its own task
+ *
+ * Returns immediately. Used by the management channel, whose task forwards the benchmark data
+ *
+ * @param params The pointer to the parameters. Copied
+ * @return 0 - on success, -1 - on error, another benchmark running or the tap observer registered
+ */
+int uart_spi_bench_start(const uart_spi_bench_params_t *params);
+
+/**
+ * @brief Get the result of the benchmark started by the \ref uart_spi_bench_start
+ *
+ * @param result The pointer to the result
+ * @return 0 - on success, -1 - the benchmark is running or failed or has not been started
+ */
+int uart_spi_bench_result(uart_spi_bench_result_t *result);
+
+#endif /* UART_SPI_BENCH */
+
+#endif /* UART_SPI_BENCH_H_ */
@@ -0,0 +1,217 @@
+/**
+ * @file uart-spi-capture.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-capture.h"
+
+#if UART_SPI_CAPTURE
+
+#include "FreeRTOS.h"
+
+#include "cmsis_compiler.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+// ============================================================================
+
+#if (UART_SPI_CAPTURE_RING_SIZE & (UART_SPI_CAPTURE_RING_SIZE - 1)) != 0
+#error "UART_SPI_CAPTURE_RING_SIZE must be a power of two"
+#endif
+
+// A span being copied is never overwritten by the other task span
+#if UART_SPI_CAPTURE_RING_SIZE < 4 * (UART_SPI_CAPTURE_SPAN_MAX + UART_SPI_CAPTURE_HEADER_SIZE)
+#error "UART_SPI_CAPTURE_RING_SIZE is too small"
+#endif
+
+// The number of data bytes per dump line
+#define CAPTURE_DUMP_BYTES          16
+
+// ============================================================================
+
+static void capture_record(uint8_t dir, const uint8_t *data, size_t length);
+static void capture_write(uint32_t position, const void *data, size_t length);
+static void capture_read(uint32_t position, void *data, size_t length);
+static uint16_t capture_info_get(uint32_t position);
+
+// ============================================================================
+
+static uint8_t capture_ring[UART_SPI_CAPTURE_RING_SIZE];
+
+// The total number of the recorded bytes. The ring index is its lower bits
+static uint32_t capture_head = 0;
+
+// The oldest span position
+static uint32_t capture_tail = 0;
+
+// The number of the overwritten spans
+static uint32_t capture_lost = 0;
+
+static volatile bool capture_paused = false;
+
+// ============================================================================
+
+void uart_spi_capture_span(uint8_t dir, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    while (length > 0) {
+        size_t span = length < UART_SPI_CAPTURE_SPAN_MAX ? length : UART_SPI_CAPTURE_SPAN_MAX;
+
+        capture_record(dir, bytes, span);
+
+        bytes += span;
+        length -= span;
+    }
+}
+
+void uart_spi_capture_dump(uart_spi_capture_output_t output, void *ctx)
+{
+    char line[48];
+    int length;
+
+    capture_paused = true;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t head = capture_head;
+    uint32_t tail = capture_tail;
+    uint32_t lost = capture_lost;
+
+    __set_PRIMASK(primask);
+
+    length = snprintf(line, sizeof(line), "# uart-spi capture v1\n");
+    output(line, length, ctx);
+
+    length = snprintf(line, sizeof(line), "L %lu\n", (unsigned long)lost);
+    output(line, length, ctx);
+
+    for (uint32_t position = tail; position != head;) {
+        uint8_t header[UART_SPI_CAPTURE_HEADER_SIZE];
+        capture_read(position, header, sizeof(header));
+
+        uint32_t timestamp = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+        uint16_t info = header[4] | header[5] << 8;
+        size_t span = info & 0x7FFF;
+
+        length = snprintf(line, sizeof(line), "S %08lx %u %u\n",
+                          (unsigned long)timestamp, info >> 15, (unsigned)span);
+        output(line, length, ctx);
+
+        position += UART_SPI_CAPTURE_HEADER_SIZE;
+
+        for (size_t offset = 0; offset < span; offset += CAPTURE_DUMP_BYTES) {
+            uint8_t bytes[CAPTURE_DUMP_BYTES];
+            size_t count = span - offset < CAPTURE_DUMP_BYTES ? span - offset : CAPTURE_DUMP_BYTES;
+
+            capture_read(position + offset, bytes, count);
+
+            length = snprintf(line, sizeof(line), "D ");
+            for (size_t q = 0; q < count; q++) {
+                length += snprintf(line + length, sizeof(line) - length, "%02x", bytes[q]);
+            }
+            length += snprintf(line + length, sizeof(line) - length, "\n");
+
+            output(line, length, ctx);
+        }
+
+        position += span;
+    }
+
+    capture_paused = false;
+}
+
+void uart_spi_capture_clear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    capture_tail = capture_head;
+    capture_lost = 0;
+
+    __set_PRIMASK(primask);
+}
+
+// ============================================================================
+
+/**
+ * @brief Record the span up to @ref UART_SPI_CAPTURE_SPAN_MAX bytes
+ *
+ * The space and the header are written with the interrupts disabled.
+ * The data is copied after that, the ring holds several spans
+ */
+static void capture_record(uint8_t dir, const uint8_t *data, size_t length)
+{
+    if (capture_paused) {
+        return;
+    }
+
+    size_t size = UART_SPI_CAPTURE_HEADER_SIZE + length;
+    uint16_t info = (uint16_t)((dir & 1) << 15 | length);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t timestamp = portGET_RUN_TIME_COUNTER_VALUE();
+
+    // Overwrite the oldest spans
+    while (capture_head + size - capture_tail > UART_SPI_CAPTURE_RING_SIZE) {
+        capture_tail += UART_SPI_CAPTURE_HEADER_SIZE + (capture_info_get(capture_tail) & 0x7FFF);
+        capture_lost++;
+    }
+
+    uint32_t position = capture_head;
+    capture_head += size;
+
+    uint8_t header[UART_SPI_CAPTURE_HEADER_SIZE] = {
+        (uint8_t)timestamp, (uint8_t)(timestamp >> 8), (uint8_t)(timestamp >> 16), (uint8_t)(timestamp >> 24),
+        (uint8_t)info, (uint8_t)(info >> 8)
+    };
+
+    capture_write(position, header, sizeof(header));
+
+    __set_PRIMASK(primask);
+
+    capture_write(position + UART_SPI_CAPTURE_HEADER_SIZE, data, length);
+}
+
+static void capture_write(uint32_t position, const void *data, size_t length)
+{
+    size_t offset = position & (UART_SPI_CAPTURE_RING_SIZE - 1);
+    size_t first = UART_SPI_CAPTURE_RING_SIZE - offset;
+
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(&capture_ring[offset], data, first);
+    memcpy(capture_ring, (const uint8_t *)data + first, length - first);
+}
+
+static void capture_read(uint32_t position, void *data, size_t length)
+{
+    size_t offset = position & (UART_SPI_CAPTURE_RING_SIZE - 1);
+    size_t first = UART_SPI_CAPTURE_RING_SIZE - offset;
+
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(data, &capture_ring[offset], first);
+    memcpy((uint8_t *)data + first, capture_ring, length - first);
+}
+
+static uint16_t capture_info_get(uint32_t position)
+{
+    uint8_t info[2];
+
+    capture_read(position + 4, info, sizeof(info));
+
+    return info[0] | info[1] << 8;
+}
+
+#endif /* UART_SPI_CAPTURE */
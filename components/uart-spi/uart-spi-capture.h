@@ -0,0 +1,103 @@
+/**
+ * @file uart-spi-capture.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Optional traffic capture of the \c uart-spi module.
+ *
+ * Enabled by the \c UART_SPI_CAPTURE=1 definition. The forwarded spans are
+ * recorded with the direction and the microsecond timestamp of the FreeRTOS
+ * run time stats counter into the RAM ring of @ref UART_SPI_CAPTURE_RING_SIZE
+ * bytes. The oldest spans are overwritten.
+ *
+ * Each span takes @ref UART_SPI_CAPTURE_HEADER_SIZE bytes in addition to its data,
+ * the same record layout as in the capture file:
+ *
+ *     <timestamp: 4 bytes LE> <direction << 15 | length: 2 bytes LE> <data>
+ *
+ * Use \c tools/uart-spi-capture.py to convert the dump to the capture file
+ * and to replay the capture against the bridge.
+ */
+
+#ifndef UART_SPI_CAPTURE_H_
+#define UART_SPI_CAPTURE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+#ifndef UART_SPI_CAPTURE
+#define UART_SPI_CAPTURE            0
+#endif
+
+// The ring size in bytes. Must be a power of two
+#ifndef UART_SPI_CAPTURE_RING_SIZE
+#define UART_SPI_CAPTURE_RING_SIZE  4096
+#endif
+
+// The maximum span length. The longer spans are recorded as several spans
+#define UART_SPI_CAPTURE_SPAN_MAX   128
+
+// The span record header length
+#define UART_SPI_CAPTURE_HEADER_SIZE 6
+
+// ============================================================================
+
+/**
+ * @brief Capture dump output callback prototype
+ *
+ * @param line The null terminated text line including the line feed
+ * @param length The line length without the terminator
+ * @param ctx The user context passed to the \ref uart_spi_capture_dump
+ */
+typedef void (*uart_spi_capture_output_t)(const char *line, size_t length, void *ctx);
+
+// ============================================================================
+
+#if UART_SPI_CAPTURE
+
+/**
+ * @brief Record the forwarded span
+ *
+ * Called from the bridge tasks
+ *
+ * @param dir The \ref uart_spi_dir_t
+ * @param data The pointer to the forwarded data
+ * @param length The data length
+ */
+void uart_spi_capture_span(uint8_t dir, const void *data, size_t length);
+
+/**
+ * @brief Dump the capture ring as text lines
+ *
+ * The recording is paused during the dump. The format is:
+ *
+ *     # uart-spi capture v1
+ *     L <the number of the overwritten spans>
+ *     S <timestamp: 8 hex digits> <direction> <length>
+ *     D <up to 16 data bytes as hex digits>
+ *
+ * The spans go from the oldest to the newest. The data lines follow their span line
+ *
+ * @param output The output callback called for each line
+ * @param ctx The user context passed to the callback
+ */
+void uart_spi_capture_dump(uart_spi_capture_output_t output, void *ctx);
+
+/**
+ * @brief Drop all the recorded spans
+ *
+ */
+void uart_spi_capture_clear(void);
+
+#define UART_SPI_CAPTURE_SPAN(dir, data, length) \
+    uart_spi_capture_span((uint8_t)(dir), (data), (length))
+
+#else
+
+#define UART_SPI_CAPTURE_SPAN(dir, data, length)
+
+#endif /* UART_SPI_CAPTURE */
+
+#endif /* UART_SPI_CAPTURE_H_ */
@@ -0,0 +1,268 @@
+/**
+ * @file uart-spi-config.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-config.h"
+#include "uart-spi-crc.h"
+
+#include "stm32g0xx_hal.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// ============================================================================
+
+// "USC" and the record layout version. Records of the other layouts are ignored
+#define CONFIG_MAGIC                0x55534301UL
+
+#define CONFIG_ERASED               0xFFFFFFFFUL
+
+#define CONFIG_SLOTS                (FLASH_PAGE_SIZE / sizeof(config_record_t))
+
+// ============================================================================
+
+/**
+ * @brief The record stored in the flash
+ *
+ * Programmed by double words, so the size is a multiple of 8
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;              /// Incremented on each save
+    uart_spi_tunables_t tunables;
+    uint32_t reserved;
+    uint32_t crc;                   /// CRC-32 of the preceding fields
+} config_record_t;
+
+_Static_assert(sizeof(config_record_t) % sizeof(uint64_t) == 0, "config record must be double word aligned");
+
+// ============================================================================
+
+static void config_read_begin(void);
+static bool config_read_end(void);
+static const config_record_t *config_slot(uint32_t page, uint32_t slot);
+static bool config_slot_erased(const config_record_t *record);
+static bool config_record_valid(const config_record_t *record);
+static const config_record_t *config_latest(uint32_t *page);
+static int config_page_erase(uint32_t page);
+static int config_program(const config_record_t *slot, const config_record_t *record);
+
+// ============================================================================
+
+// The store is being read: its double ECC error is expected
+static volatile bool config_reading = false;
+static volatile bool config_ecc_error = false;
+
+// ============================================================================
+
+int uart_spi_config_load(uart_spi_tunables_t *tunables)
+{
+    const config_record_t *latest = config_latest(NULL);
+
+    if (latest == NULL) {
+        return -1;
+    }
+
+    *tunables = latest->tunables;
+
+    return 0;
+}
+
+int uart_spi_config_save(const uart_spi_tunables_t *tunables)
+{
+    uint32_t page = 0;
+    const config_record_t *latest = config_latest(&page);
+
+    if (latest != NULL && memcmp(&latest->tunables, tunables, sizeof(*tunables)) == 0) {
+        // Save the flash wear
+        return 0;
+    }
+
+    config_record_t record;
+
+    memset(&record, 0, sizeof(record));
+    record.magic = CONFIG_MAGIC;
+    record.sequence = latest != NULL ? latest->sequence + 1 : 0;
+    record.tunables = *tunables;
+    record.crc = uart_spi_crc32(&record, offsetof(config_record_t, crc));
+
+    // The first free slot after the used ones in the current page
+    const config_record_t *slot = NULL;
+
+    for (uint32_t q = CONFIG_SLOTS; q > 0 && config_slot_erased(config_slot(page, q - 1)); q--) {
+        slot = config_slot(page, q - 1);
+    }
+
+    HAL_FLASH_Unlock();
+
+    int result = 0;
+
+    if (slot == NULL) {
+        // The page is full. Continue in the next one keeping the current records until then
+        page = (page + 1) % UART_SPI_CONFIG_PAGES;
+        slot = config_slot(page, 0);
+
+        result = config_page_erase(page);
+    }
+
+    if (result == 0) {
+        result = config_program(slot, &record);
+    }
+
+    HAL_FLASH_Lock();
+
+    if (result != 0 || memcmp(slot, &record, sizeof(record)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+bool uart_spi_config_nmi(void)
+{
+    if (!config_reading || !__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD)) {
+        return false;
+    }
+
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+    config_ecc_error = true;
+
+    return true;
+}
+
+// ============================================================================
+
+/**
+ * @brief Start reading the store. Its double ECC errors are caught by the \ref uart_spi_config_nmi
+ *
+ */
+static void config_read_begin(void)
+{
+    config_ecc_error = false;
+    config_reading = true;
+    __DSB();
+}
+
+/**
+ * @brief Finish reading the store
+ *
+ * @return true - the data read are intact, false - a double ECC error
+ */
+static bool config_read_end(void)
+{
+    __DSB();
+    config_reading = false;
+
+    return !config_ecc_error;
+}
+
+/**
+ * @brief Get the record slot address
+ *
+ * @param page The store page index. 0 - @ref UART_SPI_CONFIG_PAGES - 1
+ * @param slot The slot index in the page
+ */
+static const config_record_t *config_slot(uint32_t page, uint32_t slot)
+{
+    uint32_t page_first = FLASH_PAGE_NB - UART_SPI_CONFIG_PAGES;
+    uint32_t address = FLASH_BASE + (page_first + page) * FLASH_PAGE_SIZE + slot * sizeof(config_record_t);
+
+    return (const config_record_t *)address;
+}
+
+/**
+ * @brief Check if the slot is erased
+ *
+ * The slot of the interrupted save is not erased even if it reads as such
+ */
+static bool config_slot_erased(const config_record_t *record)
+{
+    const uint32_t *words = (const uint32_t *)record;
+    bool erased = true;
+
+    config_read_begin();
+
+    for (size_t q = 0; q < sizeof(*record) / sizeof(uint32_t) && erased; q++) {
+        erased = words[q] == CONFIG_ERASED;
+    }
+
+    return config_read_end() && erased;
+}
+
+/**
+ * @brief Check if the slot holds the complete record
+ *
+ * The double word whose programming was interrupted fails the ECC check on read
+ */
+static bool config_record_valid(const config_record_t *record)
+{
+    config_read_begin();
+
+    bool valid = record->magic == CONFIG_MAGIC &&
+                 record->crc == uart_spi_crc32(record, offsetof(config_record_t, crc));
+
+    return config_read_end() && valid;
+}
+
+/**
+ * @brief Find the last saved record
+ *
+ * @param page The pointer to the page index of the record to be filled. Can be NULL.
+ * Untouched if no valid record
+ * @return The pointer to the record, NULL - no valid record
+ */
+static const config_record_t *config_latest(uint32_t *page)
+{
+    const config_record_t *latest = NULL;
+
+    for (uint32_t p = 0; p < UART_SPI_CONFIG_PAGES; p++) {
+        for (uint32_t q = 0; q < CONFIG_SLOTS; q++) {
+            const config_record_t *record = config_slot(p, q);
+
+            if (!config_record_valid(record)) {
+                // Erased or the interrupted save
+                continue;
+            }
+
+            if (latest == NULL || (int32_t)(record->sequence - latest->sequence) > 0) {
+                latest = record;
+
+                if (page) {
+                    *page = p;
+                }
+            }
+        }
+    }
+
+    return latest;
+}
+
+static int config_page_erase(uint32_t page)
+{
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Page = FLASH_PAGE_NB - UART_SPI_CONFIG_PAGES + page,
+        .NbPages = 1
+    };
+
+    uint32_t error;
+
+    return HAL_FLASHEx_Erase(&erase, &error) == HAL_OK ? 0 : -1;
+}
+
+static int config_program(const config_record_t *slot, const config_record_t *record)
+{
+    for (size_t q = 0; q < sizeof(*record); q += sizeof(uint64_t)) {
+        uint64_t dword;
+
+        memcpy(&dword, (const uint8_t *)record + q, sizeof(dword));
+
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, (uint32_t)slot + q, dword) != HAL_OK) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
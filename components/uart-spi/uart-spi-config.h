@@ -0,0 +1,63 @@
+/**
+ * @file uart-spi-config.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Persistent \c uart-spi tunables in the last two flash pages.
+ *
+ * Each save appends a CRC protected record to the current page. When the page
+ * is full, the next page is erased and the records continue there, so a page
+ * is erased only once per several dozen saves. The record with the greatest
+ * sequence number and a valid CRC is loaded. A save interrupted by the power
+ * loss leaves the previous record in effect. Its partly programmed double word
+ * fails the ECC check, so the NMI handler must call the
+ * \ref uart_spi_config_nmi first.
+ *
+ * The linker script keeps the pages out of the program memory.
+ */
+
+#ifndef UART_SPI_CONFIG_H_
+#define UART_SPI_CONFIG_H_
+
+#include "uart-spi.h"
+
+// ============================================================================
+
+// The number of flash pages at the end of the flash used by the store
+#define UART_SPI_CONFIG_PAGES       2
+
+// ============================================================================
+
+/**
+ * @brief Load the last saved tunables
+ *
+ * Fast enough to be called on every boot before the \ref uart_spi_start
+ *
+ * @param tunables The pointer to the \ref uart_spi_tunables_t structure to be filled.
+ * Untouched on error
+ * @return 0 - on success, -1 - no valid record
+ */
+int uart_spi_config_load(uart_spi_tunables_t *tunables);
+
+/**
+ * @brief Save the tunables
+ *
+ * Nothing is written if the tunables are the same as the last saved ones.
+ * The CPU is stalled for up to 40 ms while the page is erased,
+ * so the data received meanwhile can be lost
+ *
+ * @param tunables The pointer to the \ref uart_spi_tunables_t structure
+ * @return 0 - on success, -1 - on error
+ */
+int uart_spi_config_save(const uart_spi_tunables_t *tunables);
+
+/**
+ * @brief Handle the flash double ECC error NMI raised by the store read
+ *
+ * Clears the error and marks the record being read as invalid
+ *
+ * @return true - handled, false - not raised by the store, the NMI is fatal
+ */
+bool uart_spi_config_nmi(void);
+
+#endif /* UART_SPI_CONFIG_H_ */
@@ -0,0 +1,103 @@
+/**
+ * @file uart-spi-crc.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-crc.h"
+
+#if UART_SPI_CRC_HW
+#include "main.h"
+#endif
+
+#include <stdbool.h>
+
+// ============================================================================
+
+// The reflected polynomial 0xEDB88320 applied four bits at a time.
+// A compromise between the table size and the speed
+static const uint32_t crc32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+// ============================================================================
+
+#if UART_SPI_CRC_HW
+static uint32_t bit_reverse(uint32_t value);
+
+// The CRC unit is clocked and configured
+static bool crc_hw_ready = false;
+#endif
+
+// ============================================================================
+
+uint32_t uart_spi_crc32(const void *data, size_t length)
+{
+    return uart_spi_crc32_update(0, data, length);
+}
+
+uint32_t uart_spi_crc32_update(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *ptr = data;
+
+    crc = ~crc;
+
+    while (length--) {
+        crc ^= *ptr++;
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+uint32_t uart_spi_crc32_hw_update(uint32_t crc, const void *data, size_t length)
+{
+#if UART_SPI_CRC_HW
+    const uint8_t *ptr = data;
+
+    if (!crc_hw_ready) {
+        __HAL_RCC_CRC_CLK_ENABLE();
+
+        // The 32-bit polynomial 0x04C11DB7. The input bytes and the result are bit-reversed like zlib
+        CRC->POL = 0x04C11DB7;
+        CRC->CR = CRC_CR_REV_IN_0 | CRC_CR_REV_OUT;
+
+        crc_hw_ready = true;
+    }
+
+    // Resume from the previous CRC. The unit keeps the state not reversed and not inverted
+    CRC->INIT = bit_reverse(~crc);
+    CRC->CR |= CRC_CR_RESET;
+
+    // Byte writes keep the zlib byte order
+    while (length--) {
+        *(__IO uint8_t *)&CRC->DR = *ptr++;
+    }
+
+    return ~CRC->DR;
+#else
+    return uart_spi_crc32_update(crc, data, length);
+#endif
+}
+
+// ============================================================================
+
+#if UART_SPI_CRC_HW
+
+/**
+ * @brief Reverse the bits order. Cortex-M0+ has no RBIT instruction
+ * 
+ */
+static uint32_t bit_reverse(uint32_t value)
+{
+    value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+    value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+    value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+
+    return (value >> 16) | (value << 16);
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file uart-spi-crc.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#ifndef UART_SPI_CRC_H_
+#define UART_SPI_CRC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+// Use the CRC unit in the \ref uart_spi_crc32_hw_update. 0 - the software calculation for host builds
+#ifndef UART_SPI_CRC_HW
+#define UART_SPI_CRC_HW         1
+#endif
+
+// ============================================================================
+
+/**
+ * @brief Calculate the CRC-32 (IEEE 802.3, the same as zlib)
+ * 
+ * @param data The pointer to the data
+ * @param length The data length in bytes
+ * @return The CRC
+ */
+uint32_t uart_spi_crc32(const void *data, size_t length);
+
+/**
+ * @brief Continue the CRC-32 calculation in software
+ * 
+ * Can be called from any context
+ * 
+ * @param crc The CRC of the previous data. 0 - no previous data
+ * @param data The pointer to the data
+ * @param length The data length in bytes
+ * @return The CRC of the previous and the new data
+ */
+uint32_t uart_spi_crc32_update(uint32_t crc, const void *data, size_t length);
+
+/**
+ * @brief Continue the CRC-32 calculation by the CRC unit
+ * 
+ * The result is the same as of the \ref uart_spi_crc32_update.
+ * The unit is not shared: the function must be called from one task only
+ * 
+ * @param crc The CRC of the previous data. 0 - no previous data
+ * @param data The pointer to the data
+ * @param length The data length in bytes
+ * @return The CRC of the previous and the new data
+ */
+uint32_t uart_spi_crc32_hw_update(uint32_t crc, const void *data, size_t length);
+
+#endif /* UART_SPI_CRC_H_ */
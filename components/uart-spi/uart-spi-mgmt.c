@@ -0,0 +1,416 @@
+/**
+ * @file uart-spi-mgmt.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-mgmt.h"
+
+#if UART_SPI_MGMT
+
+#include "uart-spi.h"
+#include "uart-spi-trace.h"
+#include "uart-spi-capture.h"
+#include "uart-spi-bench.h"
+#include "uart-spi-config.h"
+
+#include "cmsis_os.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+
+/**
+ * @brief Named structure field
+ *
+ */
+typedef struct {
+    const char *name;
+    size_t offset;
+    size_t size;                /// The field size in bytes. 1, 2 or 4
+} mgmt_field_t;
+
+#define MGMT_FIELD(type, field) { #field, offsetof(type, field), sizeof(((type *)0)->field) }
+
+// ============================================================================
+
+static void mgmt_reply(uart_spi_mgmt_output_t output, void *ctx, const char *format, ...);
+static uint32_t mgmt_field_get(const void *base, const mgmt_field_t *field);
+static const mgmt_field_t *mgmt_field_find(const mgmt_field_t *fields, size_t count, const char *name, size_t length);
+
+static int mgmt_stats(uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_hist(uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_trace(uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_capture(const char *args, uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_bench(const char *args, uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_get(uart_spi_mgmt_output_t output, void *ctx);
+static int mgmt_set(const char *args);
+static int mgmt_save(void);
+
+// ============================================================================
+
+static const mgmt_field_t stats_fields[] = {
+    MGMT_FIELD(uart_spi_stats_t, tap_dropped),
+    MGMT_FIELD(uart_spi_stats_t, uart_parity_errors),
+    MGMT_FIELD(uart_spi_stats_t, uart_framing_errors),
+    MGMT_FIELD(uart_spi_stats_t, uart_noise_errors),
+    MGMT_FIELD(uart_spi_stats_t, uart_overrun_errors),
+    MGMT_FIELD(uart_spi_stats_t, uart_dma_errors),
+    MGMT_FIELD(uart_spi_stats_t, uart_rx_restarts),
+    MGMT_FIELD(uart_spi_stats_t, uart_rx_discarded),
+    MGMT_FIELD(uart_spi_stats_t, uart_deadline_misses),
+    MGMT_FIELD(uart_spi_stats_t, spi_deadline_misses),
+    MGMT_FIELD(uart_spi_stats_t, uart_recoveries),
+    MGMT_FIELD(uart_spi_stats_t, spi_recoveries),
+    MGMT_FIELD(uart_spi_stats_t, uart_stalls),
+    MGMT_FIELD(uart_spi_stats_t, spi_stalls),
+    MGMT_FIELD(uart_spi_stats_t, last_recovery_tick),
+    MGMT_FIELD(uart_spi_stats_t, watchdog_reset),
+    MGMT_FIELD(uart_spi_stats_t, uart_task_load),
+    MGMT_FIELD(uart_spi_stats_t, spi_task_load),
+    MGMT_FIELD(uart_spi_stats_t, isr_load),
+    MGMT_FIELD(uart_spi_stats_t, uart_task_stack_free),
+    MGMT_FIELD(uart_spi_stats_t, spi_task_stack_free),
+    MGMT_FIELD(uart_spi_stats_t, uart_crc_errors),
+    MGMT_FIELD(uart_spi_stats_t, spi_crc_errors),
+    MGMT_FIELD(uart_spi_stats_t, pool_exhausted),
+    MGMT_FIELD(uart_spi_stats_t, pool_free_min),
+    MGMT_FIELD(uart_spi_stats_t, arq_retransmissions),
+    MGMT_FIELD(uart_spi_stats_t, arq_timeouts),
+    MGMT_FIELD(uart_spi_stats_t, arq_window),
+    MGMT_FIELD(uart_spi_stats_t, arq_rto_ms),
+};
+
+#if UART_SPI_BENCH
+static const mgmt_field_t bench_fields[] = {
+    MGMT_FIELD(uart_spi_bench_result_t, sent),
+    MGMT_FIELD(uart_spi_bench_result_t, received),
+    MGMT_FIELD(uart_spi_bench_result_t, corrupted),
+    MGMT_FIELD(uart_spi_bench_result_t, lost),
+    MGMT_FIELD(uart_spi_bench_result_t, bytes),
+    MGMT_FIELD(uart_spi_bench_result_t, elapsed_ms),
+    MGMT_FIELD(uart_spi_bench_result_t, byte_rate),
+    MGMT_FIELD(uart_spi_bench_result_t, error_ppm),
+    MGMT_FIELD(uart_spi_bench_result_t, latency_p50_us),
+    MGMT_FIELD(uart_spi_bench_result_t, latency_p90_us),
+    MGMT_FIELD(uart_spi_bench_result_t, latency_p99_us),
+    MGMT_FIELD(uart_spi_bench_result_t, latency_max_us),
+    MGMT_FIELD(uart_spi_bench_result_t, stack_free),
+};
+#endif
+
+// The short names are used by the "set" command
+static const mgmt_field_t tunables_fields[] = {
+    { "baud", offsetof(uart_spi_tunables_t, uart_baud), sizeof(uint32_t) },
+    { "spi_div", offsetof(uart_spi_tunables_t, spi_prescaler), sizeof(uint32_t) },
+    { "buffer", offsetof(uart_spi_tunables_t, buffer_size), sizeof(uint32_t) },
+    { "chunk", offsetof(uart_spi_tunables_t, chunk_size), sizeof(uint32_t) },
+    { "batch", offsetof(uart_spi_tunables_t, batch_size), sizeof(uint32_t) },
+    { "poll", offsetof(uart_spi_tunables_t, poll_period_ms), sizeof(uint32_t) },
+};
+
+static const char *const dir_names[UART_SPI_DIR_COUNT] = {
+    [UART_SPI_DIR_UART_TO_SPI] = "u2s",
+    [UART_SPI_DIR_SPI_TO_UART] = "s2u",
+};
+
+// ============================================================================
+
+void uart_spi_mgmt_execute(const char *command, uart_spi_mgmt_output_t output, void *ctx)
+{
+    int result;
+
+    if (strcmp(command, "stats") == 0) {
+        result = mgmt_stats(output, ctx);
+    }
+    else if (strcmp(command, "hist") == 0) {
+        result = mgmt_hist(output, ctx);
+    }
+    else if (strcmp(command, "trace") == 0) {
+        result = mgmt_trace(output, ctx);
+    }
+    else if (strncmp(command, "capture", 7) == 0) {
+        result = mgmt_capture(command + 7, output, ctx);
+    }
+    else if (strncmp(command, "bench", 5) == 0) {
+        result = mgmt_bench(command + 5, output, ctx);
+    }
+    else if (strcmp(command, "get") == 0) {
+        result = mgmt_get(output, ctx);
+    }
+    else if (strncmp(command, "set ", 4) == 0) {
+        result = mgmt_set(command + 4);
+    }
+    else if (strcmp(command, "save") == 0) {
+        result = mgmt_save();
+    }
+    else {
+        result = -1;
+    }
+
+    mgmt_reply(output, ctx, result == 0 ? "ok" : "err");
+}
+
+// ============================================================================
+
+/**
+ * @brief Format the reply line and pass it to the output
+ *
+ * The line feed is appended
+ */
+static void mgmt_reply(uart_spi_mgmt_output_t output, void *ctx, const char *format, ...)
+{
+    char line[UART_SPI_MGMT_LINE_SIZE + 2];
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+
+    if ((size_t)length > sizeof(line) - 2) {
+        // Truncated
+        length = sizeof(line) - 2;
+    }
+
+    line[length++] = '\n';
+    line[length] = '\0';
+
+    output(line, length, ctx);
+}
+
+static uint32_t mgmt_field_get(const void *base, const mgmt_field_t *field)
+{
+    const uint8_t *ptr = (const uint8_t *)base + field->offset;
+
+    switch (field->size) {
+        case sizeof(uint8_t): return *ptr;
+        case sizeof(uint16_t): return *(const uint16_t *)ptr;
+        default: return *(const uint32_t *)ptr;
+    }
+}
+
+static const mgmt_field_t *mgmt_field_find(const mgmt_field_t *fields, size_t count, const char *name, size_t length)
+{
+    for (size_t q = 0; q < count; q++) {
+        if (strlen(fields[q].name) == length && strncmp(fields[q].name, name, length) == 0) {
+            return &fields[q];
+        }
+    }
+
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+static int mgmt_stats(uart_spi_mgmt_output_t output, void *ctx)
+{
+    uart_spi_stats_t stats;
+
+    uart_spi_get_stats(&stats);
+
+    for (size_t q = 0; q < sizeof(stats_fields) / sizeof(stats_fields[0]); q++) {
+        mgmt_reply(output, ctx, "%s=%lu", stats_fields[q].name,
+                   (unsigned long)mgmt_field_get(&stats, &stats_fields[q]));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reply the histograms. One line per bucket: "<dir> <bucket> <count>"
+ *
+ */
+static int mgmt_hist(uart_spi_mgmt_output_t output, void *ctx)
+{
+    uart_spi_stats_t stats;
+
+    uart_spi_get_stats(&stats);
+
+    for (int dir = 0; dir < UART_SPI_DIR_COUNT; dir++) {
+        for (int bucket = 0; bucket < UART_SPI_HIST_BUCKETS; bucket++) {
+            mgmt_reply(output, ctx, "%s %d %lu", dir_names[dir], bucket,
+                       (unsigned long)stats.length_hist[dir][bucket]);
+        }
+    }
+
+    return 0;
+}
+
+static int mgmt_trace(uart_spi_mgmt_output_t output, void *ctx)
+{
+#if UART_SPI_TRACE
+    uart_spi_trace_dump(output, ctx);
+
+    return 0;
+#else
+    (void)output;
+    (void)ctx;
+
+    return -1;
+#endif
+}
+
+static int mgmt_capture(const char *args, uart_spi_mgmt_output_t output, void *ctx)
+{
+#if UART_SPI_CAPTURE
+    if (*args == '\0') {
+        uart_spi_capture_dump(output, ctx);
+    }
+    else if (strcmp(args, " clear") == 0) {
+        uart_spi_capture_clear();
+    }
+    else {
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)args;
+    (void)output;
+    (void)ctx;
+
+    return -1;
+#endif
+}
+
+/**
+ * @brief Start the benchmark: " <dir> <count> <length min> <length max> [gap ms] [window]".
+ * Reply the last benchmark result without the arguments
+ *
+ */
+static int mgmt_bench(const char *args, uart_spi_mgmt_output_t output, void *ctx)
+{
+#if UART_SPI_BENCH
+    if (*args == '\0') {
+        uart_spi_bench_result_t result;
+
+        if (uart_spi_bench_result(&result) != 0) {
+            return -1;
+        }
+
+        for (size_t q = 0; q < sizeof(bench_fields) / sizeof(bench_fields[0]); q++) {
+            mgmt_reply(output, ctx, "%s=%lu", bench_fields[q].name,
+                       (unsigned long)mgmt_field_get(&result, &bench_fields[q]));
+        }
+
+        return 0;
+    }
+
+    uart_spi_bench_params_t params = { 0 };
+
+    if (strncmp(args, " u2s ", 5) == 0) {
+        params.dir = UART_SPI_DIR_UART_TO_SPI;
+    }
+    else if (strncmp(args, " s2u ", 5) == 0) {
+        params.dir = UART_SPI_DIR_SPI_TO_UART;
+    }
+    else {
+        return -1;
+    }
+
+    // The count and the length limits are mandatory
+    unsigned long numbers[5] = { 0 };
+    const char *cursor = args + 5;
+    size_t count = 0;
+
+    while (*cursor != '\0' && count < sizeof(numbers) / sizeof(numbers[0])) {
+        char *end;
+        numbers[count++] = strtoul(cursor, &end, 0);
+
+        if (end == cursor || (*end != ' ' && *end != '\0')) {
+            return -1;
+        }
+
+        cursor = *end == ' ' ? end + 1 : end;
+    }
+
+    if (count < 3 || *cursor != '\0' ||
+        numbers[1] > UINT16_MAX || numbers[2] > UINT16_MAX || numbers[3] > UINT16_MAX || numbers[4] > UINT8_MAX) {
+        return -1;
+    }
+
+    params.count = numbers[0];
+    params.length_min = numbers[1];
+    params.length_max = numbers[2];
+    params.gap_ms = numbers[3];
+    params.window = numbers[4];
+    params.seed = osKernelGetTickCount();
+
+    return uart_spi_bench_start(&params);
+#else
+    (void)args;
+    (void)output;
+    (void)ctx;
+
+    return -1;
+#endif
+}
+
+static int mgmt_get(uart_spi_mgmt_output_t output, void *ctx)
+{
+    uart_spi_tunables_t tunables;
+
+    uart_spi_tunables_get(&tunables);
+
+    for (size_t q = 0; q < sizeof(tunables_fields) / sizeof(tunables_fields[0]); q++) {
+        mgmt_reply(output, ctx, "%s=%lu", tunables_fields[q].name,
+                   (unsigned long)mgmt_field_get(&tunables, &tunables_fields[q]));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set the tunable
+ *
+ * @param args "<name> <value>"
+ */
+static int mgmt_set(const char *args)
+{
+    const char *value = strchr(args, ' ');
+    if (value == NULL) {
+        return -1;
+    }
+
+    const mgmt_field_t *field = mgmt_field_find(tunables_fields, sizeof(tunables_fields) / sizeof(tunables_fields[0]),
+                                                args, value - args);
+    if (field == NULL) {
+        return -1;
+    }
+
+    char *end;
+    unsigned long number = strtoul(value + 1, &end, 0);
+    if (end == value + 1 || *end != '\0') {
+        return -1;
+    }
+
+    uart_spi_tunables_t tunables;
+
+    uart_spi_tunables_get(&tunables);
+
+    *(uint32_t *)((uint8_t *)&tunables + field->offset) = number;
+
+    return uart_spi_tunables_set(&tunables);
+}
+
+/**
+ * @brief Save the current tunables to the flash
+ *
+ */
+static int mgmt_save(void)
+{
+    uart_spi_tunables_t tunables;
+
+    uart_spi_tunables_get(&tunables);
+
+    return uart_spi_config_save(&tunables);
+}
+
+#endif /* UART_SPI_MGMT */
@@ -0,0 +1,81 @@
+/**
+ * @file uart-spi-mgmt.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * In-band management channel of the \c uart-spi module.
+ *
+ * Enabled by default. Define \c UART_SPI_MGMT=0 to remove it.
+ *
+ * A string received from the UART that starts with @ref UART_SPI_MGMT_PREFIX
+ * is not forwarded to the SPI. The rest of the string up to the terminator is
+ * the command. The command is executed by the UART task between the forwarded
+ * strings. Each reply line is transmitted to the UART as a separate null
+ * terminated string starting with the same prefix. The last reply line is
+ * \c ok or \c err.
+ *
+ * Commands:
+ *
+ *     stats               The module statistics as "<name>=<value>" lines
+ *     hist                The forwarded transfer length histograms as "<dir> <bucket> <count>" lines
+ *     trace               The event trace dump. Requires UART_SPI_TRACE=1
+ *     capture             The traffic capture dump. Requires UART_SPI_CAPTURE=1
+ *     capture clear       Drop the captured spans
+ *     bench <dir> <count> <min> <max> [gap] [window]
+ *                         Start the loopback benchmark. Requires UART_SPI_BENCH=1
+ *     bench               The last benchmark result as "<name>=<value>" lines
+ *     get                 The tunables as "<name>=<value>" lines
+ *     set <name> <value>  Set the tunable. The reply is sent before the new baud rate is applied
+ *     save                The current tunables to the flash. Loaded on the next boot
+ */
+
+#ifndef UART_SPI_MGMT_H_
+#define UART_SPI_MGMT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+#ifndef UART_SPI_MGMT
+#define UART_SPI_MGMT               1
+#endif
+
+// The command strings prefix. DLE DLE is never sent by the text terminals
+#ifndef UART_SPI_MGMT_PREFIX
+#define UART_SPI_MGMT_PREFIX        "\x10\x10"
+#endif
+
+#define UART_SPI_MGMT_PREFIX_LENGTH (sizeof(UART_SPI_MGMT_PREFIX) - 1)
+
+// The maximum command length including the terminator. Longer commands are dropped
+#define UART_SPI_MGMT_COMMAND_SIZE  32
+
+// The maximum reply line length without the prefix and the terminator
+#define UART_SPI_MGMT_LINE_SIZE     48
+
+// ============================================================================
+
+/**
+ * @brief Reply line output callback prototype
+ *
+ * Compatible with the \ref uart_spi_trace_output_t
+ *
+ * @param line The null terminated text line including the line feed
+ * @param length The line length without the terminator
+ * @param ctx The user context passed to the \ref uart_spi_mgmt_execute
+ */
+typedef void (*uart_spi_mgmt_output_t)(const char *line, size_t length, void *ctx);
+
+// ============================================================================
+
+/**
+ * @brief Execute the management command
+ *
+ * @param command The null terminated command without the prefix
+ * @param output The output callback called for each reply line
+ * @param ctx The user context passed to the callback
+ */
+void uart_spi_mgmt_execute(const char *command, uart_spi_mgmt_output_t output, void *ctx);
+
+#endif /* UART_SPI_MGMT_H_ */
@@ -0,0 +1,30 @@
+/**
+ * @file uart-spi-miso.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-miso.h"
+
+// ============================================================================
+
+size_t uart_spi_miso_filter(uart_spi_miso_t *miso, const uint8_t *in, size_t length, uint8_t *out)
+{
+    size_t count = 0;
+    bool receiving = miso->receiving;
+
+    for (size_t q = 0; q < length; q++) {
+        uint8_t byte = in[q];
+
+        // The terminator is passed as the string byte
+        if (byte != '\0' || receiving) {
+            out[count++] = byte;
+        }
+
+        receiving = byte != '\0';
+    }
+
+    miso->receiving = receiving;
+
+    return count;
+}
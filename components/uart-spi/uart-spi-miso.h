@@ -0,0 +1,92 @@
+/**
+ * @file uart-spi-miso.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Extraction of the strings from the SPI slave MISO data.
+ *
+ * The slave sends '\0' while it has nothing to send, so the strings are
+ * separated by the '\0' runs of any length. The first '\0' after a string
+ * is its terminator, the rest of the run is dropped.
+ *
+ * The filter has no RTOS or HAL dependencies and keeps its state between
+ * the calls, so the strings may be split at any transaction boundary.
+ * The output guarantees:
+ *
+ * - the output is never longer than the input
+ * - each string is terminated exactly once; no other '\0' is output
+ * - the output is the input with the '\0' runs reduced to one terminator
+ *   and the leading run dropped
+ */
+
+#ifndef UART_SPI_MISO_H_
+#define UART_SPI_MISO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+/**
+ * @brief The MISO byte class
+ *
+ */
+typedef enum {
+    UART_SPI_MISO_IDLE = 0,     /// The slave idle '\0'. Dropped
+    UART_SPI_MISO_DATA,         /// The string byte
+    UART_SPI_MISO_END,          /// The string terminator
+} uart_spi_miso_class_t;
+
+/**
+ * @brief Filter state
+ *
+ */
+typedef struct {
+    bool receiving;             /// A string is started and not terminated yet
+} uart_spi_miso_t;
+
+// ============================================================================
+
+/**
+ * @brief Reset the filter. The next string starts from the next non-zero byte
+ *
+ */
+static inline void uart_spi_miso_reset(uart_spi_miso_t *miso)
+{
+    miso->receiving = false;
+}
+
+/**
+ * @brief Classify the next MISO byte
+ *
+ */
+static inline uart_spi_miso_class_t uart_spi_miso_byte(uart_spi_miso_t *miso, uint8_t byte)
+{
+    if (byte != '\0') {
+        miso->receiving = true;
+        return UART_SPI_MISO_DATA;
+    }
+
+    if (miso->receiving) {
+        miso->receiving = false;
+        return UART_SPI_MISO_END;
+    }
+
+    return UART_SPI_MISO_IDLE;
+}
+
+/**
+ * @brief Extract the strings from the MISO data
+ *
+ * The output may be the input or precede it in the same buffer
+ *
+ * @param miso The pointer to the filter
+ * @param in The pointer to the MISO data
+ * @param length The data length
+ * @param out The pointer to the output of up to \c length bytes
+ * @return The output length
+ */
+size_t uart_spi_miso_filter(uart_spi_miso_t *miso, const uint8_t *in, size_t length, uint8_t *out);
+
+#endif /* UART_SPI_MISO_H_ */
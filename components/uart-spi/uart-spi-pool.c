@@ -0,0 +1,129 @@
+/**
+ * @file uart-spi-pool.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-pool.h"
+
+#include "cmsis_compiler.h"
+
+#include <assert.h>
+
+// ============================================================================
+
+void uart_spi_pool_init(uart_spi_pool_t *pool, uart_spi_buf_t *descs, void *mem, size_t count, size_t buff_size)
+{
+    assert(pool);
+    assert(descs);
+    assert(mem);
+    assert(count > 0 && count <= UINT8_MAX);
+    assert(buff_size > 0 && buff_size <= UINT16_MAX);
+
+    pool->descs = descs;
+    pool->count = count;
+    pool->buff_size = buff_size;
+
+    for (size_t q = 0; q < count; q++) {
+        descs[q].buff = (uint8_t *)mem + q * buff_size;
+        descs[q].offset = 0;
+        descs[q].length = 0;
+        descs[q].owner = UART_SPI_BUF_FREE;
+        descs[q].refs = 0;
+        descs[q].next = q + 1;
+    }
+
+    pool->free_head = 0;
+    pool->free_count = count;
+    pool->free_min = count;
+
+    for (size_t cls = 0; cls < UART_SPI_POOL_CLASSES; cls++) {
+        pool->used[cls] = 0;
+        pool->reserve[cls] = 0;
+        pool->limit[cls] = count;
+    }
+}
+
+void uart_spi_pool_quota_set(uart_spi_pool_t *pool, size_t cls, size_t reserve, size_t limit)
+{
+    assert(cls < UART_SPI_POOL_CLASSES);
+    assert(reserve <= limit && limit <= pool->count);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    pool->reserve[cls] = reserve;
+    pool->limit[cls] = limit;
+
+    __set_PRIMASK(primask);
+}
+
+uart_spi_buf_t *uart_spi_pool_alloc(uart_spi_pool_t *pool, size_t cls, uart_spi_buf_owner_t owner)
+{
+    uart_spi_buf_t *buf = NULL;
+
+    assert(cls < UART_SPI_POOL_CLASSES);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // The free buffers the other classes have not taken from their reservations yet
+    size_t reserved = 0;
+
+    for (size_t other = 0; other < UART_SPI_POOL_CLASSES; other++) {
+        if (other != cls && pool->used[other] < pool->reserve[other]) {
+            reserved += pool->reserve[other] - pool->used[other];
+        }
+    }
+
+    if (pool->used[cls] < pool->limit[cls] && pool->free_count > reserved) {
+        buf = &pool->descs[pool->free_head];
+        pool->free_head = buf->next;
+        pool->used[cls]++;
+
+        if (--pool->free_count < pool->free_min) {
+            pool->free_min = pool->free_count;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    if (buf) {
+        buf->offset = 0;
+        buf->length = 0;
+        buf->owner = owner;
+        buf->cls = cls;
+        buf->refs = 1;
+    }
+
+    return buf;
+}
+
+void uart_spi_buf_ref(uart_spi_buf_t *buf)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    buf->refs++;
+
+    __set_PRIMASK(primask);
+}
+
+void uart_spi_buf_unref(uart_spi_pool_t *pool, uart_spi_buf_t *buf)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    assert(buf->refs > 0);
+
+    if (--buf->refs == 0) {
+        buf->owner = UART_SPI_BUF_FREE;
+        buf->next = pool->free_head;
+
+        pool->free_head = uart_spi_pool_index(pool, buf);
+        pool->free_count++;
+        pool->used[buf->cls]--;
+    }
+
+    __set_PRIMASK(primask);
+}
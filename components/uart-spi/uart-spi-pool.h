@@ -0,0 +1,171 @@
+/**
+ * @file uart-spi-pool.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Fixed-size buffer pool with reference counted descriptors.
+ *
+ * The buffers are handed between the pipeline stages by the descriptor index
+ * without copying the data. Each stage that keeps the buffer holds a reference.
+ * The buffer returns to the pool when the last reference is dropped.
+ *
+ * The buffers are shared by several classes of users. Each class has a minimum
+ * reservation that the other classes can't take, and a maximum share.
+ *
+ * Allocation and release are O(1) and can be called from any context including
+ * interrupts. Cortex-M0+ has no exclusive access instructions, so the free list
+ * is protected by masking the interrupts for a few instructions.
+ */
+
+#ifndef UART_SPI_POOL_H_
+#define UART_SPI_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+// The number of the buffer classes with separate quotas
+#define UART_SPI_POOL_CLASSES   2
+
+// ============================================================================
+
+/**
+ * @brief The pipeline stage responsible for the buffer
+ *
+ */
+typedef enum {
+    UART_SPI_BUF_FREE = 0,
+    UART_SPI_BUF_SPI_RX,        /// Filled by the SPI reception
+    UART_SPI_BUF_UART_TX,       /// Queued to or transmitted by the UART
+    UART_SPI_BUF_UART_RX,       /// Filled by the UART reception
+    UART_SPI_BUF_SPI_TX,        /// Queued to or transmitted by the SPI
+} uart_spi_buf_owner_t;
+
+/**
+ * @brief Buffer descriptor
+ *
+ */
+typedef struct {
+    uint8_t *buff;              /// The buffer memory. Fixed
+    uint16_t offset;            /// The data start in the buffer
+    uint16_t length;            /// The data length
+    uint8_t owner;              /// The \ref uart_spi_buf_owner_t
+    uint8_t cls;                /// The class the buffer is accounted to
+    volatile uint8_t refs;      /// Reference count
+    uint8_t next;               /// The next free descriptor index
+} uart_spi_buf_t;
+
+/**
+ * @brief Pool structure. The fields are private
+ *
+ */
+typedef struct {
+    uart_spi_buf_t *descs;
+    size_t count;
+    size_t buff_size;
+    uint8_t free_head;          /// The first free descriptor index. \c count - the pool is exhausted
+    size_t free_count;
+    size_t free_min;            /// The low-water mark of the free descriptors
+
+    size_t used[UART_SPI_POOL_CLASSES];     /// The buffers taken by the class
+    size_t reserve[UART_SPI_POOL_CLASSES];  /// The buffers kept for the class
+    size_t limit[UART_SPI_POOL_CLASSES];    /// The maximum buffers of the class
+} uart_spi_pool_t;
+
+// ============================================================================
+
+/**
+ * @brief Initialize the pool. All the buffers are free
+ *
+ * Each class can take all the buffers until the quotas are set
+ *
+ * @param pool The pointer to the pool
+ * @param descs The array of \c count descriptors
+ * @param mem The buffers memory of \c count x \c buff_size bytes
+ * @param count The number of the buffers. Up to 255
+ * @param buff_size The size of each buffer in bytes. Up to 65535
+ */
+void uart_spi_pool_init(uart_spi_pool_t *pool, uart_spi_buf_t *descs, void *mem, size_t count, size_t buff_size);
+
+/**
+ * @brief Set the class quota
+ *
+ * The taken buffers are not affected. The sum of the reservations must not exceed the pool
+ *
+ * @param pool The pointer to the pool
+ * @param cls The class. Less than \ref UART_SPI_POOL_CLASSES
+ * @param reserve The number of the buffers the other classes can't take
+ * @param limit The maximum number of the buffers the class can take
+ */
+void uart_spi_pool_quota_set(uart_spi_pool_t *pool, size_t cls, size_t reserve, size_t limit);
+
+/**
+ * @brief Take the buffer from the pool
+ *
+ * The buffer is empty and has one reference
+ *
+ * @param cls The class the buffer is accounted to
+ * @param owner The \ref uart_spi_buf_owner_t of the new buffer
+ * @return The pointer to the descriptor, NULL - the pool or the class quota is exhausted
+ */
+uart_spi_buf_t *uart_spi_pool_alloc(uart_spi_pool_t *pool, size_t cls, uart_spi_buf_owner_t owner);
+
+/**
+ * @brief Add the buffer reference
+ *
+ */
+void uart_spi_buf_ref(uart_spi_buf_t *buf);
+
+/**
+ * @brief Drop the buffer reference. The last one returns the buffer to the pool
+ *
+ */
+void uart_spi_buf_unref(uart_spi_pool_t *pool, uart_spi_buf_t *buf);
+
+/**
+ * @brief Get the descriptor index to pass the buffer through a queue
+ *
+ */
+static inline uint8_t uart_spi_pool_index(const uart_spi_pool_t *pool, const uart_spi_buf_t *buf)
+{
+    return (uint8_t)(buf - pool->descs);
+}
+
+/**
+ * @brief Get the descriptor by its index
+ *
+ */
+static inline uart_spi_buf_t *uart_spi_pool_get(const uart_spi_pool_t *pool, uint8_t index)
+{
+    return &pool->descs[index];
+}
+
+/**
+ * @brief Get the buffer size
+ *
+ */
+static inline size_t uart_spi_pool_buff_size(const uart_spi_pool_t *pool)
+{
+    return pool->buff_size;
+}
+
+/**
+ * @brief Get the low-water mark of the free buffers
+ *
+ */
+static inline size_t uart_spi_pool_free_min(const uart_spi_pool_t *pool)
+{
+    return pool->free_min;
+}
+
+/**
+ * @brief Get the pointer to the buffer data
+ *
+ */
+static inline uint8_t *uart_spi_buf_data(const uart_spi_buf_t *buf)
+{
+    return buf->buff + buf->offset;
+}
+
+#endif /* UART_SPI_POOL_H_ */
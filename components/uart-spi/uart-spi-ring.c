@@ -0,0 +1,152 @@
+/**
+ * @file uart-spi-ring.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-ring.h"
+
+#include "cmsis_compiler.h"
+
+#include <assert.h>
+#include <string.h>
+
+// ============================================================================
+
+static void ring_wakeup(uart_spi_ring_t *ring);
+
+// ============================================================================
+
+void uart_spi_ring_init(uart_spi_ring_t *ring, void *buff, size_t size)
+{
+    assert(ring);
+    assert(buff);
+    assert(size > 0 && (size & (size - 1)) == 0);
+
+    ring->buff = buff;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    ring->hook = NULL;
+    ring->hook_ctx = NULL;
+    ring->wake_level = 1;
+    ring->waiting = false;
+}
+
+void uart_spi_ring_hook_set(uart_spi_ring_t *ring, uart_spi_ring_hook_t hook, void *ctx)
+{
+    ring->hook = hook;
+    ring->hook_ctx = ctx;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t uart_spi_ring_write(uart_spi_ring_t *ring, const void *data, size_t length)
+{
+    size_t head = ring->head;
+    size_t space = ring->mask + 1 - (head - ring->tail);
+
+    if (length > space) {
+        length = space;
+    }
+
+    if (length == 0) {
+        return 0;
+    }
+
+    // Up to two parts around the ring end
+    size_t offset = head & ring->mask;
+    size_t first = ring->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(ring->buff + offset, data, first);
+    memcpy(ring->buff, (const uint8_t *)data + first, length - first);
+
+    // The data must be in the memory before the consumer sees the new head
+    __DMB();
+
+    ring->head += length;
+
+    // The head must be visible before the waiting flag check
+    __DMB();
+
+    ring_wakeup(ring);
+
+    return length;
+}
+
+// ----------------------------------------------------------------------------
+
+size_t uart_spi_ring_read(uart_spi_ring_t *ring, void *data, size_t length)
+{
+    size_t tail = ring->tail;
+    size_t used = ring->head - tail;
+
+    if (length > used) {
+        length = used;
+    }
+
+    if (length == 0) {
+        return 0;
+    }
+
+    // The data must be read after the head
+    __DMB();
+
+    size_t offset = tail & ring->mask;
+    size_t first = ring->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(data, ring->buff + offset, first);
+    memcpy((uint8_t *)data + first, ring->buff, length - first);
+
+    // The data must be read out before the producer sees the space
+    __DMB();
+
+    ring->tail += length;
+
+    return length;
+}
+
+bool uart_spi_ring_wait_arm(uart_spi_ring_t *ring, size_t level)
+{
+    ring->wake_level = level > 0 ? level : 1;
+    __DMB();
+
+    ring->waiting = true;
+
+    // The flag must be visible before the head check. Pairs with the producer commit
+    __DMB();
+
+    return uart_spi_ring_used(ring) >= ring->wake_level;
+}
+
+void uart_spi_ring_wait_disarm(uart_spi_ring_t *ring)
+{
+    ring->waiting = false;
+}
+
+// ============================================================================
+
+/**
+ * @brief Call the hook if the waiting consumer has enough data
+ *
+ * Called by the producer
+ */
+static void ring_wakeup(uart_spi_ring_t *ring)
+{
+    if (!ring->waiting || uart_spi_ring_used(ring) < ring->wake_level) {
+        return;
+    }
+
+    ring->waiting = false;
+
+    if (ring->hook) {
+        ring->hook(ring->hook_ctx);
+    }
+}
@@ -0,0 +1,131 @@
+/**
+ * @file uart-spi-ring.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ *
+ * Lock-free single producer, single consumer byte ring.
+ *
+ * The producer and the consumer can run in any contexts including interrupts,
+ * as long as there is one of each. No critical sections are used: the producer
+ * writes the head only and the consumer writes the tail only. Both are free
+ * running counters, the ring size is a power of two.
+ *
+ * The bridge passes the 1-byte pool buffer indexes through the rings, the data
+ * itself stays in the pool buffers. The optional wakeup hook is called by the
+ * producer once the waiting consumer has enough data.
+ */
+
+#ifndef UART_SPI_RING_H_
+#define UART_SPI_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+/**
+ * @brief Consumer wakeup hook prototype
+ *
+ * Called in the producer context
+ *
+ * @param ctx The user context passed to the \ref uart_spi_ring_hook_set
+ */
+typedef void (*uart_spi_ring_hook_t)(void *ctx);
+
+/**
+ * @brief Ring structure. The fields are private
+ *
+ */
+typedef struct {
+    uint8_t *buff;
+    size_t mask;                    /// The ring size - 1
+    volatile size_t head;           /// Written bytes. Modified by the producer only
+    volatile size_t tail;           /// Read bytes. Modified by the consumer only
+
+    uart_spi_ring_hook_t hook;
+    void *hook_ctx;
+    size_t wake_level;              /// The data length the waiting consumer needs
+    volatile bool waiting;          /// Set by the consumer, cleared by the producer on the wakeup
+} uart_spi_ring_t;
+
+// ============================================================================
+
+/**
+ * @brief Initialize the empty ring
+ *
+ * @param ring The pointer to the ring
+ * @param buff The ring memory
+ * @param size The memory size in bytes. Must be a power of two
+ */
+void uart_spi_ring_init(uart_spi_ring_t *ring, void *buff, size_t size);
+
+/**
+ * @brief Set the consumer wakeup hook
+ *
+ * Must be set before the producer and the consumer start
+ *
+ * @param ring The pointer to the ring
+ * @param hook The hook. NULL - no hook
+ * @param ctx The user context passed to the hook
+ */
+void uart_spi_ring_hook_set(uart_spi_ring_t *ring, uart_spi_ring_hook_t hook, void *ctx);
+
+/**
+ * @brief Get the number of bytes available to the consumer
+ *
+ * Can be called from any context. The result is a snapshot
+ */
+static inline size_t uart_spi_ring_used(const uart_spi_ring_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+/**
+ * @brief Get the number of bytes available to the producer
+ *
+ * Can be called from any context. The result is a snapshot
+ */
+static inline size_t uart_spi_ring_free(const uart_spi_ring_t *ring)
+{
+    return ring->mask + 1 - (ring->head - ring->tail);
+}
+
+// ----------------------------------------------------------------------------
+// Producer
+
+/**
+ * @brief Copy the data to the ring
+ *
+ * @return The number of bytes written. Less than \c length if the ring is full
+ */
+size_t uart_spi_ring_write(uart_spi_ring_t *ring, const void *data, size_t length);
+
+// ----------------------------------------------------------------------------
+// Consumer
+
+/**
+ * @brief Copy the data from the ring
+ *
+ * @return The number of bytes read. Less than \c length if the ring has not enough data
+ */
+size_t uart_spi_ring_read(uart_spi_ring_t *ring, void *data, size_t length);
+
+/**
+ * @brief Request the wakeup hook call once the ring has \c level bytes
+ *
+ * The consumer must block only if the function returns false. The wakeup
+ * is not lost if the data comes between the call and the blocking
+ *
+ * @param level The data length to wait for. At least 1
+ * @return true - the ring has already enough data, false - the hook will be called
+ */
+bool uart_spi_ring_wait_arm(uart_spi_ring_t *ring, size_t level);
+
+/**
+ * @brief Cancel the wakeup request after the consumer is unblocked
+ *
+ */
+void uart_spi_ring_wait_disarm(uart_spi_ring_t *ring);
+
+#endif /* UART_SPI_RING_H_ */
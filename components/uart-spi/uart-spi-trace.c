@@ -0,0 +1,107 @@
+/**
+ * @file uart-spi-trace.c
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ */
+
+#include "uart-spi-trace.h"
+
+#if UART_SPI_TRACE
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cmsis_compiler.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// ============================================================================
+
+#if (UART_SPI_TRACE_RING_SIZE & (UART_SPI_TRACE_RING_SIZE - 1)) != 0
+#error "UART_SPI_TRACE_RING_SIZE must be a power of two"
+#endif
+
+// The tasks created between the counting and the listing
+#define TRACE_TASKS_SPARE           2
+
+// ============================================================================
+
+static uart_spi_trace_event_t trace_ring[UART_SPI_TRACE_RING_SIZE];
+
+// The total number of the recorded events. The ring index is its lower bits
+static uint32_t trace_head = 0;
+
+static volatile bool trace_paused = false;
+
+// ============================================================================
+
+void uart_spi_trace_event(uint8_t type, uint8_t arg8, uint16_t arg16)
+{
+    // Cortex-M0+ has no exclusive access instructions. The record is short
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Checked with the interrupts masked: the dump may start in between
+    if (trace_paused) {
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    uart_spi_trace_event_t *event = &trace_ring[trace_head++ & (UART_SPI_TRACE_RING_SIZE - 1)];
+
+    event->timestamp = portGET_RUN_TIME_COUNTER_VALUE();
+    event->type = type;
+    event->arg8 = arg8;
+    event->arg16 = arg16;
+
+    __set_PRIMASK(primask);
+}
+
+void uart_spi_trace_dump(uart_spi_trace_output_t output, void *ctx)
+{
+    char line[48];
+    int length;
+
+    trace_paused = true;
+    __DMB();
+
+    length = snprintf(line, sizeof(line), "# uart-spi trace v1\n");
+    output(line, length, ctx);
+
+    // Task numbers to names
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + TRACE_TASKS_SPARE;
+    TaskStatus_t *tasks = pvPortMalloc(capacity * sizeof(TaskStatus_t));
+    UBaseType_t count = tasks != NULL ? uxTaskGetSystemState(tasks, capacity, NULL) : 0;
+
+    for (UBaseType_t q = 0; q < count; q++) {
+        length = snprintf(line, sizeof(line), "T %u %s\n",
+                          (unsigned)tasks[q].xTaskNumber, tasks[q].pcTaskName);
+        output(line, length, ctx);
+    }
+
+    vPortFree(tasks);
+
+    if (count == 0) {
+        // No heap for the list. The tasks are shown by their numbers
+        length = snprintf(line, sizeof(line), "# task names not listed\n");
+        output(line, length, ctx);
+    }
+
+    uint32_t head = trace_head;
+    uint32_t tail = head > UART_SPI_TRACE_RING_SIZE ? head - UART_SPI_TRACE_RING_SIZE : 0;
+
+    for (uint32_t q = tail; q != head; q++) {
+        const uart_spi_trace_event_t *event = &trace_ring[q & (UART_SPI_TRACE_RING_SIZE - 1)];
+
+        // Timestamp, type, arg8 and arg16 as the fixed width hex numbers
+        length = snprintf(line, sizeof(line), "E %08lx%02x%02x%04x\n",
+                          (unsigned long)event->timestamp, event->type, event->arg8, event->arg16);
+        output(line, length, ctx);
+    }
+
+    __DMB();
+    trace_paused = false;
+}
+
+#endif /* UART_SPI_TRACE */
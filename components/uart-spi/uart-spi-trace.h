@@ -0,0 +1,112 @@
+/**
+ * @file uart-spi-trace.h
+ * @author Denis Shreiber (chuyecd@gmail.com)
+ * @date 2026-10-17
+ * 
+ * Optional binary event trace of the \c uart-spi module.
+ * 
+ * Enabled by the \c UART_SPI_TRACE=1 definition. The events are recorded
+ * with microsecond timestamps of the FreeRTOS run time stats counter into
+ * the RAM ring of @ref UART_SPI_TRACE_RING_SIZE events. The oldest events
+ * are overwritten.
+ * 
+ * The header is included by the FreeRTOSConfig.h to hook the FreeRTOS
+ * trace macros, so it must not include any FreeRTOS header.
+ */
+
+#ifndef UART_SPI_TRACE_H_
+#define UART_SPI_TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+
+#ifndef UART_SPI_TRACE
+#define UART_SPI_TRACE              0
+#endif
+
+// The number of events in the ring. Must be a power of two
+#ifndef UART_SPI_TRACE_RING_SIZE
+#define UART_SPI_TRACE_RING_SIZE    512
+#endif
+
+// ============================================================================
+
+/**
+ * @brief Trace event types
+ * 
+ */
+typedef enum {
+    UART_SPI_TRACE_ISR_ENTER = 1,   /// arg8 - IRQ number
+    UART_SPI_TRACE_ISR_EXIT,        /// arg8 - IRQ number
+    UART_SPI_TRACE_DMA_START,       /// arg8 - direction, arg16 - length
+    UART_SPI_TRACE_DMA_COMPLETE,    /// arg8 - direction
+    UART_SPI_TRACE_STREAM_SEND,     /// Data is put to the ring. arg8 - direction, arg16 - length
+    UART_SPI_TRACE_STREAM_RECEIVE,  /// Data is taken from the ring. arg8 - direction, arg16 - length
+    UART_SPI_TRACE_TASK_SWITCH,     /// arg8 - task number of the task switched in
+} uart_spi_trace_type_t;
+
+/**
+ * @brief Trace event record. 8 bytes
+ * 
+ */
+typedef struct {
+    uint32_t timestamp;         /// Microseconds of the run time stats counter
+    uint8_t type;               /// The \ref uart_spi_trace_type_t
+    uint8_t arg8;
+    uint16_t arg16;
+} uart_spi_trace_event_t;
+
+/**
+ * @brief Trace dump output callback prototype
+ * 
+ * @param line The null terminated text line including the line feed
+ * @param length The line length without the terminator
+ * @param ctx The user context passed to the \ref uart_spi_trace_dump
+ */
+typedef void (*uart_spi_trace_output_t)(const char *line, size_t length, void *ctx);
+
+// ============================================================================
+
+#if UART_SPI_TRACE
+
+/**
+ * @brief Record the event
+ * 
+ * Can be called from any context
+ */
+void uart_spi_trace_event(uint8_t type, uint8_t arg8, uint16_t arg16);
+
+/**
+ * @brief Dump the trace ring as text lines
+ * 
+ * The recording is paused during the dump. The format is:
+ * 
+ *     # uart-spi trace v1
+ *     T <task number> <task name>
+ *     E <event bytes as 16 hex digits>
+ * 
+ * The events go from the oldest to the newest.
+ * Use \c tools/uart-spi-trace2json.py to convert the dump to the Chrome trace JSON
+ * 
+ * @param output The output callback called for each line
+ * @param ctx The user context passed to the callback
+ */
+void uart_spi_trace_dump(uart_spi_trace_output_t output, void *ctx);
+
+#define UART_SPI_TRACE_EVENT(type, arg8, arg16) \
+    uart_spi_trace_event((type), (uint8_t)(arg8), (uint16_t)(arg16))
+
+// FreeRTOS trace macros. Expanded inside the kernel sources
+
+#define traceTASK_SWITCHED_IN() \
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_TASK_SWITCH, pxCurrentTCB->uxTCBNumber, 0)
+
+#else
+
+#define UART_SPI_TRACE_EVENT(type, arg8, arg16)
+
+#endif /* UART_SPI_TRACE */
+
+#endif /* UART_SPI_TRACE_H_ */
@@ -5,9 +5,16 @@
  */
 
 #include "uart-spi.h"
+#include "uart-spi-trace.h"
+#include "uart-spi-capture.h"
+#include "uart-spi-mgmt.h"
+#include "uart-spi-ring.h"
+#include "uart-spi-pool.h"
+#include "uart-spi-crc.h"
+#include "uart-spi-arq.h"
+#include "uart-spi-miso.h"
 
 #include "cmsis_os.h"
-#include "stream_buffer.h"
 
 #include <assert.h>
 #include <string.h>
@@ -17,6 +24,137 @@
 
 #define CHUNK_BUFF_SIZE            128
 
+// The transfer chunk size of the tasks
+#ifdef UART_SPI_CHUNK_SIZE
+#if UART_SPI_CHUNK_SIZE < 1 || UART_SPI_CHUNK_SIZE > CHUNK_BUFF_SIZE
+#error "UART_SPI_CHUNK_SIZE must be 1 - 128"
+#endif
+#define CHUNK_SIZE                 ((size_t)UART_SPI_CHUNK_SIZE)
+#else
+#define CHUNK_SIZE                 ((size_t)tunables.chunk_size)
+#endif
+
+// Buffer arena shared by both directions. Each buffer collects the data of one direction
+#define POOL_BUFF_SIZE             CHUNK_BUFF_SIZE
+#define POOL_BUFF_COUNT            24
+
+// The buffers reserved per direction. The rest is taken by the busy direction up to its share
+#define POOL_RESERVE_BUFFS         4
+
+// Direction share limits in bytes
+#define POOL_SHARE_MIN             (POOL_RESERVE_BUFFS * POOL_BUFF_SIZE)
+#define POOL_SHARE_MAX             ((POOL_BUFF_COUNT - POOL_RESERVE_BUFFS) * POOL_BUFF_SIZE)
+
+// Descriptor queue size. Power of two not less than the number of buffers
+#define POOL_QUEUE_SIZE            32
+
+// The reception continues to the same buffer while it has at least this free space
+#define POOL_RX_SPACE_MIN          16
+
+// The number of application messages that can be queued per direction
+#define INJECT_QUEUE_LENGTH        4
+
+// Transfer deadline margin over the calculated line time.
+// Covers the DMA and interrupt latency and the tick granularity
+#define DEADLINE_MARGIN_PERCENT    25
+#define DEADLINE_MARGIN_MS         2
+
+// Number of consecutive deadline misses that triggers the peripheral recovery
+#define DEADLINE_MISSES_TO_RECOVER 3
+
+// Supervisor check period
+#define SUPERVISOR_PERIOD_MS       20
+
+// CPU load measurement window. Updated by the supervisor
+#define LOAD_WINDOW_MS             1000
+
+// Number of consecutive transfer start failures treated as the peripheral stall
+#define SUPERVISOR_START_FAILURES  16
+
+// IWDG timeout. LSI (32 kHz) divided by 32 gives 1 ms per reload count. Up to 4095
+#define IWDG_TIMEOUT_MS            500
+
+// The maximum UART transmission delay of the batching
+#define BATCH_TIMEOUT_MS           2
+
+#define POLL_PERIOD_MAX_MS         1000
+
+#define UART_BAUD_MIN              1200
+
+// The management replies are formatted on the UART task stack
+#if UART_SPI_MGMT
+#define UART_TASK_STACK_SIZE       (256 * 4)
+#else
+#define UART_TASK_STACK_SIZE       (128 * 4)
+#endif
+
+// The message CRC trailer length in hex digits
+#define CRC_TRAILER_LENGTH         8
+
+// The low power reception line idle timeout in bit times. Flushes the string tail from the FIFO
+#define UART_RX_TIMEOUT_BITS       20
+
+// UART errors that corrupt the received string
+#define UART_RX_ERRORS             (HAL_UART_ERROR_PE | HAL_UART_ERROR_FE | HAL_UART_ERROR_NE | HAL_UART_ERROR_ORE)
+
+// ============================================================================
+
+/**
+ * @brief The module lifecycle state
+ * 
+ */
+typedef enum {
+    BRIDGE_STOPPED = 0,
+    BRIDGE_RUNNING,
+    BRIDGE_DRAINING,            /// Stop requested. The tasks forward the buffered data and exit
+    BRIDGE_ABORTING,            /// Drain time is expired. The tasks exit immediately
+} bridge_state_t;
+
+/**
+ * @brief Tap view slot. One per direction
+ * 
+ */
+typedef struct {
+    uart_spi_view_t view;
+    uart_spi_buf_t *buf;        /// The viewed pool buffer reference
+    volatile bool pending;      /// The view is published and not dispatched yet
+} tap_slot_t;
+
+/**
+ * @brief Application message queued for the transmission
+ * 
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    uart_spi_release_callback_t release;    /// Called once the data is not used anymore
+    void *ctx;
+} inject_msg_t;
+
+/**
+ * @brief The bridge task progress tracked by the supervisor
+ * 
+ */
+typedef struct {
+    volatile uint32_t heartbeat;        /// Incremented by the task on each loop iteration
+    volatile uint32_t deadline;         /// The tick the ongoing transfer must be completed by. 0 - no transfer
+    volatile uint32_t start_failures;   /// Consecutive transfer start failures
+    volatile bool recover_requested;    /// Set by the supervisor. The task reinitializes its peripheral
+    uint32_t last_heartbeat;            /// The heartbeat seen by the supervisor on the previous check
+    bool recovered;                     /// The recovery was requested on the previous check
+} task_health_t;
+
+/**
+ * @brief The message CRC trailer check of the forwarded direction
+ * 
+ */
+typedef struct {
+    uint32_t crc;                       /// The CRC of the released message bytes
+    uint8_t tail[CRC_TRAILER_LENGTH];   /// The last message bytes held back. Circular
+    uint8_t tail_start;
+    uint8_t tail_length;
+} crc_check_t;
+
 // ============================================================================
 
 static void uart_task(void *arg);
@@ -25,33 +163,234 @@ static void spi_task(void *arg);
 static int uart_rx_start(void);
 static int uart_tx_async(const void *data, size_t length);
 static int uart_wait_tx_ready(uint32_t timeout_ms);
+static void uart_tx_finish(size_t length);
+static void uart_callbacks_register(void);
+static void uart_recover(void);
+static int uart_reinit(void);
+static int uart_link_init(void);
+static bool uart_bus_granted(void);
+static int uart_low_power_init(void);
+static int uart_rx_fifo_start(void);
+static void uart_rx_fifo_isr(UART_HandleTypeDef *handle);
+static void uart_line_transmit(void);
+static void uart_line_receive(void);
+static void uart_reconfigure(void);
+static uint32_t uart_byte_rate_get(void);
 static void uart_tx_abort(void);
-static void uart_tx_complete_callback(UART_HandleTypeDef *huart);
-static void uart_rx_complete_callback(UART_HandleTypeDef *huart);
-static void uart_error_callback(UART_HandleTypeDef *huart);
+static void uart_tx_complete_callback(UART_HandleTypeDef *handle);
+static void uart_rx_complete_callback(UART_HandleTypeDef *handle);
+static void uart_error_callback(UART_HandleTypeDef *handle);
+static void uart_errors_account(uint32_t errors);
+static void uart_rx_forward(uint8_t byte, bool corrupted);
+static void uart_rx_message(const void *data, size_t length);
+static bool arq_rx(uint8_t byte, bool corrupted);
+static void uart_arq_forward(uart_spi_buf_t **tx_buf, bool *message_transmitting);
+static bool uart_arq_transmit(uint32_t now);
+static void uart_arq_send(const void *data, size_t length);
+#if UART_SPI_MGMT
+static bool mgmt_rx(uint8_t byte, bool corrupted);
+static void mgmt_output(const char *line, size_t length, void *ctx);
+#endif
 
 static int spi_tx_rx(const void *txd, void *rxd, size_t length);
 static int spi_wait_ready(uint32_t timeout_ms);
+static void spi_tx_rx_finish(size_t length);
+static void spi_callbacks_register(void);
+static void spi_recover(void);
+static int spi_reinit(void);
+static void spi_reconfigure(void);
+static uint32_t spi_prescaler_get(void);
+static uint32_t spi_byte_rate_get(void);
 static void spi_abort(void);
-static void spi_tx_rx_complete_callback(SPI_HandleTypeDef *hspi);
-static void spi_error_callback(SPI_HandleTypeDef *hspi);
+static void spi_tx_rx_complete_callback(SPI_HandleTypeDef *handle);
+static void spi_error_callback(SPI_HandleTypeDef *handle);
+
+static uint32_t transfer_deadline_ms(size_t length, uint32_t byte_rate);
+
+static void crc_check_reset(crc_check_t *check);
+static size_t crc_check_byte(crc_check_t *check, uart_spi_dir_t dir, uint8_t byte, uint8_t *out);
+static void crc_trailer_write(const void *data, size_t length, char *out);
+static size_t crc_trailers_copy(uint8_t *out, const uint8_t *data, size_t length);
+
+static void tap_publish(uart_spi_dir_t dir, const void *data, size_t length, uart_spi_buf_t *buf);
+static void hist_account(uart_spi_dir_t dir, size_t length);
+
+static int inject_copy(uart_spi_dir_t dir, const void *data, size_t length, uint32_t timeout_ms);
+static int inject_enqueue(uart_spi_dir_t dir, const void *data, size_t length,
+                          uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms);
+static int inject_zc(uart_spi_dir_t dir, const void *data, size_t length,
+                     uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms);
+static void inject_release(inject_msg_t *msg);
+static void inject_free(const void *data, void *ctx);
+static int uart_inject_transmit(void);
+static void inject_flush(void);
+
+static void ring_wait(uart_spi_ring_t *ring, size_t level, TickType_t ticks);
+static void uart_rx_append(const void *data, size_t length);
+static uart_spi_buf_t *uart_rx_take(void);
+static bool uart_rx_pending(void);
+static void spi_rx_queue_wakeup(void *ctx);
+static void spi_rx_handoff(uart_spi_buf_t *buf, size_t length);
+static uart_spi_buf_t *pool_buf_consume(uart_spi_buf_t *buf, size_t length);
+static void pool_queue_flush(uart_spi_ring_t *queue);
+static void pool_quota_apply(void);
+
+static void uart_task_kick(void);
+static void uart_task_kick_from_isr(void);
+static void spi_task_kick_from_isr(void);
+static bool uart_task_may_exit(bool message_transmitting, bool forwarding);
+static bool spi_task_may_exit(bool message_transmitting, bool injecting, bool forwarding);
+
+static void supervisor_task(void *arg);
+static bool supervisor_task_stalled(task_health_t *health, bool work_pending);
+static void supervisor_escalate(void);
+#if UART_SPI_SUPERVISOR_IWDG
+static void iwdg_start(void);
+static void iwdg_refresh(void);
+#endif
+
+static void load_stats_update(void);
+static uint16_t load_permille(uint32_t time, uint32_t total);
 
 // ============================================================================
 
-static UART_HandleTypeDef *huart = NULL;
-static SPI_HandleTypeDef *hspi = NULL;
+#ifdef UART_SPI_HUART
+#define uart_handle                (&UART_SPI_HUART)
+#else
+static UART_HandleTypeDef *uart_handle = NULL;
+#endif
+
+#ifdef UART_SPI_HSPI
+#define spi_handle                 (&UART_SPI_HSPI)
+#else
+static SPI_HandleTypeDef *spi_handle = NULL;
+#endif
 
 static osThreadId_t uart_task_handle = NULL;
 static osThreadId_t spi_task_handle = NULL;
 
-static StreamBufferHandle_t uart_rx_stream = NULL;
-static StreamBufferHandle_t spi_rx_stream = NULL;
+// Both directions data is received to the pool buffers. The buffers are passed
+// to the transmitting task through the descriptor queue by their indexes.
+// The pool survives the restarts: the tap observer may hold a buffer after the stop
+static uart_spi_pool_t pool;
+static uart_spi_buf_t pool_descs[POOL_BUFF_COUNT];
+static uint8_t pool_mem[POOL_BUFF_COUNT][POOL_BUFF_SIZE];
+
+// The buffer filled by the UART RX interrupt. Taken by the SPI task with the interrupts masked
+static uart_spi_buf_t *volatile uart_rx_buf = NULL;
+
+// The UART data is dropped since the pool exhaustion. The exhaustion is counted once per episode
+static bool uart_rx_pool_waiting = false;
+
+// Filled by the UART RX interrupt and emptied by the SPI task
+static uart_spi_ring_t uart_rx_queue;
+static uint8_t uart_rx_queue_mem[POOL_QUEUE_SIZE];
+
+// Filled by the SPI task and emptied by the UART task
+static uart_spi_ring_t spi_rx_queue;
+static uint8_t spi_rx_queue_mem[POOL_QUEUE_SIZE];
 
 static osSemaphoreId_t uart_tx_sema = NULL;
 static osSemaphoreId_t spi_tx_rx_sema = NULL;
 
 static uint8_t uart_rx_byte;
 
+// The rest of the corrupted string is being discarded
+static bool uart_rx_discarding = false;
+
+// The CRC trailer check of the received string. Accessed by the UART RX interrupt only
+static crc_check_t uart_rx_crc;
+
+// The ARQ sender. Allocated on the heap in the reliable mode only
+static uart_spi_arq_t *arq = NULL;
+
+// The acknowledgement reception. Accessed by the UART RX interrupt only
+static bool arq_rx_string_start = true;     // The next received byte starts a new string
+static bool arq_ack_receiving;              // The acknowledgement is being received
+static bool arq_ack_valid;                  // The acknowledgement has no errors so far
+static size_t arq_ack_length;
+static char arq_ack_text[UART_SPI_ARQ_ACK_LENGTH];
+
+// The last acknowledgement passed to the UART task
+static volatile uint8_t arq_ack_next;
+static volatile uint32_t arq_ack_sack;
+static volatile bool arq_ack_ready = false;
+
+// Line rates in bytes per second. Used for the transfer deadlines
+static uint32_t uart_byte_rate;
+static uint32_t spi_byte_rate;
+
+// Consecutive deadline misses
+static uint32_t uart_deadline_misses;
+static uint32_t spi_deadline_misses;
+
+static osSemaphoreId_t tap_sema = NULL;
+static uart_spi_tap_callback_t tap_callback = NULL;
+static void *tap_ctx = NULL;
+static tap_slot_t tap_slots[UART_SPI_DIR_COUNT];
+
+// Application messages queues. Indexed by the direction the messages join
+static osMessageQueueId_t inject_queues[UART_SPI_DIR_COUNT];
+
+static uart_spi_stats_t stats;
+
+static uart_spi_tunables_t tunables = {
+    .uart_baud = 0,
+    .spi_prescaler = 0,
+    .buffer_size = POOL_SHARE_MAX,
+#ifdef UART_SPI_CHUNK_SIZE
+    .chunk_size = UART_SPI_CHUNK_SIZE,
+#else
+    .chunk_size = CHUNK_BUFF_SIZE,
+#endif
+    .batch_size = 1,
+    .poll_period_ms = 0
+};
+
+// The new UART baud rate is waiting for the UART task
+static volatile bool uart_reconfig_pending = false;
+
+// The new SPI prescaler is waiting for the SPI task
+static volatile bool spi_reconfig_pending = false;
+
+#if UART_SPI_MGMT
+// Management command reception state. Accessed by the UART RX interrupt only
+static bool uart_rx_string_start = true;    // The next received byte starts a new string
+static size_t mgmt_prefix_matched;          // The number of the prefix bytes held back
+static bool mgmt_receiving;                 // The command is being received
+static bool mgmt_command_valid;             // The command fits the buffer and has no errors
+static size_t mgmt_command_length;
+static char mgmt_command[UART_SPI_MGMT_COMMAND_SIZE];
+
+// The command is received. Cleared by the UART task once the command is executed
+static volatile bool mgmt_command_ready = false;
+#endif
+
+static uart_spi_params_t bridge_params;
+static volatile bridge_state_t bridge_state = BRIDGE_STOPPED;
+
+// The tasks clear the flags right before exit
+static volatile bool uart_task_running = false;
+static volatile bool spi_task_running = false;
+
+static osThreadId_t supervisor_task_handle = NULL;
+static task_health_t uart_health;
+static task_health_t spi_health;
+
+// The supervisor failed to recover the module. Waiting for the watchdog reset
+static volatile bool supervisor_escalated = false;
+
+// Bridge interrupts run time. The interrupts have the same priority and don't nest
+static uint32_t isr_enter_time;
+static volatile uint32_t isr_run_time;
+
+// Run time counters on the previous load measurement
+static uint32_t load_update_tick;
+static uint32_t load_prev_total;
+static uint32_t load_prev_isr;
+static uint32_t load_prev_uart_task;
+static uint32_t load_prev_spi_task;
+
 // ============================================================================
 
 int uart_spi_start(uart_spi_params_t *params)
@@ -60,256 +399,2858 @@ int uart_spi_start(uart_spi_params_t *params)
     assert(params->huart);
     assert(params->hspi);
 
-    huart = params->huart;
-    hspi = params->hspi;
+    if (bridge_state != BRIDGE_STOPPED) {
+        return -1;
+    }
 
-    HAL_StatusTypeDef status;
+    if (params->link == UART_SPI_LINK_RS485 &&
+        (params->rs485_address > 0x7F || params->rs485_de_assert > 31 || params->rs485_de_deassert > 31)) {
+        return -1;
+    }
+
+    // Both the address and the match character are in CR2 ADD
+    if (params->low_power && params->link == UART_SPI_LINK_RS485 && params->rs485_address != 0) {
+        return -1;
+    }
+
+    // HSI16 can clock USART1 and USART2 only
+    if (params->low_power && params->huart->Instance != USART1 && params->huart->Instance != USART2) {
+        return -1;
+    }
+
+#ifdef UART_SPI_HUART
+    if (params->huart != uart_handle) {
+        return -1;
+    }
+#endif
+
+#ifdef UART_SPI_HSPI
+    if (params->hspi != spi_handle) {
+        return -1;
+    }
+#endif
+
+    // The send window is needed in the reliable mode only.
+    // Allocated before any state is changed, so the failed start leaves the previous configuration
+    uart_spi_arq_t *arq_new = NULL;
+
+    if (params->reliable) {
+        arq_new = pvPortMalloc(sizeof(uart_spi_arq_t));
+        if (arq_new == NULL) {
+            return -1;
+        }
+    }
+
+    bridge_params = *params;
+
+#ifndef UART_SPI_HUART
+    uart_handle = params->huart;
+#endif
+
+#ifndef UART_SPI_HSPI
+    spi_handle = params->hspi;
+#endif
+
+    uart_rx_discarding = false;
+    uart_rx_pool_waiting = false;
+    crc_check_reset(&uart_rx_crc);
+
+    arq_rx_string_start = true;
+    arq_ack_receiving = false;
+    arq_ack_ready = false;
+
+#if UART_SPI_MGMT
+    uart_rx_string_start = true;
+    mgmt_prefix_matched = 0;
+    mgmt_receiving = false;
+    mgmt_command_ready = false;
+#endif
+
+    uart_deadline_misses = 0;
+    spi_deadline_misses = 0;
 
     // ----------------------
 
-    // Register some HAL UART callbacks
+    uart_callbacks_register();
 
-    status = HAL_UART_RegisterCallback(huart, HAL_UART_TX_COMPLETE_CB_ID, uart_tx_complete_callback);
-    assert(status == HAL_OK);
+    if (bridge_params.low_power) {
+        // HSI16 keeps clocking the USART in the Stop mode. The baud rate is recalculated below
+        if (uart_handle->Instance == USART1) {
+            __HAL_RCC_USART1_CONFIG(RCC_USART1CLKSOURCE_HSI);
+        }
+        else {
+            __HAL_RCC_USART2_CONFIG(RCC_USART2CLKSOURCE_HSI);
+        }
+    }
 
-    status = HAL_UART_RegisterCallback(huart, HAL_UART_RX_COMPLETE_CB_ID, uart_rx_complete_callback);
-    assert(status == HAL_OK);
+    bool link_changed = bridge_params.link != UART_SPI_LINK_FULL_DUPLEX ||
+                        bridge_params.low_power ||
+                        READ_BIT(uart_handle->Instance->CR3, USART_CR3_DEM | USART_CR3_HDSEL) != 0 ||
+                        READ_BIT(uart_handle->Instance->CR1, USART_CR1_FIFOEN | USART_CR1_UESM) != 0;
 
-    status = HAL_UART_RegisterCallback(huart, HAL_UART_ERROR_CB_ID, uart_error_callback);
-    assert(status == HAL_OK);
+    if (tunables.uart_baud == 0) {
+        tunables.uart_baud = uart_handle->Init.BaudRate;
+    }
+
+    // Apply the line mode and the baud rate set before the start.
+    // The previous run may have left the peripheral in another line mode
+    if (link_changed || tunables.uart_baud != uart_handle->Init.BaudRate) {
+        uart_reconfigure();
+    }
+
+    tunables.uart_baud = uart_handle->Init.BaudRate;
 
-    // Create UART-to-SPI stream buffer
-    uart_rx_stream = xStreamBufferCreate(1024, 1);
-    assert(uart_rx_stream);
+    uart_byte_rate = uart_byte_rate_get();
+    assert(uart_byte_rate > 0);
 
-    // Semaphore is released at initial
-    uart_tx_sema = osSemaphoreNew(1, 1, NULL);
+    if (arq_new != NULL) {
+        arq = arq_new;
+        uart_spi_arq_init(arq, uart_byte_rate);
+    }
+
+    // Create UART-to-SPI descriptor queue. The SPI task is woken up by the interrupt directly
+    uart_spi_ring_init(&uart_rx_queue, uart_rx_queue_mem, POOL_QUEUE_SIZE);
+
+    // Semaphore is taken at initial. It is released by the transfer completion
+    uart_tx_sema = osSemaphoreNew(1, 0, NULL);
     assert(uart_tx_sema);
 
     // ----------------------
 
-    // Register some HAL SPI callbacks
+    spi_callbacks_register();
 
-    status = HAL_SPI_RegisterCallback(hspi, HAL_SPI_TX_RX_COMPLETE_CB_ID, spi_tx_rx_complete_callback);
-    assert(status == HAL_OK);
+    // Apply the prescaler set before the start
+    if (tunables.spi_prescaler != 0 && tunables.spi_prescaler != spi_prescaler_get()) {
+        spi_reconfigure();
+    }
 
-    status = HAL_SPI_RegisterCallback(hspi, HAL_SPI_ERROR_CB_ID, spi_error_callback);
-    assert(status == HAL_OK);
+    tunables.spi_prescaler = spi_prescaler_get();
 
-    // Create SPI-to-UART stream buffer
-    spi_rx_stream = xStreamBufferCreate(1024, 1);
-    assert(spi_rx_stream);
+    spi_byte_rate = spi_byte_rate_get();
+    assert(spi_byte_rate > 0);
 
-    // Semaphore is released at initial
-    spi_tx_rx_sema = osSemaphoreNew(1, 1, NULL);
+    // Create SPI-to-UART descriptor queue
+    uart_spi_ring_init(&spi_rx_queue, spi_rx_queue_mem, POOL_QUEUE_SIZE);
+    uart_spi_ring_hook_set(&spi_rx_queue, spi_rx_queue_wakeup, NULL);
+
+    // Semaphore is taken at initial. It is released by the transfer completion
+    spi_tx_rx_sema = osSemaphoreNew(1, 0, NULL);
     assert(spi_tx_rx_sema);
 
     // ----------------------
 
+    // The application API objects are created once and survive the restarts,
+    // so the application tasks never wait on the deleted objects
+
+    // Create application messages queues
+
+    for (int dir = 0; dir < UART_SPI_DIR_COUNT; dir++) {
+        if (inject_queues[dir] == NULL) {
+            inject_queues[dir] = osMessageQueueNew(INJECT_QUEUE_LENGTH, sizeof(inject_msg_t), NULL);
+            assert(inject_queues[dir]);
+        }
+    }
+
+#if UART_SPI_TAP
+    // Tap semaphore counts the published views. One per direction at most.
+    // Without the semaphore the tap API returns the error
+    if (tap_sema == NULL) {
+        tap_sema = osSemaphoreNew(UART_SPI_DIR_COUNT, 0, NULL);
+        assert(tap_sema);
+    }
+#endif
+
+    if (pool.descs == NULL) {
+        uart_spi_pool_init(&pool, pool_descs, pool_mem, POOL_BUFF_COUNT, POOL_BUFF_SIZE);
+        pool_quota_apply();
+    }
+
+    // ----------------------
+
+    uart_health.start_failures = 0;
+    uart_health.deadline = 0;
+    uart_health.recover_requested = false;
+    uart_health.recovered = false;
+
+    spi_health.start_failures = 0;
+    spi_health.deadline = 0;
+    spi_health.recover_requested = false;
+    spi_health.recovered = false;
+
+    // The watchdog can't be stopped, so the supervisor keeps running after the module stop
+    if (supervisor_task_handle == NULL) {
+        stats.watchdog_reset = __HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST);
+
+        const osThreadAttr_t supervisor_task_attributes = {
+            .name = "uart-spi-sv",
+            .priority = osPriorityHigh,
+            .stack_size = 128 * 4
+        };
+
+        supervisor_task_handle = osThreadNew(supervisor_task, NULL, &supervisor_task_attributes);
+        assert(supervisor_task_handle);
+    }
+
+    // ----------------------
+
     // Create UART and SPI tasks
 
-    uart_task_handle = osThreadNew(uart_task, NULL, NULL);
+    // The new tasks run time is counted from zero
+    load_prev_uart_task = 0;
+    load_prev_spi_task = 0;
+
+    uart_task_running = true;
+    spi_task_running = true;
+
+    const osThreadAttr_t uart_task_attributes = {
+        .stack_size = UART_TASK_STACK_SIZE
+    };
+
+    // The tasks start running once both handles are assigned. The interrupts
+    // and the kicks skip the notification until then (see uart_task_kick)
+    vTaskSuspendAll();
+
+    bridge_state = BRIDGE_RUNNING;
+
+    uart_task_handle = osThreadNew(uart_task, NULL, &uart_task_attributes);
     assert(uart_task_handle);
 
     spi_task_handle = osThreadNew(spi_task, NULL, NULL);
     assert(spi_task_handle);
 
+    xTaskResumeAll();
+
     return 0;
 }
 
-// ============================================================================
-
-/**
- * @brief UART communication task
- * 
- * The main logic.
- * 
- * The task waits for data from the SPI interface using the SPI-to-UART stream buffer.
- * Once the data has been read from the stream buffer,
- * it is asynchronously transmitted to the UART.
- * Data is transmitted to the UART in blocks of @ref CHUNK_BUFF_SIZE bytes or less
- * 
- * UART data reception is performed in byte-by-byte interrupt.
- * Each byte is sent to the ART-to-SPI stream
- * 
- * @param arg Arguments. Unused
- */
-static void uart_task(void *arg)
+int uart_spi_stop(uint32_t drain_timeout_ms)
 {
-    UNUSED(arg);
+    if (bridge_state != BRIDGE_RUNNING) {
+        return -1;
+    }
 
-    static char chunk_buff[CHUNK_BUFF_SIZE];
+    // No more new data from the UART. Forward the buffered data only
+    HAL_UART_AbortReceive(uart_handle);
 
-    uart_rx_start();
+    // Not disabled by the HAL
+    ATOMIC_CLEAR_BIT(uart_handle->Instance->CR1, USART_CR1_CMIE | USART_CR1_RTOIE);
 
-    while (1) {
-        // Continuously wait and receive data from the SPI-to-UART stream. Up to CHUNK_BUFF_SIZE bytes
-        size_t length = xStreamBufferReceive(spi_rx_stream, chunk_buff, CHUNK_BUFF_SIZE, portMAX_DELAY);
-        if (length > 0) {
-            if (uart_tx_async(chunk_buff, length) != 0) {
-                // Error. Just continue;
-                continue;
-            }
+    bridge_state = BRIDGE_DRAINING;
+    uart_task_kick();
 
-            if (uart_wait_tx_ready(100) != 0) {
-                // Abort ongoing transmitting in case of timeout
-                uart_tx_abort();
-            }
+    uint32_t start = osKernelGetTickCount();
+
+    // Each task wait is limited, so the tasks exit in bounded time after the aborting
+    while (uart_task_running || spi_task_running) {
+        if (bridge_state == BRIDGE_DRAINING &&
+            osKernelGetTickCount() - start >= pdMS_TO_TICKS(drain_timeout_ms)) {
+            bridge_state = BRIDGE_ABORTING;
+            uart_task_kick();
         }
+
+        osDelay(1);
     }
-}
 
-/**
- * @brief SPI communication task
- * 
- * The main logic.
- * 
- * The task continuously executes SPI transactions and checks if the slave has data.
- * Reception and transmission are performed simultaneously.
- * 
- * Any slave data that is not zero is sent to the SPI-to-UART stream.
- * The string termination indicator '\0' is also sent to the stream.
- * 
- * Data is transmitted to the SPI in blocks of @ref CHUNK_BUFF_SIZE bytes or less
- * 
- * @param arg Arguments. Unused
- */
-static void spi_task(void *arg)
-{
-    UNUSED(arg);
+    // Bring the peripherals to the ready state
+    // even if the asynchronous aborting has not been completed yet
+    HAL_UART_Abort(uart_handle);
+    HAL_SPI_Abort(spi_handle);
 
-    static char chunk_buff_tx[CHUNK_BUFF_SIZE];
-    static char chunk_buff_rx[CHUNK_BUFF_SIZE];
+    // Give back the application messages that have not been transmitted
+    inject_flush();
 
-    bool message_receiving = false;
+    // Give back the buffers that have not been transmitted
+    pool_queue_flush(&uart_rx_queue);
+    pool_queue_flush(&spi_rx_queue);
 
-    while (1) {
-        // Receive the UART-to-SPI stream data if it is exist
-        size_t length = xStreamBufferReceive(uart_rx_stream, chunk_buff_tx, CHUNK_BUFF_SIZE, 0);
-        if (length == 0) {
-            // If no data in the stream then fill chunk_buff by zero
-            // for following transmittion to the SPI
+    if (uart_rx_buf) {
+        uart_spi_buf_unref(&pool, uart_rx_buf);
+        uart_rx_buf = NULL;
+    }
 
-            length = CHUNK_BUFF_SIZE;
-            memset(chunk_buff_tx, 0, length);
-        }
+    // The frames not acknowledged are lost
+    if (arq) {
+        vPortFree(arq);
+        arq = NULL;
+    }
 
-        if (spi_tx_rx(chunk_buff_tx, chunk_buff_rx, length) != 0) {
-            // Error. Just continue;
-            continue;
-        }
+    // The tasks memory is freed by the idle task.
+    // The rest of the per-run objects are deleted here
 
-        if (spi_wait_ready(100) != 0) {
-            // Abort ongoing transaction in case of timeout
-            spi_abort();
-        }
+    osSemaphoreDelete(uart_tx_sema);
+    uart_tx_sema = NULL;
 
-        
-        // Iterate the UART-to-SPI stream data to find the not-zero data
-        for (int q = 0; q < length; q++) {
-            if (chunk_buff_rx[q] != '\0') {
-                if (!message_receiving) {
-                    // Start message receiving
-                    message_receiving = true;
-                }
+    osSemaphoreDelete(spi_tx_rx_sema);
+    spi_tx_rx_sema = NULL;
 
-                xStreamBufferSend(spi_rx_stream, &chunk_buff_rx[q], 1, 0);
-            }
-            else {
-                if (message_receiving) {
-                    // NULL terminated string received
-                    message_receiving = false;
+    uart_task_handle = NULL;
+    spi_task_handle = NULL;
 
-                    // Send '\0' 
-                    xStreamBufferSend(spi_rx_stream, &chunk_buff_rx[q], 1, 0);
-                }
-            }
+    bridge_state = BRIDGE_STOPPED;
+
+    return 0;
+}
+
+int uart_spi_drain(uint32_t timeout_ms)
+{
+    if (bridge_state != BRIDGE_RUNNING) {
+        return -1;
+    }
+
+    uint32_t start = osKernelGetTickCount();
+
+    while (uart_rx_pending() ||
+           uart_spi_ring_used(&spi_rx_queue) > 0 ||
+           (arq && uart_spi_arq_in_flight(arq) > 0) ||
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_UART_TO_SPI]) > 0 ||
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_SPI_TO_UART]) > 0) {
+
+        if (osKernelGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return -1;
         }
+
+        osDelay(1);
     }
-}
 
-// ----------------------------------------------------------------------------
+    return 0;
+}
 
-static int uart_rx_start(void)
+bool uart_spi_idle(void)
 {
-    HAL_StatusTypeDef status = HAL_UART_Receive_IT(huart, &uart_rx_byte, 1);
+    if (bridge_state != BRIDGE_RUNNING) {
+        return bridge_state == BRIDGE_STOPPED;
+    }
 
-    return status == HAL_OK ? 0 : -1;
+    return !uart_rx_pending() &&
+           uart_spi_ring_used(&spi_rx_queue) == 0 &&
+           uart_health.deadline == 0 &&
+           spi_health.deadline == 0 &&
+           (arq == NULL || uart_spi_arq_in_flight(arq) == 0) &&
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_UART_TO_SPI]) == 0 &&
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_SPI_TO_UART]) == 0;
 }
 
-static int uart_tx_async(const void *data, size_t length)
+int uart_spi_restart(uint32_t drain_timeout_ms)
 {
-    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(huart, data, length);
+    if (bridge_state == BRIDGE_RUNNING && uart_spi_stop(drain_timeout_ms) != 0) {
+        return -1;
+    }
 
-    return status == HAL_OK ? 0 : -1;
+    if (bridge_params.huart == NULL) {
+        // Never started
+        return -1;
+    }
+
+    uart_spi_params_t params = bridge_params;
+
+    return uart_spi_start(&params);
 }
 
-static int uart_wait_tx_ready(uint32_t timeout_ms)
+int uart_spi_tap_register(uart_spi_tap_callback_t callback, void *ctx)
 {
-    osStatus_t status = osSemaphoreAcquire(uart_tx_sema, pdMS_TO_TICKS(timeout_ms));
+    if (tap_sema == NULL) {
+        // The module is not started
+        return -1;
+    }
 
-    return status == osOK ? 0 : -1;
+    tap_callback = NULL;
+    __DMB();
+
+    tap_ctx = ctx;
+    __DMB();
+
+    tap_callback = callback;
+
+    return 0;
 }
 
-static void uart_tx_abort(void)
+bool uart_spi_tap_registered(void)
 {
-    HAL_UART_AbortTransmit_IT(huart);
+    return tap_sema != NULL && tap_callback != NULL;
 }
 
-static void uart_tx_complete_callback(UART_HandleTypeDef *huart)
+int uart_spi_tap_dispatch(uint32_t timeout_ms)
 {
-    UNUSED(huart);
+    if (tap_sema == NULL) {
+        return -1;
+    }
 
-    osSemaphoreRelease(uart_tx_sema);
-}
+    if (osSemaphoreAcquire(tap_sema, pdMS_TO_TICKS(timeout_ms)) != osOK) {
+        return -1;
+    }
 
-static void uart_rx_complete_callback(UART_HandleTypeDef *huart)
-{
-    UNUSED(huart);
+    uart_spi_tap_callback_t callback = tap_callback;
 
-    xStreamBufferSend(uart_rx_stream, &uart_rx_byte, 1, 0);
+    for (int dir = 0; dir < UART_SPI_DIR_COUNT; dir++) {
+        tap_slot_t *slot = &tap_slots[dir];
 
-    uart_rx_start();
+        if (slot->pending) {
+            if (callback) {
+                callback(&slot->view, tap_ctx);
+            }
+
+            if (slot->buf) {
+                uart_spi_buf_unref(&pool, slot->buf);
+                slot->buf = NULL;
+            }
+
+            // Unpin the buffer only after the observer has finished with it
+            __DMB();
+            slot->pending = false;
+        }
+    }
+
+    return 0;
 }
 
-static void uart_error_callback(UART_HandleTypeDef *huart)
+int uart_spi_send_to_uart(const void *data, size_t length, uint32_t timeout_ms)
 {
-    UNUSED(huart);
+    return inject_copy(UART_SPI_DIR_SPI_TO_UART, data, length, timeout_ms);
+}
 
-    osSemaphoreRelease(uart_tx_sema);
+int uart_spi_send_to_spi(const void *data, size_t length, uint32_t timeout_ms)
+{
+    return inject_copy(UART_SPI_DIR_UART_TO_SPI, data, length, timeout_ms);
 }
 
-// ----------------------------------------------------------------------------
+int uart_spi_send_to_uart_zc(const void *data, size_t length,
+                             uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms)
+{
+    return inject_zc(UART_SPI_DIR_SPI_TO_UART, data, length, release, ctx, timeout_ms);
+}
 
-static int spi_tx_rx(const void *txd, void *rxd, size_t length)
+int uart_spi_send_to_spi_zc(const void *data, size_t length,
+                            uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms)
 {
-    HAL_StatusTypeDef status = HAL_SPI_TransmitReceive_DMA(hspi, (void *)txd, rxd, length);
+    return inject_zc(UART_SPI_DIR_UART_TO_SPI, data, length, release, ctx, timeout_ms);
+}
 
-    return status == HAL_OK ? 0 : -1;
+void uart_spi_get_stats(uart_spi_stats_t *stats_out)
+{
+    assert(stats_out);
+
+    *stats_out = stats;
+
+    // The shared statistics are written by the bridge tasks only
+    stats_out->pool_free_min = uart_spi_pool_free_min(&pool);
 }
 
-static int spi_wait_ready(uint32_t timeout_ms)
+void uart_spi_tunables_get(uart_spi_tunables_t *tunables_out)
 {
-    osStatus_t status = osSemaphoreAcquire(spi_tx_rx_sema, pdMS_TO_TICKS(timeout_ms));
+    assert(tunables_out);
 
-    return status == osOK ? 0 : -1;
+    *tunables_out = tunables;
 }
 
-static void spi_abort(void)
+int uart_spi_tunables_set(const uart_spi_tunables_t *tunables_in)
 {
-    HAL_SPI_Abort_IT(hspi);
+    assert(tunables_in);
+
+    if (tunables_in->chunk_size == 0 || tunables_in->chunk_size > CHUNK_BUFF_SIZE ||
+        tunables_in->batch_size == 0 || tunables_in->batch_size > CHUNK_BUFF_SIZE ||
+        tunables_in->poll_period_ms > POLL_PERIOD_MAX_MS ||
+        (tunables_in->uart_baud != 0 && tunables_in->uart_baud < UART_BAUD_MIN) ||
+        tunables_in->buffer_size < POOL_SHARE_MIN || tunables_in->buffer_size > POOL_SHARE_MAX ||
+        tunables_in->buffer_size % POOL_BUFF_SIZE != 0) {
+        return -1;
+    }
+
+#ifdef UART_SPI_CHUNK_SIZE
+    if (tunables_in->chunk_size != UART_SPI_CHUNK_SIZE) {
+        return -1;
+    }
+#endif
+
+    uint32_t prescaler = tunables_in->spi_prescaler;
+    if (prescaler != 0 && (prescaler < 2 || prescaler > 256 || (prescaler & (prescaler - 1)) != 0)) {
+        return -1;
+    }
+
+    // The tasks read each value once per iteration
+    tunables.buffer_size = tunables_in->buffer_size;
+    tunables.chunk_size = tunables_in->chunk_size;
+    tunables.batch_size = tunables_in->batch_size;
+    tunables.poll_period_ms = tunables_in->poll_period_ms;
+
+    if (pool.descs != NULL) {
+        pool_quota_apply();
+    }
+
+    if (tunables_in->uart_baud != 0 && tunables_in->uart_baud != tunables.uart_baud) {
+        tunables.uart_baud = tunables_in->uart_baud;
+
+        if (bridge_state == BRIDGE_RUNNING) {
+            uart_reconfig_pending = true;
+            uart_task_kick();
+        }
+    }
+
+    if (prescaler != 0 && prescaler != tunables.spi_prescaler) {
+        tunables.spi_prescaler = prescaler;
+
+        if (bridge_state == BRIDGE_RUNNING) {
+            spi_reconfig_pending = true;
+        }
+    }
+
+    return 0;
 }
 
-static void spi_tx_rx_complete_callback(SPI_HandleTypeDef *hspi)
+void uart_spi_isr_enter(void)
 {
-    UNUSED(hspi);
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_ISR_ENTER, __get_IPSR(), 0);
 
-    osSemaphoreRelease(spi_tx_rx_sema);
+    isr_enter_time = portGET_RUN_TIME_COUNTER_VALUE();
 }
 
-static void spi_error_callback(SPI_HandleTypeDef *hspi)
+void uart_spi_isr_exit(void)
 {
-    UNUSED(hspi);
+    isr_run_time += portGET_RUN_TIME_COUNTER_VALUE() - isr_enter_time;
 
-    osSemaphoreRelease(spi_tx_rx_sema);
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_ISR_EXIT, __get_IPSR(), 0);
+}
+
+// ============================================================================
+
+/**
+ * @brief UART communication task
+ * 
+ * The main logic.
+ * 
+ * The task waits for the SPI-to-UART pool buffers passed through the descriptor queue.
+ * The data is asynchronously transmitted to the UART by DMA directly from the buffer.
+ * Data is transmitted to the UART in blocks of @ref CHUNK_BUFF_SIZE bytes or less
+ * 
+ * UART data reception is performed in byte-by-byte interrupt.
+ * Each byte is sent to the UART-to-SPI ring
+ * 
+ * Each transmitted chunk is published to the tap observer if any.
+ * The observer shares the buffer by the reference, the data is not copied.
+ * 
+ * In the reliable mode the data is copied to the ARQ frames instead and
+ * transmitted from the send window (see @ref uart_arq_forward)
+ * 
+ * The application messages and the management replies are transmitted
+ * only between the forwarded strings. In the reliable mode they are framed
+ * by the ARQ as well
+ * 
+ * @param arg Arguments. Unused
+ */
+static void uart_task(void *arg)
+{
+    UNUSED(arg);
+
+    // The pool buffer being transmitted
+    uart_spi_buf_t *tx_buf = NULL;
+
+    // The forwarded string is transmitted partially. Application messages must wait for its end
+    bool message_transmitting = false;
+
+    uart_rx_start();
+
+    while (1) {
+        uart_health.heartbeat++;
+
+        if (uart_health.recover_requested) {
+            // The supervisor found the task stalled. No transfer is ongoing here
+            uart_health.recover_requested = false;
+            uart_recover();
+        }
+
+        bool forwarding = tx_buf != NULL || (arq && uart_spi_arq_in_flight(arq) > 0);
+
+        if (bridge_state != BRIDGE_RUNNING && uart_task_may_exit(message_transmitting, forwarding)) {
+            break;
+        }
+
+#if UART_SPI_MGMT
+        if (!message_transmitting && mgmt_command_ready) {
+            uart_spi_mgmt_execute(mgmt_command, mgmt_output, NULL);
+            mgmt_command_ready = false;
+            continue;
+        }
+#endif
+
+        if (!message_transmitting && uart_reconfig_pending) {
+            uart_reconfigure();
+            continue;
+        }
+
+        if (!message_transmitting && uart_inject_transmit() == 0) {
+            // Application message is transmitted. Check for the next one
+            continue;
+        }
+
+        if (!uart_bus_granted()) {
+            // Wait for the poll. The address match wakes the task up
+            xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(SUPERVISOR_PERIOD_MS / 2));
+            continue;
+        }
+
+        if (arq) {
+            uart_arq_forward(&tx_buf, &message_transmitting);
+            continue;
+        }
+
+        if (tx_buf == NULL) {
+            uint8_t index;
+
+            if (uart_spi_ring_read(&spi_rx_queue, &index, 1) == 0) {
+                // Continuously wait for the SPI-to-UART buffers.
+                // The wait is also interrupted by the application message enqueuing
+                ring_wait(&spi_rx_queue, 1, portMAX_DELAY);
+                continue;
+            }
+
+            tx_buf = uart_spi_pool_get(&pool, index);
+
+            UART_SPI_TRACE_EVENT(UART_SPI_TRACE_STREAM_RECEIVE, UART_SPI_DIR_SPI_TO_UART, tx_buf->length);
+        }
+
+        // Up to the chunk size
+        const char *data = (const char *)uart_spi_buf_data(tx_buf);
+        size_t length = tx_buf->length;
+        if (length > CHUNK_SIZE) {
+            length = CHUNK_SIZE;
+        }
+
+        message_transmitting = data[length - 1] != '\0';
+
+        hist_account(UART_SPI_DIR_SPI_TO_UART, length);
+
+        if (uart_tx_async(data, length) == 0) {
+            // The observer works with the buffer while it is transmitted
+            tap_publish(UART_SPI_DIR_SPI_TO_UART, data, length, tx_buf);
+
+            uart_tx_finish(length);
+        }
+
+        tx_buf = pool_buf_consume(tx_buf, length);
+    }
+
+    if (tx_buf) {
+        // Aborted in the middle of the buffer
+        uart_spi_buf_unref(&pool, tx_buf);
+    }
+
+    uart_task_running = false;
+    osThreadExit();
+}
+
+/**
+ * @brief SPI communication task
+ * 
+ * The main logic.
+ * 
+ * The task continuously executes SPI transactions and checks if the slave has data.
+ * Reception and transmission are performed simultaneously.
+ * 
+ * The slave data is received by DMA directly to the pool buffer. Any data that
+ * is not zero is kept in the buffer, the string termination indicator '\0' too.
+ * The buffer collects several transactions and is passed to the UART task once
+ * the slave pauses or the buffer is nearly full.
+ * 
+ * Data is transmitted to the SPI in blocks of @ref CHUNK_BUFF_SIZE bytes or less
+ * by DMA directly from the UART-to-SPI pool buffers
+ * 
+ * Each transmitted UART data chunk is published to the tap observer if any.
+ * The observer shares the buffer by the reference, the data is not copied.
+ * 
+ * The application messages are transmitted only between the forwarded strings.
+ * They are transmitted directly from the application buffers.
+ * 
+ * @param arg Arguments. Unused
+ */
+static void spi_task(void *arg)
+{
+    UNUSED(arg);
+
+    // Transmitted to poll the slave. Never written
+    static char chunk_buff_zero[CHUNK_BUFF_SIZE];
+
+    uart_spi_miso_t miso;
+    uart_spi_miso_reset(&miso);
+
+    // The CRC trailer check of the received string
+    crc_check_t rx_crc;
+    crc_check_reset(&rx_crc);
+
+    // The CRC check holds back up to the trailer length. The compacted data
+    // is written behind the received one, so the reception is shifted by the trailer length
+    bool crc_checking = bridge_params.crc_mode != UART_SPI_CRC_OFF;
+    size_t rx_shift = crc_checking ? CRC_TRAILER_LENGTH : 0;
+
+    // The forwarded string is transmitted partially. Application messages must wait for its end
+    bool message_transmitting = false;
+
+    // The application message being transmitted
+    inject_msg_t inject;
+    size_t inject_offset = 0;
+    bool injecting = false;
+
+    // Nothing was transferred in either direction on the previous transaction
+    bool link_idle = false;
+
+    // The UART data pool buffer being transmitted
+    uart_spi_buf_t *tx_buf = NULL;
+
+    // The pool buffer the slave data is received to
+    uart_spi_buf_t *rx_buf = NULL;
+    size_t rx_fill = 0;
+    uint32_t rx_first_tick = 0;
+
+    // The pool exhaustion is counted once per wait
+    bool pool_waiting = false;
+
+    while (1) {
+        const char *chunk_tx;
+        size_t length;
+        bool forwarding = false;
+
+        spi_health.heartbeat++;
+
+        if (spi_health.recover_requested) {
+            // The supervisor found the task stalled. No transaction is ongoing here
+            spi_health.recover_requested = false;
+            spi_recover();
+        }
+
+        if (bridge_state != BRIDGE_RUNNING && spi_task_may_exit(message_transmitting, injecting, tx_buf != NULL)) {
+            break;
+        }
+
+        if (!injecting && !message_transmitting && spi_reconfig_pending) {
+            spi_reconfigure();
+            continue;
+        }
+
+        if (rx_buf == NULL) {
+            rx_buf = uart_spi_pool_alloc(&pool, UART_SPI_DIR_SPI_TO_UART, UART_SPI_BUF_SPI_RX);
+            rx_fill = 0;
+
+            if (rx_buf == NULL) {
+                // All the buffers are queued to the UART or viewed by the tap observer.
+                // The slave is not polled until the UART catches up
+                if (!pool_waiting) {
+                    stats.pool_exhausted++;
+                    pool_waiting = true;
+                }
+
+                osDelay(1);
+                continue;
+            }
+
+            pool_waiting = false;
+        }
+
+        if (!injecting && !message_transmitting) {
+            injecting = osMessageQueueGet(inject_queues[UART_SPI_DIR_UART_TO_SPI], &inject, NULL, 0) == osOK;
+            inject_offset = 0;
+        }
+
+        // The transaction fits the rest of the reception buffer
+        size_t chunk_size = CHUNK_SIZE;
+        if (chunk_size > POOL_BUFF_SIZE - rx_fill - rx_shift) {
+            chunk_size = POOL_BUFF_SIZE - rx_fill - rx_shift;
+        }
+
+        if (injecting) {
+            // Transmit the application message directly from its buffer
+            chunk_tx = (const char *)inject.data + inject_offset;
+            length = inject.length - inject_offset;
+            if (length > chunk_size) {
+                length = chunk_size;
+            }
+        }
+        else {
+            // While the link is idle, the slave is polled once per poll period
+            // unless the UART data comes earlier. The collected slave data is not held back
+            uint32_t poll_period_ms = link_idle && rx_fill == 0 ? tunables.poll_period_ms : 0;
+            if (poll_period_ms > 0 && tx_buf == NULL && !uart_rx_pending()) {
+                // Let the supervisor know the task waits legitimately
+                spi_health.deadline = (osKernelGetTickCount() + pdMS_TO_TICKS(poll_period_ms)) | 1;
+
+                // The UART RX interrupt notifies the task on each new buffer
+                xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(poll_period_ms));
+
+                spi_health.deadline = 0;
+            }
+
+            // Transmit the UART data if it is exist
+            if (tx_buf == NULL) {
+                tx_buf = uart_rx_take();
+
+                if (tx_buf) {
+                    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_STREAM_RECEIVE, UART_SPI_DIR_UART_TO_SPI, tx_buf->length);
+                }
+            }
+
+            forwarding = tx_buf != NULL;
+            if (!forwarding) {
+                // If no UART data then transmit zeros to poll the slave
+                chunk_tx = chunk_buff_zero;
+                length = chunk_size;
+            }
+            else {
+                chunk_tx = (const char *)uart_spi_buf_data(tx_buf);
+                length = tx_buf->length;
+                if (length > chunk_size) {
+                    length = chunk_size;
+                }
+
+                message_transmitting = chunk_tx[length - 1] != '\0';
+
+                hist_account(UART_SPI_DIR_UART_TO_SPI, length);
+            }
+        }
+
+        uint8_t *out = rx_buf->buff + rx_fill;
+        uint8_t *rx = out + rx_shift;
+
+        if (spi_tx_rx(chunk_tx, rx, length) != 0) {
+            // Error. The forwarded chunk is dropped
+            if (forwarding) {
+                tx_buf = pool_buf_consume(tx_buf, length);
+            }
+
+            continue;
+        }
+
+        if (forwarding) {
+            // The observer works with the buffer while it is transmitted
+            tap_publish(UART_SPI_DIR_UART_TO_SPI, chunk_tx, length, tx_buf);
+        }
+
+        spi_tx_rx_finish(length);
+
+        if (forwarding) {
+            tx_buf = pool_buf_consume(tx_buf, length);
+        }
+
+        link_idle = !forwarding && !injecting;
+
+        if (injecting) {
+            inject_offset += length;
+            if (inject_offset >= inject.length) {
+                // The whole message is transmitted
+                inject_release(&inject);
+                injecting = false;
+            }
+        }
+
+        // Extract the strings from the received data.
+        // The data is compacted in place
+        size_t received = 0;
+
+        // The released message bytes not added to the CRC yet
+        size_t crc_start = 0;
+
+        if (!crc_checking) {
+            received = uart_spi_miso_filter(&miso, rx, length, out);
+        }
+        else {
+            for (size_t q = 0; q < length; q++) {
+                switch (uart_spi_miso_byte(&miso, rx[q])) {
+                    case UART_SPI_MISO_DATA:
+                        received += crc_check_byte(&rx_crc, UART_SPI_DIR_SPI_TO_UART, rx[q], out + received);
+                        break;
+
+                    case UART_SPI_MISO_END:
+                        // One CRC unit run per message part
+                        rx_crc.crc = uart_spi_crc32_hw_update(rx_crc.crc, out + crc_start, received - crc_start);
+
+                        // Pass the trailer and '\0'
+                        received += crc_check_byte(&rx_crc, UART_SPI_DIR_SPI_TO_UART, '\0', out + received);
+                        crc_start = received;
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+        if (crc_checking && received > crc_start) {
+            // The message continues in the next transaction
+            rx_crc.crc = uart_spi_crc32_hw_update(rx_crc.crc, out + crc_start, received - crc_start);
+        }
+
+        if (received > 0) {
+            link_idle = false;
+
+            if (rx_fill == 0) {
+                rx_first_tick = osKernelGetTickCount();
+            }
+
+            rx_fill += received;
+        }
+
+        // Pass the buffer to the UART once it is nearly full or the slave pauses.
+        // The batching holds the buffer back until the batch is collected
+        if (rx_fill > 0 &&
+            (POOL_BUFF_SIZE - rx_fill < POOL_RX_SPACE_MIN ||
+             (received == 0 &&
+              (rx_fill >= tunables.batch_size ||
+               osKernelGetTickCount() - rx_first_tick >= pdMS_TO_TICKS(BATCH_TIMEOUT_MS))))) {
+            spi_rx_handoff(rx_buf, rx_fill);
+            rx_buf = NULL;
+        }
+    }
+
+    if (tx_buf) {
+        // Aborted in the middle of the buffer
+        uart_spi_buf_unref(&pool, tx_buf);
+    }
+
+    if (rx_buf) {
+        // The collected data is forwarded on the draining
+        if (rx_fill > 0) {
+            spi_rx_handoff(rx_buf, rx_fill);
+        }
+        else {
+            uart_spi_buf_unref(&pool, rx_buf);
+        }
+    }
+
+    if (injecting) {
+        // Aborted in the middle of the application message
+        inject_release(&inject);
+    }
+
+    spi_task_running = false;
+
+    // UART task may wait for the SPI task exit to finish the draining
+    uart_task_kick();
+
+    osThreadExit();
+}
+
+// ----------------------------------------------------------------------------
+
+static int uart_rx_start(void)
+{
+    if (bridge_params.low_power) {
+        return uart_rx_fifo_start();
+    }
+
+    HAL_StatusTypeDef status = HAL_UART_Receive_IT(uart_handle, &uart_rx_byte, 1);
+
+    return status == HAL_OK ? 0 : -1;
+}
+
+static int uart_tx_async(const void *data, size_t length)
+{
+    // Drop the late completion of the previously aborted transfer
+    osSemaphoreAcquire(uart_tx_sema, 0);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_DMA_START, UART_SPI_DIR_SPI_TO_UART, length);
+
+    uart_line_transmit();
+
+    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(uart_handle, data, length);
+
+    if (status != HAL_OK) {
+        uart_line_receive();
+    }
+
+    // The peripheral stuck in the busy state is detected by the supervisor
+    uart_health.start_failures = status == HAL_OK ? 0 : uart_health.start_failures + 1;
+
+    return status == HAL_OK ? 0 : -1;
+}
+
+static int uart_wait_tx_ready(uint32_t timeout_ms)
+{
+    osStatus_t status = osSemaphoreAcquire(uart_tx_sema, pdMS_TO_TICKS(timeout_ms));
+
+    return status == osOK ? 0 : -1;
+}
+
+static void uart_tx_abort(void)
+{
+    HAL_UART_AbortTransmit_IT(uart_handle);
+
+    uart_line_receive();
+}
+
+/**
+ * @brief Wait for the UART transmission completion within its deadline
+ * 
+ * The transmission is aborted on the deadline miss.
+ * The UART is reinitialized after several misses in a row
+ * 
+ * @param length The transmitted data length
+ */
+static void uart_tx_finish(size_t length)
+{
+    uint32_t deadline_ms = transfer_deadline_ms(length, uart_byte_rate);
+
+    // Let the supervisor know the task waits legitimately
+    uart_health.deadline = (osKernelGetTickCount() + pdMS_TO_TICKS(deadline_ms)) | 1;
+
+    int result = uart_wait_tx_ready(deadline_ms);
+
+    uart_health.deadline = 0;
+
+    if (result == 0) {
+        uart_deadline_misses = 0;
+        return;
+    }
+
+    // Abort ongoing transmitting in case of deadline miss
+    stats.uart_deadline_misses++;
+    uart_tx_abort();
+
+    if (++uart_deadline_misses >= DEADLINE_MISSES_TO_RECOVER) {
+        uart_recover();
+    }
+}
+
+static void uart_callbacks_register(void)
+{
+    HAL_StatusTypeDef status;
+
+    status = HAL_UART_RegisterCallback(uart_handle, HAL_UART_TX_COMPLETE_CB_ID, uart_tx_complete_callback);
+    assert(status == HAL_OK);
+
+    status = HAL_UART_RegisterCallback(uart_handle, HAL_UART_RX_COMPLETE_CB_ID, uart_rx_complete_callback);
+    assert(status == HAL_OK);
+
+    status = HAL_UART_RegisterCallback(uart_handle, HAL_UART_ERROR_CB_ID, uart_error_callback);
+    assert(status == HAL_OK);
+}
+
+/**
+ * @brief Reinitialize the UART and its DMA channel and restart the reception
+ * 
+ * The HAL handle keeps the configuration.
+ */
+static void uart_recover(void)
+{
+    stats.uart_recoveries++;
+    uart_deadline_misses = 0;
+
+    if (uart_reinit() == 0) {
+        uart_rx_start();
+    }
+}
+
+/**
+ * @brief Reinitialize the UART and its DMA channel with the HAL handle configuration
+ * 
+ * The HAL resets the registered callbacks on initialization, so they are registered again
+ * 
+ * @return 0 - on success, -1 - on error
+ */
+static int uart_reinit(void)
+{
+    HAL_UART_Abort(uart_handle);
+    HAL_UART_DeInit(uart_handle);
+
+    if (uart_link_init() != 0) {
+        return -1;
+    }
+
+    if (bridge_params.low_power && uart_low_power_init() != 0) {
+        return -1;
+    }
+
+    uart_callbacks_register();
+
+    return 0;
+}
+
+/**
+ * @brief Initialize the UART in the line mode of the parameters
+ * 
+ * In the RS-485 mode the USART drives the transceiver DE pin itself, so the bus
+ * is released right after the stop bit. The addressed node waits in the mute mode
+ * for the address mark: the byte with the MSB set and the node address in the rest
+ * 
+ * @return 0 - on success, -1 - on error
+ */
+static int uart_link_init(void)
+{
+    if (bridge_params.link == UART_SPI_LINK_HALF_DUPLEX) {
+        if (HAL_HalfDuplex_Init(uart_handle) != HAL_OK) {
+            return -1;
+        }
+
+        // The line is turned to the transmission for each transfer only
+        uart_line_receive();
+
+        return 0;
+    }
+
+    if (bridge_params.link != UART_SPI_LINK_RS485) {
+        return HAL_UART_Init(uart_handle) == HAL_OK ? 0 : -1;
+    }
+
+    HAL_StatusTypeDef status = HAL_RS485Ex_Init(uart_handle, UART_DE_POLARITY_HIGH,
+        bridge_params.rs485_de_assert, bridge_params.rs485_de_deassert);
+
+    if (status != HAL_OK || bridge_params.rs485_address == 0) {
+        return status == HAL_OK ? 0 : -1;
+    }
+
+    // The driver enable configuration is kept
+    status = HAL_MultiProcessor_Init(uart_handle, bridge_params.rs485_address, UART_WAKEUPMETHOD_ADDRESSMARK);
+
+    if (status == HAL_OK) {
+        status = HAL_MultiProcessorEx_AddressLength_Set(uart_handle, UART_ADDRESS_DETECT_7B);
+    }
+
+    if (status == HAL_OK) {
+        status = HAL_MultiProcessor_EnableMuteMode(uart_handle);
+    }
+
+    if (status != HAL_OK) {
+        return -1;
+    }
+
+    // Not addressed until the first poll
+    HAL_MultiProcessor_EnterMuteMode(uart_handle);
+
+    return 0;
+}
+
+/**
+ * @brief Configure the low power reception
+ * 
+ * DMA doesn't run in the Stop mode, so the bytes are buffered in the 8-byte RX FIFO.
+ * The USART wakes the MCU up when the FIFO is 3/4 full, on the string terminator
+ * (the character match) and on the line idle after the string tail (the receiver timeout).
+ * The USART kernel clock is HSI16, it is requested by the USART in the Stop mode
+ * 
+ * @return 0 - on success, -1 - on error
+ */
+static int uart_low_power_init(void)
+{
+    HAL_StatusTypeDef status = HAL_UARTEx_EnableFifoMode(uart_handle);
+
+    if (status == HAL_OK) {
+        status = HAL_UARTEx_SetRxFifoThreshold(uart_handle, UART_RXFIFO_THRESHOLD_3_4);
+    }
+
+    if (status != HAL_OK) {
+        return -1;
+    }
+
+    // The match character is written while the USART is disabled
+    __HAL_UART_DISABLE(uart_handle);
+    MODIFY_REG(uart_handle->Instance->CR2, USART_CR2_ADD, (uint32_t)'\0' << USART_CR2_ADD_Pos);
+    __HAL_UART_ENABLE(uart_handle);
+
+    HAL_UART_ReceiverTimeout_Config(uart_handle, UART_RX_TIMEOUT_BITS);
+
+    status = HAL_UART_EnableReceiverTimeout(uart_handle);
+
+    if (status == HAL_OK) {
+        status = HAL_UARTEx_EnableStopMode(uart_handle);
+    }
+
+    return status == HAL_OK ? 0 : -1;
+}
+
+/**
+ * @brief Start the low power reception
+ * 
+ * The HAL has no FIFO reception without a length, so the receive state is set here
+ * and the HAL interrupt handler calls \ref uart_rx_fifo_isr while the FIFO is not empty.
+ * The receiver timeout and overrun end the reception, the error callback restarts it
+ * 
+ * @return 0 - on success, -1 - on error
+ */
+static int uart_rx_fifo_start(void)
+{
+    if (uart_handle->RxState != HAL_UART_STATE_READY) {
+        return -1;
+    }
+
+    uart_handle->ErrorCode = HAL_UART_ERROR_NONE;
+    uart_handle->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    uart_handle->RxISR = uart_rx_fifo_isr;
+    uart_handle->RxState = HAL_UART_STATE_BUSY_RX;
+
+    __HAL_UART_CLEAR_FLAG(uart_handle, UART_CLEAR_CMF | UART_CLEAR_RTOF);
+
+    ATOMIC_SET_BIT(uart_handle->Instance->CR3, USART_CR3_EIE | USART_CR3_RXFTIE);
+    ATOMIC_SET_BIT(uart_handle->Instance->CR1, USART_CR1_PEIE | USART_CR1_CMIE | USART_CR1_RTOIE);
+
+    return 0;
+}
+
+/**
+ * @brief Forward the bytes of the RX FIFO. Called by the HAL interrupt handler
+ * 
+ * The character match flag is cleared after the FIFO is emptied. A terminator
+ * received meanwhile is read by the next pass, so the flag never stays set
+ * with the empty FIFO (the HAL doesn't handle it)
+ */
+static void uart_rx_fifo_isr(UART_HandleTypeDef *handle)
+{
+    bool corrupted = (handle->ErrorCode & UART_RX_ERRORS) != 0;
+
+    do {
+        while (__HAL_UART_GET_FLAG(handle, UART_FLAG_RXFNE)) {
+            uint8_t byte = (uint8_t)READ_REG(handle->Instance->RDR);
+
+            // Stopping. Don't accept the new data
+            if (bridge_state == BRIDGE_RUNNING) {
+                uart_rx_forward(byte, corrupted);
+            }
+        }
+
+        __HAL_UART_CLEAR_FLAG(handle, UART_CLEAR_CMF);
+    } while (__HAL_UART_GET_FLAG(handle, UART_FLAG_RXFNE));
+}
+
+/**
+ * @brief Check if the node may transmit to the UART
+ * 
+ * The addressed RS-485 node transmits only between its address mark and the address
+ * of another node. The latter mutes the USART
+ */
+static bool uart_bus_granted(void)
+{
+    if (bridge_params.link != UART_SPI_LINK_RS485 || bridge_params.rs485_address == 0) {
+        return true;
+    }
+
+    return READ_BIT(uart_handle->Instance->ISR, USART_ISR_RWU) == 0;
+}
+
+/**
+ * @brief Turn the half-duplex line to the transmission
+ * 
+ * The receiver is disabled, so the echo of the own transmission is dropped by the hardware.
+ * The character being received is completed first. It is one frame time at most
+ */
+static void uart_line_transmit(void)
+{
+    if (bridge_params.link != UART_SPI_LINK_HALF_DUPLEX) {
+        return;
+    }
+
+    uint32_t start = osKernelGetTickCount();
+    uint32_t timeout = pdMS_TO_TICKS(transfer_deadline_ms(1, uart_byte_rate));
+
+    while (READ_BIT(uart_handle->Instance->ISR, USART_ISR_BUSY) != 0 &&
+           osKernelGetTickCount() - start < timeout) {
+        osDelay(1);
+    }
+
+    HAL_HalfDuplex_EnableTransmitter(uart_handle);
+}
+
+/**
+ * @brief Turn the half-duplex line back to the reception
+ * 
+ * Called once the last stop bit is sent: the transmission complete callback
+ * is raised by the TC flag, not by the DMA. The reception interrupt stays armed
+ */
+static void uart_line_receive(void)
+{
+    if (bridge_params.link != UART_SPI_LINK_HALF_DUPLEX) {
+        return;
+    }
+
+    HAL_HalfDuplex_EnableReceiver(uart_handle);
+}
+
+/**
+ * @brief Apply the UART baud rate of the tunables
+ * 
+ * The previous rate is restored if the peripheral doesn't accept the new one.
+ * The reception is restarted if the module is running
+ */
+static void uart_reconfigure(void)
+{
+    uint32_t baud = uart_handle->Init.BaudRate;
+
+    uart_reconfig_pending = false;
+
+    uart_handle->Init.BaudRate = tunables.uart_baud;
+
+    if (uart_reinit() != 0) {
+        uart_handle->Init.BaudRate = baud;
+        uart_reinit();
+    }
+
+    tunables.uart_baud = uart_handle->Init.BaudRate;
+    uart_byte_rate = uart_byte_rate_get();
+
+    if (arq) {
+        // The window follows the bandwidth-delay product
+        uart_spi_arq_rate_set(arq, uart_byte_rate);
+    }
+
+    if (bridge_state == BRIDGE_RUNNING) {
+        uart_rx_start();
+    }
+}
+
+/**
+ * @brief Calculate the UART line rate from its configuration
+ * 
+ * @return The rate in bytes per second
+ */
+static uint32_t uart_byte_rate_get(void)
+{
+    // Start bit
+    uint32_t frame_bits = 1;
+
+    // Data bits including parity
+    switch (uart_handle->Init.WordLength) {
+        case UART_WORDLENGTH_7B: frame_bits += 7; break;
+        case UART_WORDLENGTH_9B: frame_bits += 9; break;
+        default: frame_bits += 8; break;
+    }
+
+    // Stop bits rounded up
+    frame_bits += (uart_handle->Init.StopBits == UART_STOPBITS_1 || uart_handle->Init.StopBits == UART_STOPBITS_0_5) ? 1 : 2;
+
+    return uart_handle->Init.BaudRate / frame_bits;
+}
+
+static void uart_tx_complete_callback(UART_HandleTypeDef *handle)
+{
+    UNUSED(handle);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_DMA_COMPLETE, UART_SPI_DIR_SPI_TO_UART, 0);
+
+    uart_line_receive();
+
+    osSemaphoreRelease(uart_tx_sema);
+}
+
+static void uart_rx_complete_callback(UART_HandleTypeDef *handle)
+{
+    if (bridge_state != BRIDGE_RUNNING) {
+        // Stopping. Don't accept the new data
+        return;
+    }
+
+    // The byte received together with the error is completed before the error callback.
+    // Account the errors here, because the reception restart clears the error code
+    uint32_t errors = handle->ErrorCode & UART_RX_ERRORS;
+    if (errors != HAL_UART_ERROR_NONE) {
+        uart_errors_account(errors);
+    }
+
+    if (bridge_params.link == UART_SPI_LINK_RS485 && bridge_params.rs485_address != 0 && (uart_rx_byte & 0x80) != 0) {
+        // The node address mark. The node is polled: let the UART task answer right away
+        uart_task_kick_from_isr();
+    }
+    else {
+        uart_rx_forward(uart_rx_byte, errors != HAL_UART_ERROR_NONE);
+    }
+
+    uart_rx_start();
+}
+
+static void uart_error_callback(UART_HandleTypeDef *handle)
+{
+    uint32_t errors = handle->ErrorCode;
+
+    uart_errors_account(errors);
+
+    if ((errors & UART_RX_ERRORS) != 0 && bridge_params.rx_error_policy == UART_SPI_RX_ERROR_DISCARD) {
+        // The data is lost without the byte reception. The current string is corrupted
+        uart_rx_discarding = true;
+    }
+
+    // Blocking errors (overrun) abort the reception. Restart it immediately.
+    // The receiver timeout of the low power reception is not an error, just the line idle
+    if (handle->RxState == HAL_UART_STATE_READY && bridge_state == BRIDGE_RUNNING) {
+        if (uart_rx_start() == 0 && errors != HAL_UART_ERROR_RTO) {
+            stats.uart_rx_restarts++;
+        }
+    }
+
+    // Only DMA error terminates the transmission
+    if ((errors & HAL_UART_ERROR_DMA) != 0) {
+        uart_line_receive();
+        osSemaphoreRelease(uart_tx_sema);
+    }
+}
+
+/**
+ * @brief Count the UART errors per type
+ * 
+ * @param errors The HAL UART error code
+ */
+static void uart_errors_account(uint32_t errors)
+{
+    if (errors & HAL_UART_ERROR_PE) {
+        stats.uart_parity_errors++;
+    }
+
+    if (errors & HAL_UART_ERROR_FE) {
+        stats.uart_framing_errors++;
+    }
+
+    if (errors & HAL_UART_ERROR_NE) {
+        stats.uart_noise_errors++;
+    }
+
+    if (errors & HAL_UART_ERROR_ORE) {
+        stats.uart_overrun_errors++;
+    }
+
+    if (errors & HAL_UART_ERROR_DMA) {
+        stats.uart_dma_errors++;
+    }
+}
+
+/**
+ * @brief Pass the received byte to the UART-to-SPI ring according to the error policy
+ * 
+ * @param byte The received byte
+ * @param corrupted The byte is received with error
+ */
+static void uart_rx_forward(uint8_t byte, bool corrupted)
+{
+    if (bridge_params.reliable && arq_rx(byte, corrupted)) {
+        // The acknowledgement byte
+        return;
+    }
+
+#if UART_SPI_MGMT
+    if (mgmt_rx(byte, corrupted)) {
+        // The management command byte
+        return;
+    }
+#endif
+
+    if (corrupted && bridge_params.rx_error_policy == UART_SPI_RX_ERROR_DISCARD) {
+        uart_rx_discarding = true;
+    }
+
+    if (uart_rx_discarding) {
+        if (byte != '\0') {
+            stats.uart_rx_discarded++;
+            return;
+        }
+
+        // The terminator closes the truncated string. Forward it to keep the strings apart
+        uart_rx_discarding = false;
+    }
+
+    uart_rx_message(&byte, 1);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_STREAM_SEND, UART_SPI_DIR_UART_TO_SPI, 1);
+}
+
+/**
+ * @brief Pass the forwarded string bytes to the UART-to-SPI buffer through the CRC trailer check
+ * 
+ * Called from the UART RX interrupt. The CRC is calculated in software:
+ * the CRC unit is used by the SPI task
+ * 
+ * @param data The pointer to the bytes
+ * @param length The number of bytes
+ */
+static void uart_rx_message(const void *data, size_t length)
+{
+    if (bridge_params.crc_mode == UART_SPI_CRC_OFF) {
+        uart_rx_append(data, length);
+        return;
+    }
+
+    const uint8_t *bytes = data;
+    uint8_t out[CRC_TRAILER_LENGTH + 1];
+
+    for (size_t q = 0; q < length; q++) {
+        size_t released = crc_check_byte(&uart_rx_crc, UART_SPI_DIR_UART_TO_SPI, bytes[q], out);
+
+        if (bytes[q] != '\0') {
+            uart_rx_crc.crc = uart_spi_crc32_update(uart_rx_crc.crc, out, released);
+        }
+
+        uart_rx_append(out, released);
+    }
+}
+
+/**
+ * @brief Catch the ARQ acknowledgement in the received bytes
+ * 
+ * The acknowledgement is the string starting with @ref UART_SPI_ARQ_ACK.
+ * It is consumed completely including the terminator and passed to the UART task
+ * 
+ * @param byte The received byte
+ * @param corrupted The byte is received with error
+ * @return true - the byte is consumed, false - the byte must be forwarded
+ */
+static bool arq_rx(uint8_t byte, bool corrupted)
+{
+    if (!arq_ack_receiving) {
+        if (arq_rx_string_start && byte == UART_SPI_ARQ_ACK && !corrupted) {
+            arq_ack_receiving = true;
+            arq_ack_valid = true;
+            arq_ack_length = 0;
+            return true;
+        }
+
+        arq_rx_string_start = byte == '\0';
+        return false;
+    }
+
+    if (byte == '\0') {
+        uint8_t next;
+        uint32_t sack;
+
+        arq_ack_receiving = false;
+
+        if (arq_ack_valid && uart_spi_arq_ack_parse(arq_ack_text, arq_ack_length, &next, &sack) == 0) {
+            // The newer acknowledgement supersedes the one not processed yet
+            arq_ack_next = next;
+            arq_ack_sack = sack;
+            arq_ack_ready = true;
+
+            uart_task_kick_from_isr();
+        }
+    }
+    else if (corrupted || arq_ack_length >= UART_SPI_ARQ_ACK_LENGTH) {
+        arq_ack_valid = false;
+    }
+    else {
+        arq_ack_text[arq_ack_length++] = byte;
+    }
+
+    return true;
+}
+
+#if UART_SPI_MGMT
+
+/**
+ * @brief Catch the management command in the received bytes
+ * 
+ * Only the first bytes of each string are compared with the prefix. They are held back
+ * until the prefix mismatch, so the forwarded string is delayed by the prefix length at most.
+ * The command string is consumed completely including the terminator.
+ * 
+ * @param byte The received byte
+ * @param corrupted The byte is received with error
+ * @return true - the byte is consumed, false - the byte must be forwarded
+ */
+static bool mgmt_rx(uint8_t byte, bool corrupted)
+{
+    if (mgmt_receiving) {
+        if (byte == '\0') {
+            mgmt_receiving = false;
+            uart_rx_string_start = true;
+
+            if (mgmt_command_valid) {
+                mgmt_command[mgmt_command_length] = '\0';
+                mgmt_command_ready = true;
+                uart_task_kick_from_isr();
+            }
+        }
+        else if (!mgmt_command_valid) {
+            // Dropped
+        }
+        else if (corrupted || mgmt_command_length >= UART_SPI_MGMT_COMMAND_SIZE - 1) {
+            mgmt_command_valid = false;
+        }
+        else {
+            mgmt_command[mgmt_command_length++] = byte;
+        }
+
+        return true;
+    }
+
+    if (!uart_rx_string_start) {
+        uart_rx_string_start = byte == '\0';
+        return false;
+    }
+
+    if (!corrupted && byte == (uint8_t)UART_SPI_MGMT_PREFIX[mgmt_prefix_matched]) {
+        if (++mgmt_prefix_matched == UART_SPI_MGMT_PREFIX_LENGTH) {
+            mgmt_prefix_matched = 0;
+            mgmt_receiving = true;
+            mgmt_command_length = 0;
+
+            // The buffer is busy while the previous command is executed. The new one is dropped
+            mgmt_command_valid = !mgmt_command_ready;
+        }
+
+        return true;
+    }
+
+    // Not a command. Forward the held back prefix bytes first
+    uart_rx_message(UART_SPI_MGMT_PREFIX, mgmt_prefix_matched);
+
+    mgmt_prefix_matched = 0;
+    uart_rx_string_start = byte == '\0';
+
+    return false;
+}
+
+/**
+ * @brief Transmit the management reply line to the UART
+ * 
+ * Called from the UART task. The line feed is replaced by the prefix and the terminator
+ */
+static void mgmt_output(const char *line, size_t length, void *ctx)
+{
+    UNUSED(ctx);
+
+    static char buff[UART_SPI_MGMT_PREFIX_LENGTH + UART_SPI_MGMT_LINE_SIZE + CRC_TRAILER_LENGTH + 1];
+
+    if (length > 0 && line[length - 1] == '\n') {
+        length--;
+    }
+
+    if (length > UART_SPI_MGMT_LINE_SIZE) {
+        length = UART_SPI_MGMT_LINE_SIZE;
+    }
+
+    memcpy(buff, UART_SPI_MGMT_PREFIX, UART_SPI_MGMT_PREFIX_LENGTH);
+    memcpy(buff + UART_SPI_MGMT_PREFIX_LENGTH, line, length);
+
+    length += UART_SPI_MGMT_PREFIX_LENGTH;
+
+    if (bridge_params.crc_generate) {
+        crc_trailer_write(buff, length, buff + length);
+        length += CRC_TRAILER_LENGTH;
+    }
+
+    buff[length++] = '\0';
+
+    // Long replies are not a stall
+    uart_health.heartbeat++;
+
+    if (arq) {
+        uart_arq_send(buff, length);
+        return;
+    }
+
+    if (uart_tx_async(buff, length) == 0) {
+        uart_tx_finish(length);
+    }
+}
+
+#endif /* UART_SPI_MGMT */
+
+// ----------------------------------------------------------------------------
+
+static int spi_tx_rx(const void *txd, void *rxd, size_t length)
+{
+    // Drop the late completion of the previously aborted transfer
+    osSemaphoreAcquire(spi_tx_rx_sema, 0);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_DMA_START, UART_SPI_DIR_UART_TO_SPI, length);
+
+    HAL_StatusTypeDef status = HAL_SPI_TransmitReceive_DMA(spi_handle, (void *)txd, rxd, length);
+
+    // The peripheral stuck in the busy state is detected by the supervisor
+    spi_health.start_failures = status == HAL_OK ? 0 : spi_health.start_failures + 1;
+
+    return status == HAL_OK ? 0 : -1;
+}
+
+static int spi_wait_ready(uint32_t timeout_ms)
+{
+    osStatus_t status = osSemaphoreAcquire(spi_tx_rx_sema, pdMS_TO_TICKS(timeout_ms));
+
+    return status == osOK ? 0 : -1;
+}
+
+static void spi_abort(void)
+{
+    HAL_SPI_Abort_IT(spi_handle);
+}
+
+/**
+ * @brief Wait for the SPI transaction completion within its deadline
+ * 
+ * The transaction is aborted on the deadline miss.
+ * The SPI is reinitialized after several misses in a row
+ * 
+ * @param length The transaction length
+ */
+static void spi_tx_rx_finish(size_t length)
+{
+    uint32_t deadline_ms = transfer_deadline_ms(length, spi_byte_rate);
+
+    // Let the supervisor know the task waits legitimately
+    spi_health.deadline = (osKernelGetTickCount() + pdMS_TO_TICKS(deadline_ms)) | 1;
+
+    int result = spi_wait_ready(deadline_ms);
+
+    spi_health.deadline = 0;
+
+    if (result == 0) {
+        spi_deadline_misses = 0;
+        return;
+    }
+
+    // Abort ongoing transaction in case of deadline miss
+    stats.spi_deadline_misses++;
+    spi_abort();
+
+    if (++spi_deadline_misses >= DEADLINE_MISSES_TO_RECOVER) {
+        spi_recover();
+    }
+}
+
+static void spi_callbacks_register(void)
+{
+    HAL_StatusTypeDef status;
+
+    status = HAL_SPI_RegisterCallback(spi_handle, HAL_SPI_TX_RX_COMPLETE_CB_ID, spi_tx_rx_complete_callback);
+    assert(status == HAL_OK);
+
+    status = HAL_SPI_RegisterCallback(spi_handle, HAL_SPI_ERROR_CB_ID, spi_error_callback);
+    assert(status == HAL_OK);
+}
+
+/**
+ * @brief Reinitialize the SPI and its DMA channels
+ * 
+ * The HAL handle keeps the configuration.
+ */
+static void spi_recover(void)
+{
+    stats.spi_recoveries++;
+    spi_deadline_misses = 0;
+
+    spi_reinit();
+}
+
+/**
+ * @brief Reinitialize the SPI and its DMA channels with the HAL handle configuration
+ * 
+ * The HAL resets the registered callbacks on initialization, so they are registered again
+ * 
+ * @return 0 - on success, -1 - on error
+ */
+static int spi_reinit(void)
+{
+    HAL_SPI_Abort(spi_handle);
+    HAL_SPI_DeInit(spi_handle);
+
+    if (HAL_SPI_Init(spi_handle) != HAL_OK) {
+        return -1;
+    }
+
+    spi_callbacks_register();
+
+    return 0;
+}
+
+/**
+ * @brief Apply the SPI prescaler of the tunables
+ * 
+ */
+static void spi_reconfigure(void)
+{
+    uint32_t br = 0;
+
+    spi_reconfig_pending = false;
+
+    while ((2UL << br) < tunables.spi_prescaler) {
+        br++;
+    }
+
+    spi_handle->Init.BaudRatePrescaler = br << SPI_CR1_BR_Pos;
+
+    spi_reinit();
+
+    spi_byte_rate = spi_byte_rate_get();
+}
+
+/**
+ * @brief Get the SPI clock prescaler from its configuration
+ * 
+ * @return The prescaler. 2 - 256
+ */
+static uint32_t spi_prescaler_get(void)
+{
+    return 2UL << (spi_handle->Init.BaudRatePrescaler >> SPI_CR1_BR_Pos);
+}
+
+/**
+ * @brief Calculate the SPI line rate from its configuration
+ * 
+ * @return The rate in bytes per second
+ */
+static uint32_t spi_byte_rate_get(void)
+{
+    uint32_t prescaler = spi_prescaler_get();
+    uint32_t frame_bits = (spi_handle->Init.DataSize >> SPI_CR2_DS_Pos) + 1;
+
+    return HAL_RCC_GetPCLK1Freq() / prescaler / frame_bits;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Calculate the transfer deadline
+ * 
+ * @param length The transfer length in bytes
+ * @param byte_rate The line rate in bytes per second
+ * @return The deadline in milliseconds including the margin
+ */
+static uint32_t transfer_deadline_ms(size_t length, uint32_t byte_rate)
+{
+    uint32_t time_ms = (length * 1000 + byte_rate - 1) / byte_rate;
+
+    return time_ms + time_ms * DEADLINE_MARGIN_PERCENT / 100 + DEADLINE_MARGIN_MS;
+}
+
+/**
+ * @brief Start the CRC trailer check of the new message
+ * 
+ */
+static void crc_check_reset(crc_check_t *check)
+{
+    check->crc = 0;
+    check->tail_start = 0;
+    check->tail_length = 0;
+}
+
+/**
+ * @brief Pass the received string byte through the CRC trailer check
+ * 
+ * The last message bytes are held back until the terminator, so the wrong trailer
+ * can be replaced. The caller adds the released message bytes to the check CRC
+ * before the terminator is passed. The output is never longer than the input
+ * together with the held back bytes
+ * 
+ * @param check The check of the direction
+ * @param dir The direction. Selects the error counter
+ * @param byte The received byte
+ * @param out The released bytes. Up to @ref CRC_TRAILER_LENGTH + 1
+ * @return The number of the released bytes
+ */
+static size_t crc_check_byte(crc_check_t *check, uart_spi_dir_t dir, uint8_t byte, uint8_t *out)
+{
+    size_t length = 0;
+
+    if (byte != '\0') {
+        size_t end = (check->tail_start + check->tail_length) % CRC_TRAILER_LENGTH;
+
+        if (check->tail_length == CRC_TRAILER_LENGTH) {
+            // The oldest byte is not the trailer
+            out[length++] = check->tail[check->tail_start];
+            check->tail_start = (check->tail_start + 1) % CRC_TRAILER_LENGTH;
+        }
+        else {
+            check->tail_length++;
+        }
+
+        check->tail[end] = byte;
+
+        return length;
+    }
+
+    if (check->tail_length == 0) {
+        // Empty string
+        out[length++] = '\0';
+        return length;
+    }
+
+    uint32_t trailer = 0;
+    bool valid = check->tail_length == CRC_TRAILER_LENGTH;
+
+    for (size_t q = 0; q < check->tail_length; q++) {
+        uint8_t c = check->tail[(check->tail_start + q) % CRC_TRAILER_LENGTH];
+
+        if (c >= '0' && c <= '9') {
+            trailer = (trailer << 4) | (c - '0');
+        }
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            trailer = (trailer << 4) | ((c | 0x20) - 'a' + 10);
+        }
+        else {
+            valid = false;
+        }
+
+        out[length++] = c;
+    }
+
+    if (!valid || trailer != check->crc) {
+        if (dir == UART_SPI_DIR_UART_TO_SPI) {
+            stats.uart_crc_errors++;
+        }
+        else {
+            stats.spi_crc_errors++;
+        }
+
+        if (bridge_params.crc_mode == UART_SPI_CRC_FLAG) {
+            // The held back bytes only. A short string doesn't grow
+            memcpy(out, UART_SPI_CRC_FLAG_MARK, length);
+        }
+    }
+
+    out[length++] = '\0';
+
+    crc_check_reset(check);
+
+    return length;
+}
+
+/**
+ * @brief Write the CRC trailer of the string
+ * 
+ * @param data The pointer to the string bytes before the terminator
+ * @param length The string length
+ * @param out The trailer. @ref CRC_TRAILER_LENGTH hex digits, not terminated
+ */
+static void crc_trailer_write(const void *data, size_t length, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    uint32_t crc = uart_spi_crc32(data, length);
+
+    for (int q = CRC_TRAILER_LENGTH - 1; q >= 0; q--) {
+        out[q] = digits[crc & 0xF];
+        crc >>= 4;
+    }
+}
+
+/**
+ * @brief Copy the message adding the CRC trailer to each of its strings
+ * 
+ * The empty strings and the unterminated tail are copied as is, as the check passes them
+ * 
+ * @param out The copy. NULL - calculate the copy length only
+ * @param data The pointer to the message
+ * @param length The message length
+ * @return The copy length
+ */
+static size_t crc_trailers_copy(uint8_t *out, const uint8_t *data, size_t length)
+{
+    size_t copy_length = 0;
+    size_t string_start = 0;
+
+    for (size_t q = 0; q < length; q++) {
+        if (data[q] != '\0') {
+            continue;
+        }
+
+        size_t string_length = q - string_start;
+
+        if (out) {
+            memcpy(out + copy_length, data + string_start, string_length);
+        }
+
+        copy_length += string_length;
+
+        if (string_length > 0) {
+            if (out) {
+                crc_trailer_write(data + string_start, string_length, (char *)out + copy_length);
+            }
+
+            copy_length += CRC_TRAILER_LENGTH;
+        }
+
+        if (out) {
+            out[copy_length] = '\0';
+        }
+
+        copy_length++;
+        string_start = q + 1;
+    }
+
+    if (out) {
+        memcpy(out + copy_length, data + string_start, length - string_start);
+    }
+
+    return copy_length + length - string_start;
+}
+
+// ----------------------------------------------------------------------------
+
+static void spi_tx_rx_complete_callback(SPI_HandleTypeDef *handle)
+{
+    UNUSED(handle);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_DMA_COMPLETE, UART_SPI_DIR_UART_TO_SPI, 0);
+
+    osSemaphoreRelease(spi_tx_rx_sema);
+}
+
+static void spi_error_callback(SPI_HandleTypeDef *handle)
+{
+    UNUSED(handle);
+
+    osSemaphoreRelease(spi_tx_rx_sema);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Publish the forwarded data view to the tap observer
+ * 
+ * Never blocks. The view is dropped if the previous one is not dispatched yet.
+ * The pool buffer is shared with the observer by the reference until the view is dispatched.
+ * The data is recorded by the traffic capture as well
+ * 
+ * @param dir The forwarding direction
+ * @param data The pointer to the forwarded data
+ * @param length The data length
+ * @param buf The pool buffer the data is in
+ */
+static void tap_publish(uart_spi_dir_t dir, const void *data, size_t length, uart_spi_buf_t *buf)
+{
+    UART_SPI_CAPTURE_SPAN(dir, data, length);
+
+    // The rest is stripped if the tap is disabled
+    if (!UART_SPI_TAP || tap_callback == NULL) {
+        return;
+    }
+
+    tap_slot_t *slot = &tap_slots[dir];
+
+    if (slot->pending) {
+        // The observer is too slow
+        stats.tap_dropped++;
+        return;
+    }
+
+    slot->view.dir = dir;
+    slot->view.data = data;
+    slot->view.length = length;
+
+    uart_spi_buf_ref(buf);
+    slot->buf = buf;
+
+    // The view must be completely filled before it becomes visible to the observer
+    __DMB();
+    slot->pending = true;
+
+    osSemaphoreRelease(tap_sema);
+}
+
+/**
+ * @brief Count the forwarded transfer length in the histogram
+ * 
+ * @param dir The forwarding direction
+ * @param length The transfer length
+ */
+static void hist_account(uart_spi_dir_t dir, size_t length)
+{
+    int bucket = 0;
+
+    while ((length >>= 1) != 0 && bucket < UART_SPI_HIST_BUCKETS - 1) {
+        bucket++;
+    }
+
+    stats.length_hist[dir][bucket]++;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Copy the application message to the heap and enqueue it
+ * 
+ * The copy is freed once the message is transmitted.
+ * The CRC trailers are added to the copy if the module generates them
+ */
+static int inject_copy(uart_spi_dir_t dir, const void *data, size_t length, uint32_t timeout_ms)
+{
+    if (data == NULL || length == 0 || length > UINT16_MAX) {
+        return -1;
+    }
+
+    bool crc_generate = bridge_params.crc_generate;
+    size_t copy_length = crc_generate ? crc_trailers_copy(NULL, data, length) : length;
+
+    if (copy_length > UINT16_MAX) {
+        return -1;
+    }
+
+    void *copy = pvPortMalloc(copy_length);
+    if (copy == NULL) {
+        return -1;
+    }
+
+    if (crc_generate) {
+        crc_trailers_copy(copy, data, length);
+    }
+    else {
+        memcpy(copy, data, length);
+    }
+
+    if (inject_enqueue(dir, copy, copy_length, inject_free, NULL, timeout_ms) != 0) {
+        vPortFree(copy);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Enqueue the application message to the transmission
+ * 
+ * @param dir The direction the message joins
+ */
+static int inject_enqueue(uart_spi_dir_t dir, const void *data, size_t length,
+                          uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms)
+{
+    if (bridge_state != BRIDGE_RUNNING || inject_queues[dir] == NULL || data == NULL || length == 0 || length > UINT16_MAX) {
+        return -1;
+    }
+
+    inject_msg_t msg = {
+        .data = data,
+        .length = length,
+        .release = release,
+        .ctx = ctx
+    };
+
+    if (osMessageQueuePut(inject_queues[dir], &msg, 0, pdMS_TO_TICKS(timeout_ms)) != osOK) {
+        return -1;
+    }
+
+    if (dir == UART_SPI_DIR_SPI_TO_UART) {
+        uart_task_kick();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Enqueue the application message without copying
+ * 
+ * The CRC trailers don't fit the application buffer. If the module generates them,
+ * the message is copied with the trailers and the buffer is released right away
+ */
+static int inject_zc(uart_spi_dir_t dir, const void *data, size_t length,
+                     uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms)
+{
+    if (!bridge_params.crc_generate) {
+        return inject_enqueue(dir, data, length, release, ctx, timeout_ms);
+    }
+
+    if (inject_copy(dir, data, length, timeout_ms) != 0) {
+        return -1;
+    }
+
+    if (release) {
+        release(data, ctx);
+    }
+
+    return 0;
+}
+
+static void inject_release(inject_msg_t *msg)
+{
+    if (msg->release) {
+        msg->release(msg->data, msg->ctx);
+    }
+}
+
+static void inject_free(const void *data, void *ctx)
+{
+    UNUSED(ctx);
+
+    vPortFree((void *)data);
+}
+
+/**
+ * @brief Transmit the next application message to the UART if any
+ * 
+ * @return 0 - the message is processed, -1 - no messages
+ */
+static int uart_inject_transmit(void)
+{
+    inject_msg_t msg;
+
+    if (osMessageQueueGet(inject_queues[UART_SPI_DIR_SPI_TO_UART], &msg, NULL, 0) != osOK) {
+        return -1;
+    }
+
+    if (arq) {
+        uart_arq_send(msg.data, msg.length);
+    }
+    // The message is transmitted as a whole directly from the application buffer
+    else if (uart_tx_async(msg.data, msg.length) == 0) {
+        uart_tx_finish(msg.length);
+    }
+
+    inject_release(&msg);
+
+    return 0;
+}
+
+/**
+ * @brief Release all the queued application messages
+ * 
+ */
+static void inject_flush(void)
+{
+    inject_msg_t msg;
+
+    for (int dir = 0; dir < UART_SPI_DIR_COUNT; dir++) {
+        while (osMessageQueueGet(inject_queues[dir], &msg, NULL, 0) == osOK) {
+            inject_release(&msg);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Wait for the ring data
+ * 
+ * Returns once the ring has \c level bytes, on the timeout or on the task notification
+ * 
+ * @param ring The ring the calling task consumes
+ * @param level The data length to wait for
+ * @param ticks The maximum time to wait
+ */
+static void ring_wait(uart_spi_ring_t *ring, size_t level, TickType_t ticks)
+{
+    if (!uart_spi_ring_wait_arm(ring, level)) {
+        xTaskNotifyWait(0, 0, NULL, ticks);
+    }
+
+    uart_spi_ring_wait_disarm(ring);
+}
+
+/**
+ * @brief Append the received data to the UART-to-SPI pool buffer
+ * 
+ * Called from the UART RX interrupt. The full buffer is passed to the SPI task.
+ * The data is dropped if the direction share of the pool is exhausted
+ * 
+ * @param data The pointer to the data
+ * @param length The data length
+ */
+static void uart_rx_append(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    while (length > 0) {
+        uart_spi_buf_t *buf = uart_rx_buf;
+
+        if (buf == NULL) {
+            buf = uart_spi_pool_alloc(&pool, UART_SPI_DIR_UART_TO_SPI, UART_SPI_BUF_UART_RX);
+            if (buf == NULL) {
+                // Counted once per exhaustion as the SPI direction does
+                if (!uart_rx_pool_waiting) {
+                    stats.pool_exhausted++;
+                    uart_rx_pool_waiting = true;
+                }
+
+                return;
+            }
+
+            uart_rx_buf = buf;
+            uart_rx_pool_waiting = false;
+
+            // The SPI task may wait for the UART data while the link is idle
+            spi_task_kick_from_isr();
+        }
+
+        size_t part = POOL_BUFF_SIZE - buf->length;
+        if (part > length) {
+            part = length;
+        }
+
+        memcpy(buf->buff + buf->length, bytes, part);
+        buf->length += part;
+
+        bytes += part;
+        length -= part;
+
+        if (buf->length == POOL_BUFF_SIZE) {
+            // The queue has room for all the pool buffers
+            uint8_t index = uart_spi_pool_index(&pool, buf);
+            uart_spi_ring_write(&uart_rx_queue, &index, 1);
+
+            uart_rx_buf = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Take the next UART-to-SPI buffer
+ * 
+ * The full buffers are taken in order. Once there are none, the buffer being filled
+ * by the interrupt is taken, so the data is forwarded without waiting for the buffer end
+ * 
+ * @return The buffer, NULL - no UART data
+ */
+static uart_spi_buf_t *uart_rx_take(void)
+{
+    uart_spi_buf_t *buf;
+    uint8_t index;
+
+    // The interrupt must not pass the buffer to the queue in the middle
+    taskENTER_CRITICAL();
+
+    if (uart_spi_ring_read(&uart_rx_queue, &index, 1) == 1) {
+        buf = uart_spi_pool_get(&pool, index);
+    }
+    else {
+        buf = uart_rx_buf;
+        uart_rx_buf = NULL;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if (buf) {
+        buf->owner = UART_SPI_BUF_SPI_TX;
+    }
+
+    return buf;
+}
+
+/**
+ * @brief Check if the UART data waits for the SPI task
+ * 
+ */
+static bool uart_rx_pending(void)
+{
+    return uart_spi_ring_used(&uart_rx_queue) > 0 || uart_rx_buf != NULL;
+}
+
+/**
+ * @brief Wake up the UART task waiting for the SPI-to-UART buffers
+ * 
+ * Called from the SPI task
+ */
+static void spi_rx_queue_wakeup(void *ctx)
+{
+    UNUSED(ctx);
+
+    xTaskNotify((TaskHandle_t)uart_task_handle, 0, eNoAction);
+}
+
+/**
+ * @brief Make one step of the reliable SPI-to-UART forwarding
+ * 
+ * Called from the UART task. The acknowledgement is processed first.
+ * Then the lost frame is retransmitted or the new frame is transmitted.
+ * Otherwise the forwarded data is copied to the frames while the window is open.
+ * The task waits for the data, the acknowledgement or the retransmission timeout
+ * if there is nothing to do
+ * 
+ * @param tx_buf The pool buffer being copied to the frames. Updated
+ * @param message_transmitting The forwarded string is copied partially. Updated
+ */
+static void uart_arq_forward(uart_spi_buf_t **tx_buf, bool *message_transmitting)
+{
+    uint32_t now = osKernelGetTickCount() * portTICK_PERIOD_MS;
+
+    if (uart_arq_transmit(now)) {
+        return;
+    }
+
+    if (*tx_buf == NULL) {
+        uint8_t index;
+
+        if (uart_spi_ring_read(&spi_rx_queue, &index, 1) == 1) {
+            *tx_buf = uart_spi_pool_get(&pool, index);
+
+            UART_SPI_TRACE_EVENT(UART_SPI_TRACE_STREAM_RECEIVE, UART_SPI_DIR_SPI_TO_UART, (*tx_buf)->length);
+        }
+    }
+
+    if (*tx_buf) {
+        const uint8_t *data = uart_spi_buf_data(*tx_buf);
+
+        size_t length = uart_spi_arq_append(arq, data, (*tx_buf)->length);
+
+        if (length > 0) {
+            *message_transmitting = data[length - 1] != '\0';
+
+            tap_publish(UART_SPI_DIR_SPI_TO_UART, data, length, *tx_buf);
+
+            *tx_buf = pool_buf_consume(*tx_buf, length);
+
+            if (*tx_buf == NULL && uart_spi_ring_used(&spi_rx_queue) == 0) {
+                // Don't hold the string part until the slave sends the rest
+                uart_spi_arq_flush(arq);
+            }
+
+            return;
+        }
+    }
+
+    uint32_t timeout_ms = uart_spi_arq_timeout(arq, now);
+
+    if (*tx_buf == NULL) {
+        ring_wait(&spi_rx_queue, 1, timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+        return;
+    }
+
+    // The window is full. The supervisor sees the task alive while the peer is silent
+    if (timeout_ms > SUPERVISOR_PERIOD_MS / 2) {
+        timeout_ms = SUPERVISOR_PERIOD_MS / 2;
+    }
+
+    xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(timeout_ms));
+}
+
+/**
+ * @brief Process the ARQ acknowledgement and transmit the next frame if any
+ * 
+ * Called from the UART task. The frame stays in the window, so the failed
+ * transmission is retransmitted on the timeout
+ * 
+ * @param now The current time in ms
+ * @return true - the frame is transmitted, false - nothing to transmit
+ */
+static bool uart_arq_transmit(uint32_t now)
+{
+    if (arq_ack_ready) {
+        taskENTER_CRITICAL();
+
+        uint8_t next = arq_ack_next;
+        uint32_t sack = arq_ack_sack;
+        arq_ack_ready = false;
+
+        taskEXIT_CRITICAL();
+
+        uart_spi_arq_ack(arq, next, sack, now);
+    }
+
+    size_t length;
+    const uint8_t *frame = uart_spi_arq_next(arq, now, &length);
+
+    stats.arq_retransmissions = arq->retransmissions;
+    stats.arq_timeouts = arq->timeouts;
+    stats.arq_window = arq->window;
+    stats.arq_rto_ms = arq->rto;
+
+    if (frame == NULL) {
+        return false;
+    }
+
+    hist_account(UART_SPI_DIR_SPI_TO_UART, length);
+
+    if (uart_tx_async(frame, length) == 0) {
+        uart_tx_finish(length);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Pass the bridge own strings to the peer through the ARQ window
+ * 
+ * Called from the UART task between the forwarded strings for the management
+ * replies and the application messages. The data is copied to the frames;
+ * the frames are transmitted while the window is full. The unterminated
+ * data is passed without waiting for the rest
+ * 
+ * @param data The pointer to the data
+ * @param length The data length
+ */
+static void uart_arq_send(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+
+    while (length > 0 && bridge_state != BRIDGE_ABORTING) {
+        size_t appended = uart_spi_arq_append(arq, bytes, length);
+
+        if (appended > 0) {
+            bytes += appended;
+            length -= appended;
+            continue;
+        }
+
+        // The window is full. The supervisor sees the task alive while the peer is silent
+        uart_health.heartbeat++;
+
+        uint32_t now = osKernelGetTickCount() * portTICK_PERIOD_MS;
+
+        if (!uart_arq_transmit(now)) {
+            uint32_t timeout_ms = uart_spi_arq_timeout(arq, now);
+
+            if (timeout_ms > SUPERVISOR_PERIOD_MS / 2) {
+                timeout_ms = SUPERVISOR_PERIOD_MS / 2;
+            }
+
+            xTaskNotifyWait(0, 0, NULL, pdMS_TO_TICKS(timeout_ms));
+        }
+    }
+
+    uart_spi_arq_flush(arq);
+}
+
+/**
+ * @brief Pass the received slave data buffer to the UART task
+ * 
+ * The buffer reference is passed together with the buffer
+ * 
+ * @param buf The pool buffer
+ * @param length The received data length
+ */
+static void spi_rx_handoff(uart_spi_buf_t *buf, size_t length)
+{
+    buf->length = length;
+    buf->owner = UART_SPI_BUF_UART_TX;
+
+    // The queue has room for all the pool buffers
+    uint8_t index = uart_spi_pool_index(&pool, buf);
+    uart_spi_ring_write(&spi_rx_queue, &index, 1);
+
+    UART_SPI_TRACE_EVENT(UART_SPI_TRACE_STREAM_SEND, UART_SPI_DIR_SPI_TO_UART, length);
+}
+
+/**
+ * @brief Release the transmitted part of the pool buffer
+ * 
+ * @param buf The pool buffer
+ * @param length The transmitted data length
+ * @return The buffer, NULL - the buffer is transmitted completely and released
+ */
+static uart_spi_buf_t *pool_buf_consume(uart_spi_buf_t *buf, size_t length)
+{
+    buf->offset += length;
+    buf->length -= length;
+
+    if (buf->length > 0) {
+        return buf;
+    }
+
+    // DMA doesn't access the buffer anymore
+    uart_spi_buf_unref(&pool, buf);
+
+    return NULL;
+}
+
+/**
+ * @brief Return the queued buffers to the pool
+ * 
+ * Called once the tasks have exited
+ * 
+ * @param queue The descriptor queue
+ */
+static void pool_queue_flush(uart_spi_ring_t *queue)
+{
+    uint8_t index;
+
+    while (uart_spi_ring_read(queue, &index, 1) == 1) {
+        uart_spi_buf_unref(&pool, uart_spi_pool_get(&pool, index));
+    }
+}
+
+/**
+ * @brief Set the pool quotas of both directions from the tunables
+ * 
+ * The buffers over the new share are kept until they are transmitted
+ */
+static void pool_quota_apply(void)
+{
+    size_t limit = tunables.buffer_size / POOL_BUFF_SIZE;
+
+    for (int dir = 0; dir < UART_SPI_DIR_COUNT; dir++) {
+        uart_spi_pool_quota_set(&pool, dir, POOL_RESERVE_BUFFS, limit);
+    }
+}
+
+/**
+ * @brief Wake up the UART task waiting for the ring data
+ * 
+ * UART task may wait for the ring data infinitely.
+ * The notification interrupts the waiting without data.
+ */
+static void uart_task_kick(void)
+{
+    // The task must not be deleted between the check and the notification
+    taskENTER_CRITICAL();
+
+    // The handle is not assigned yet while the module is starting. The task checks its work on the start
+    if (uart_task_running && uart_task_handle != NULL) {
+        xTaskNotify((TaskHandle_t)uart_task_handle, 0, eNoAction);
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Wake up the UART task from the interrupt
+ * 
+ */
+static void uart_task_kick_from_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+    osThreadId_t task = uart_task_handle;
+
+    // Not started yet or stopped. The task checks its work on the start
+    if (task == NULL) {
+        return;
+    }
+
+    xTaskNotifyFromISR((TaskHandle_t)task, 0, eNoAction, &woken);
+
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Wake up the SPI task waiting for the UART data
+ * 
+ * Called from the UART RX interrupt
+ */
+static void spi_task_kick_from_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+    osThreadId_t task = spi_task_handle;
+
+    // Not started yet or stopped. The task checks its work on the start
+    if (task == NULL) {
+        return;
+    }
+
+    xTaskNotifyFromISR((TaskHandle_t)task, 0, eNoAction, &woken);
+
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Check if the UART task has finished its work on the module stopping
+ * 
+ * @param message_transmitting The forwarded string is transmitted partially
+ * @param forwarding The pool buffer is transmitted partially
+ */
+static bool uart_task_may_exit(bool message_transmitting, bool forwarding)
+{
+    if (bridge_state == BRIDGE_ABORTING) {
+        return true;
+    }
+
+    // The SPI task is the SPI-to-UART buffers source. Wait for it first
+    if (spi_task_running || forwarding || uart_spi_ring_used(&spi_rx_queue) > 0) {
+        return false;
+    }
+
+    // Application messages can't be transmitted after the incomplete string
+    return message_transmitting ||
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_SPI_TO_UART]) == 0;
+}
+
+/**
+ * @brief Check if the SPI task has finished its work on the module stopping
+ * 
+ * @param message_transmitting The forwarded string is transmitted partially
+ * @param injecting The application message is transmitted partially
+ * @param forwarding The pool buffer is transmitted partially
+ */
+static bool spi_task_may_exit(bool message_transmitting, bool injecting, bool forwarding)
+{
+    if (bridge_state == BRIDGE_ABORTING) {
+        return true;
+    }
+
+    if (injecting || forwarding || uart_rx_pending()) {
+        return false;
+    }
+
+    // Application messages can't be transmitted after the incomplete string
+    return message_transmitting ||
+           osMessageQueueGetCount(inject_queues[UART_SPI_DIR_UART_TO_SPI]) == 0;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Supervisor task
+ * 
+ * Periodically checks the bridge tasks progress. A task is stalled if it makes
+ * no progress having the work to do and it doesn't wait for the transfer
+ * within its deadline, or if its peripheral refuses to start the transfers.
+ * 
+ * The stalled task is requested to reinitialize its peripheral and the DMA
+ * channels and is woken up. The supervisor doesn't touch the peripheral
+ * itself: the task may be only preempted in the middle of a HAL call.
+ * If the task is still stalled on the next check, the watchdog is not
+ * refreshed anymore and resets the MCU.
+ * 
+ * @param arg Arguments. Unused
+ */
+static void supervisor_task(void *arg)
+{
+    UNUSED(arg);
+
+#if UART_SPI_SUPERVISOR_IWDG
+    iwdg_start();
+#endif
+
+    while (1) {
+        osDelay(SUPERVISOR_PERIOD_MS);
+
+        if (bridge_state == BRIDGE_RUNNING && !supervisor_escalated) {
+            // The SPI task polls the slave continuously, so it has always the work to do
+            bool uart_stalled = supervisor_task_stalled(&uart_health,
+                uart_spi_ring_used(&spi_rx_queue) > 0 ||
+                osMessageQueueGetCount(inject_queues[UART_SPI_DIR_SPI_TO_UART]) > 0);
+            bool spi_stalled = supervisor_task_stalled(&spi_health, true);
+
+            if ((uart_stalled && uart_health.recovered) || (spi_stalled && spi_health.recovered)) {
+                // The recovery didn't help
+                supervisor_escalate();
+            }
+
+            // The transfer waits end by their deadlines, the notification ends the idle waits
+            if (uart_stalled) {
+                stats.uart_stalls++;
+
+                uart_health.recover_requested = true;
+                xTaskNotify((TaskHandle_t)uart_task_handle, 0, eNoAction);
+            }
+
+            if (spi_stalled) {
+                stats.spi_stalls++;
+
+                spi_health.recover_requested = true;
+                xTaskNotify((TaskHandle_t)spi_task_handle, 0, eNoAction);
+            }
+
+            if (uart_stalled || spi_stalled) {
+                stats.last_recovery_tick = osKernelGetTickCount();
+            }
+
+            uart_health.recovered = uart_stalled;
+            spi_health.recovered = spi_stalled;
+        }
+
+        // The load is measured over the fixed window, so the readers don't shorten it for each other
+        if (osKernelGetTickCount() - load_update_tick >= pdMS_TO_TICKS(LOAD_WINDOW_MS)) {
+            load_update_tick = osKernelGetTickCount();
+            load_stats_update();
+        }
+
+#if UART_SPI_SUPERVISOR_IWDG
+        if (!supervisor_escalated) {
+            iwdg_refresh();
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Check if the bridge task is stalled since the previous check
+ * 
+ * @param health The task progress
+ * @param work_pending The task has the data to process
+ */
+static bool supervisor_task_stalled(task_health_t *health, bool work_pending)
+{
+    uint32_t heartbeat = health->heartbeat;
+    bool progress = heartbeat != health->last_heartbeat;
+
+    health->last_heartbeat = heartbeat;
+
+    if (health->start_failures >= SUPERVISOR_START_FAILURES) {
+        // The peripheral is stuck in the busy state
+        return true;
+    }
+
+    if (progress || !work_pending) {
+        return false;
+    }
+
+    uint32_t deadline = health->deadline;
+    if (deadline == 0) {
+        return true;
+    }
+
+    // The transfer completion is lost and the task wait is not limited anymore
+    return (int32_t)(osKernelGetTickCount() - deadline) > (int32_t)pdMS_TO_TICKS(SUPERVISOR_PERIOD_MS);
+}
+
+/**
+ * @brief Give up the recovery and reset the MCU
+ * 
+ */
+static void supervisor_escalate(void)
+{
+    supervisor_escalated = true;
+
+#if UART_SPI_SUPERVISOR_IWDG
+    // The watchdog is not refreshed anymore
+#else
+    NVIC_SystemReset();
+#endif
+}
+
+#if UART_SPI_SUPERVISOR_IWDG
+
+static void iwdg_start(void)
+{
+    IWDG->KR = 0xCCCC;          // Start the watchdog. LSI is enabled by hardware
+    IWDG->KR = 0x5555;          // Enable the registers access
+    IWDG->PR = 3;               // LSI / 32
+    IWDG->RLR = IWDG_TIMEOUT_MS;
+
+    while (IWDG->SR != 0) {
+        // Wait for the registers update
+    }
+
+    iwdg_refresh();
+}
+
+static void iwdg_refresh(void)
+{
+    IWDG->KR = 0xAAAA;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Update the CPU load and stack usage statistics
+ * 
+ * Called by the supervisor once per \ref LOAD_WINDOW_MS.
+ * The load is calculated over the time since the previous update
+ */
+static void load_stats_update(void)
+{
+    uint32_t total = portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t isr = isr_run_time;
+
+    uint32_t total_delta = total - load_prev_total;
+
+    stats.isr_load = load_permille(isr - load_prev_isr, total_delta);
+
+    load_prev_total = total;
+    load_prev_isr = isr;
+
+    TaskStatus_t info;
+
+    stats.uart_task_load = 0;
+    stats.spi_task_load = 0;
+
+    if (bridge_state != BRIDGE_RUNNING) {
+        return;
+    }
+
+    vTaskGetInfo((TaskHandle_t)uart_task_handle, &info, pdTRUE, eInvalid);
+    stats.uart_task_load = load_permille(info.ulRunTimeCounter - load_prev_uart_task, total_delta);
+    stats.uart_task_stack_free = info.usStackHighWaterMark * sizeof(StackType_t);
+    load_prev_uart_task = info.ulRunTimeCounter;
+
+    vTaskGetInfo((TaskHandle_t)spi_task_handle, &info, pdTRUE, eInvalid);
+    stats.spi_task_load = load_permille(info.ulRunTimeCounter - load_prev_spi_task, total_delta);
+    stats.spi_task_stack_free = info.usStackHighWaterMark * sizeof(StackType_t);
+    load_prev_spi_task = info.ulRunTimeCounter;
+}
+
+/**
+ * @brief Calculate the load in 0.1 % units
+ * 
+ * @param time The busy time
+ * @param total The total time
+ */
+static uint16_t load_permille(uint32_t time, uint32_t total)
+{
+    // Avoid the 32-bit overflow
+    total /= 1000;
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t load = time / total;
+
+    return load > 1000 ? 1000 : load;
 }
@@ -10,8 +10,81 @@
 #include "usart.h"
 #include "spi.h"
 
+#include <stdbool.h>
+
+// ============================================================================
+
+// The number of the forwarded transfer length histogram buckets.
+// Bucket n counts the lengths from 2^n to 2^(n+1)-1, the last one counts the rest
+#define UART_SPI_HIST_BUCKETS   8
+
+// The trailer the failed message CRC is replaced by in the \ref UART_SPI_CRC_FLAG mode.
+// Not hex digits, so the peer check fails too
+#define UART_SPI_CRC_FLAG_MARK  "CRC-FAIL"
+
+// ----------------------------------------------------------------------------
+// Compile-time specialisation. The defaults build the generic module
+
+// Bind the module to the HAL handles at compile time, e.g. -DUART_SPI_HUART=huart1 -DUART_SPI_HSPI=hspi1.
+// The handle addresses become constants instead of the pointers loaded on each access.
+// The handles passed to the \ref uart_spi_start must be the same
+// #define UART_SPI_HUART          huart1
+// #define UART_SPI_HSPI           hspi1
+
+// Fix the transfer chunk size, so the transfer loops use a constant.
+// The \ref uart_spi_tunables_set accepts this chunk size only
+// #define UART_SPI_CHUNK_SIZE     128
+
+// The tap observer. 0 - the publishing is compiled out and the tap API returns the error
+#ifndef UART_SPI_TAP
+#define UART_SPI_TAP            1
+#endif
+
+// The supervisor escalation through the independent watchdog instead of the software reset.
+// WARNING: the IWDG can't be stopped once started. The supervisor task starts it on the first
+// \ref uart_spi_start and refreshes it for good, also after \ref uart_spi_stop. The MCU is reset
+// 500 ms after anything keeps the supervisor from running: a higher priority task or a critical
+// section that long, the debugger halt (unless the IWDG is frozen in DBG_APB_FZ2), the Stop mode
+// (unless the IWDG is frozen by the option bytes)
+#ifndef UART_SPI_SUPERVISOR_IWDG
+#define UART_SPI_SUPERVISOR_IWDG 0
+#endif
+
 // ============================================================================
 
+/**
+ * @brief The policy of the string received from UART with errors
+ * 
+ */
+typedef enum {
+    UART_SPI_RX_ERROR_FORWARD = 0,  /// Forward the corrupted string as is
+    UART_SPI_RX_ERROR_DISCARD,      /// Discard the rest of the corrupted string. The terminator is forwarded
+} uart_spi_rx_error_policy_t;
+
+/**
+ * @brief The message CRC trailer mode
+ * 
+ * The trailer is the CRC-32 (zlib) of the message bytes written as 8 hex digits
+ * right before the terminator. It is generated by the peers and checked by the module
+ * in both directions. The module generates it for its own strings with
+ * \ref uart_spi_params_t::crc_generate
+ */
+typedef enum {
+    UART_SPI_CRC_OFF = 0,           /// The messages are forwarded as is
+    UART_SPI_CRC_CHECK,             /// Count the messages with the wrong trailer
+    UART_SPI_CRC_FLAG,              /// Also replace the wrong trailer by \ref UART_SPI_CRC_FLAG_MARK
+} uart_spi_crc_mode_t;
+
+/**
+ * @brief The UART line mode
+ * 
+ */
+typedef enum {
+    UART_SPI_LINK_FULL_DUPLEX = 0,  /// Separate RX and TX lines
+    UART_SPI_LINK_RS485,            /// RS-485 transceiver. The driver enable is driven by the USART DE pin
+    UART_SPI_LINK_HALF_DUPLEX,      /// Single wire on the TX pin. The own transmission is not received
+} uart_spi_link_t;
+
 /**
  * @brief \c uart-spi module parameters structure
  * 
@@ -19,8 +92,124 @@
 typedef struct {
     UART_HandleTypeDef *huart;  /// The pointer to the HAL UART handle
     SPI_HandleTypeDef *hspi;    /// The pointer to the HAL SPI handle
+    uart_spi_rx_error_policy_t rx_error_policy;     /// UART parity, framing, noise and overrun errors policy
+    uart_spi_crc_mode_t crc_mode;                   /// Message CRC trailer check
+    bool crc_generate;          /// Append the CRC trailer to the strings the module originates: the management
+                                /// replies and the application messages. The zero-copy messages are copied then
+    bool reliable;              /// Selective repeat ARQ on the SPI-to-UART direction including the management
+                                /// replies and the application messages. See uart-spi-arq.h
+
+    uart_spi_link_t link;       /// The UART line mode
+    uint8_t rs485_address;      /// RS-485 node address 1 - 127. The node receives and transmits only while addressed.
+                                /// The bus data must be 7-bit. 0 - no addressing
+    uint8_t rs485_de_assert;    /// DE assertion time before the start bit in the sample time units (1/16 bit). 0 - 31
+    uint8_t rs485_de_deassert;  /// DE deassertion time after the stop bit in the sample time units (1/16 bit). 0 - 31
+
+    bool low_power;             /// Receive through the USART FIFO, so the USART keeps receiving in the Stop mode.
+                                /// USART1 or USART2 only. Not compatible with the RS-485 addressing
 } uart_spi_params_t;
 
+/**
+ * @brief Data flow direction
+ * 
+ */
+typedef enum {
+    UART_SPI_DIR_UART_TO_SPI = 0,   /// Data received from UART and forwarded to SPI
+    UART_SPI_DIR_SPI_TO_UART,       /// Data received from SPI and forwarded to UART
+    UART_SPI_DIR_COUNT
+} uart_spi_dir_t;
+
+/**
+ * @brief Read-only view of a forwarded data span
+ * 
+ * The view points directly to the module internal buffer. The data is valid
+ * only while the tap callback is executing.
+ */
+typedef struct {
+    uart_spi_dir_t dir;         /// The direction the data is forwarded
+    const uint8_t *data;        /// The pointer to the forwarded data
+    size_t length;              /// The data length in bytes
+} uart_spi_view_t;
+
+/**
+ * @brief Tap callback prototype
+ * 
+ * @param view The pointer to the forwarded data view
+ * @param ctx The user context passed to the \ref uart_spi_tap_register
+ */
+typedef void (*uart_spi_tap_callback_t)(const uart_spi_view_t *view, void *ctx);
+
+/**
+ * @brief Injected message release callback prototype
+ * 
+ * Called from the module task context once the message is completely transmitted
+ * (or failed) and the buffer is not accessed by DMA anymore.
+ * 
+ * @param data The pointer to the message passed to the send function
+ * @param ctx The user context passed to the send function
+ */
+typedef void (*uart_spi_release_callback_t)(const void *data, void *ctx);
+
+/**
+ * @brief \c uart-spi module statistics
+ * 
+ */
+typedef struct {
+    uint32_t tap_dropped;       /// Number of views not delivered because the observer was busy
+
+    uint32_t uart_parity_errors;    /// Number of UART parity errors
+    uint32_t uart_framing_errors;   /// Number of UART framing errors
+    uint32_t uart_noise_errors;     /// Number of UART noise errors
+    uint32_t uart_overrun_errors;   /// Number of UART overrun errors
+    uint32_t uart_dma_errors;       /// Number of UART TX DMA errors
+    uint32_t uart_rx_restarts;      /// Number of UART reception restarts after the blocking errors
+    uint32_t uart_rx_discarded;     /// Number of bytes discarded by the \ref UART_SPI_RX_ERROR_DISCARD policy
+
+    uint32_t uart_deadline_misses;  /// Number of UART transmissions not completed within the deadline
+    uint32_t spi_deadline_misses;   /// Number of SPI transactions not completed within the deadline
+    uint32_t uart_recoveries;       /// Number of UART reinitializations
+    uint32_t spi_recoveries;        /// Number of SPI reinitializations
+
+    uint32_t uart_stalls;           /// Number of UART task stalls detected by the supervisor
+    uint32_t spi_stalls;            /// Number of SPI task stalls detected by the supervisor
+    uint32_t last_recovery_tick;    /// The kernel tick of the last supervisor recovery
+    bool watchdog_reset;            /// The last MCU reset was caused by the watchdog
+
+    // CPU load over the last complete 1 s window. In 0.1 % units
+    uint16_t uart_task_load;        /// UART task CPU load
+    uint16_t spi_task_load;         /// SPI task CPU load
+    uint16_t isr_load;              /// UART, SPI and their DMA interrupts CPU load
+
+    uint32_t uart_task_stack_free;  /// UART task stack high-water mark. Minimum free stack in bytes
+    uint32_t spi_task_stack_free;   /// SPI task stack high-water mark. Minimum free stack in bytes
+
+    uint32_t uart_crc_errors;       /// Number of messages received from the UART with the wrong CRC trailer
+    uint32_t spi_crc_errors;        /// Number of messages received from the SPI with the wrong CRC trailer
+
+    uint32_t pool_exhausted;        /// Number of direction share exhaustions. UART bytes are dropped, SPI slave polling is paused
+    uint32_t pool_free_min;         /// The low-water mark of the free buffer arena blocks
+
+    uint32_t arq_retransmissions;   /// Number of the ARQ frames retransmitted to the UART
+    uint32_t arq_timeouts;          /// Number of the ARQ retransmission timeouts
+    uint32_t arq_window;            /// The current ARQ send window in frames
+    uint32_t arq_rto_ms;            /// The current ARQ retransmission timeout
+
+    uint32_t length_hist[UART_SPI_DIR_COUNT][UART_SPI_HIST_BUCKETS];  /// Forwarded transfer lengths per direction
+} uart_spi_stats_t;
+
+/**
+ * @brief \c uart-spi module run-time tunables
+ * 
+ */
+typedef struct {
+    uint32_t uart_baud;         /// UART baud rate. 0 - keep the peripheral configuration
+    uint32_t spi_prescaler;     /// SPI clock prescaler. 2 - 256, power of two. 0 - keep the peripheral configuration
+    uint32_t buffer_size;       /// Maximum share of the 3K buffer arena per direction in bytes. Multiple of 128, 512 - 2560
+    uint32_t chunk_size;        /// Maximum transfer length in bytes. 1 - 128
+    uint32_t batch_size;        /// UART transmission is delayed up to 2 ms until this many bytes are buffered. 1 - no batching
+    uint32_t poll_period_ms;    /// SPI slave poll period while the link is idle. 0 - continuous polling. Up to 1000
+} uart_spi_tunables_t;
+
 // ============================================================================
 
 /**
@@ -34,4 +223,176 @@ typedef struct {
  */
 int uart_spi_start(uart_spi_params_t *params);
 
+/**
+ * @brief Stop the \c uart-spi retranslator module
+ * 
+ * The UART reception is stopped first. Then the data already buffered
+ * in both directions is forwarded during \c drain_timeout_ms at most.
+ * The rest of the data is discarded, the peripherals are aborted and all
+ * the module objects are freed. The queued application messages are released.
+ * 
+ * @param drain_timeout_ms The maximum time to forward the buffered data.
+ * The function may take up to one transfer timeout longer
+ * @return 0 - on success, -1 - on error
+ */
+int uart_spi_stop(uint32_t drain_timeout_ms);
+
+/**
+ * @brief Wait until all the buffered data is passed to the peripherals
+ * 
+ * The module keeps running. Useful before the peripheral reconfiguration
+ * 
+ * @param timeout_ms The maximum time to wait
+ * @return 0 - on success, -1 - on error or timeout
+ */
+int uart_spi_drain(uint32_t timeout_ms);
+
+/**
+ * @brief Stop the module and start it again with the same parameters
+ * 
+ * Recovers the module after the peripheral lockup without the MCU reset
+ * 
+ * @param drain_timeout_ms See \ref uart_spi_stop
+ * @return 0 - on success, -1 - on error
+ */
+int uart_spi_restart(uint32_t drain_timeout_ms);
+
+/**
+ * @brief Check if the module has nothing to do until the next UART reception
+ * 
+ * The application may enter the Stop mode while it is true. Useful in the low power mode
+ * (\ref uart_spi_params_t::low_power), which wakes the MCU up on the UART reception.
+ * The SPI slave polling is paused in the Stop mode
+ * 
+ * @return true - no data is buffered and no transfer is in progress
+ */
+bool uart_spi_idle(void);
+
+/**
+ * @brief Register the forwarded data observer
+ * 
+ * Each span forwarded by the module is published to the observer as
+ * a read-only \ref uart_spi_view_t without copying. The data path never waits
+ * for the observer: while the previous view of the same direction
+ * has not been dispatched yet, the new views are dropped and counted
+ * in the \ref uart_spi_stats_t::tap_dropped
+ * 
+ * @param callback The observer callback. NULL to unregister
+ * @param ctx The user context passed to the callback
+ * @return 0 - on success, -1 - on error
+ * 
+ * @note Must be called after the \ref uart_spi_start
+ */
+int uart_spi_tap_register(uart_spi_tap_callback_t callback, void *ctx);
+
+/**
+ * @brief Check if the forwarded data observer is registered
+ * 
+ */
+bool uart_spi_tap_registered(void);
+
+/**
+ * @brief Wait for the published views and pass them to the observer callback
+ * 
+ * Must be called periodically from the observer task.
+ * The callback is executed in the context of the calling task.
+ * 
+ * @param timeout_ms The maximum time to wait for a view
+ * @return 0 - on success, -1 - on timeout or error
+ */
+int uart_spi_tap_dispatch(uint32_t timeout_ms);
+
+/**
+ * @brief Send the application message to the UART
+ * 
+ * The message is copied to the heap and transmitted as a whole between
+ * the strings forwarded from the SPI, so it is never interleaved with them.
+ * 
+ * @param data The pointer to the message. Normally the null terminated string
+ * including the terminator
+ * @param length The message length in bytes. Up to 65535
+ * @param timeout_ms The maximum time to wait for the free queue slot.
+ * 0 - non-blocking call
+ * @return 0 - on success, -1 - on error or timeout
+ */
+int uart_spi_send_to_uart(const void *data, size_t length, uint32_t timeout_ms);
+
+/**
+ * @brief Send the application message to the SPI
+ * 
+ * The same as \ref uart_spi_send_to_uart but the message is transmitted
+ * to the SPI between the strings forwarded from the UART
+ */
+int uart_spi_send_to_spi(const void *data, size_t length, uint32_t timeout_ms);
+
+/**
+ * @brief Send the application message to the UART without copying
+ * 
+ * The message is transmitted by DMA directly from the caller buffer.
+ * The buffer must stay untouched until the \c release callback is called.
+ * 
+ * @param data The pointer to the message
+ * @param length The message length in bytes. Up to 65535
+ * @param release The buffer release callback. Can be NULL
+ * @param ctx The user context passed to the \c release callback
+ * @param timeout_ms The maximum time to wait for the free queue slot.
+ * 0 - non-blocking call
+ * @return 0 - on success, -1 - on error or timeout.
+ * The \c release callback is not called on error
+ */
+int uart_spi_send_to_uart_zc(const void *data, size_t length,
+                             uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms);
+
+/**
+ * @brief Send the application message to the SPI without copying
+ * 
+ * The same as \ref uart_spi_send_to_uart_zc but the message is transmitted to the SPI
+ */
+int uart_spi_send_to_spi_zc(const void *data, size_t length,
+                            uart_spi_release_callback_t release, void *ctx, uint32_t timeout_ms);
+
+/**
+ * @brief Get the module statistics
+ * 
+ * Read-only. The CPU load and the stack high-water marks are updated by the supervisor
+ * once per second, so the callers don't disturb each other's measurement
+ * 
+ * @param stats The pointer to the \ref uart_spi_stats_t structure to be filled
+ */
+void uart_spi_get_stats(uart_spi_stats_t *stats);
+
+/**
+ * @brief Get the module tunables
+ * 
+ * @param tunables The pointer to the \ref uart_spi_tunables_t structure to be filled.
+ * \c uart_baud is the current UART baud rate once the module is started
+ */
+void uart_spi_tunables_get(uart_spi_tunables_t *tunables);
+
+/**
+ * @brief Set the module tunables
+ * 
+ * Can be called before the \ref uart_spi_start and while the module is running.
+ * The new UART baud rate and SPI prescaler are applied by the bridge tasks between
+ * the forwarded strings. The UART keeps the previous rate if it doesn't accept the new one
+ * 
+ * @param tunables The pointer to the \ref uart_spi_tunables_t structure
+ * @return 0 - on success, -1 - on invalid value
+ */
+int uart_spi_tunables_set(const uart_spi_tunables_t *tunables);
+
+/**
+ * @brief Mark the bridge interrupt handler entry for the ISR load measurement
+ * 
+ * Must be called at the beginning of the UART, SPI and their DMA IRQ handlers
+ */
+void uart_spi_isr_enter(void);
+
+/**
+ * @brief Mark the bridge interrupt handler exit for the ISR load measurement
+ * 
+ * Must be called at the end of the UART, SPI and their DMA IRQ handlers
+ */
+void uart_spi_isr_exit(void);
+
 #endif /* UART_SPI_H_ */
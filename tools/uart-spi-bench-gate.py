@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""Run the uart-spi benchmark scenarios and compare them with the baseline.
+
+The bridge is built with UART_SPI_BENCH=1 and its SPI slave echoes MOSI
+(or MOSI is wired to MISO). The scenarios are started by the `bench`
+management command and the results are compared with the baseline file.
+The gate fails when the byte rate drops or the p99 latency rises beyond
+the tolerance, or when any string is corrupted or lost.
+
+The gate loops the UART back itself for the s2u scenarios: it returns each
+benchmark string once. The looped strings are forwarded to the slave and
+echoed back as well, so these scenarios load both directions at once. They
+are paced below the UART line rate, which carries both the strings and the
+echo. Their latency includes the gate turnaround and is not checked.
+The idle scenario checks the CPU load of the bridge without the traffic.
+
+Usage:
+    uart-spi-bench-gate.py /dev/ttyUSB0 baseline.json [tolerance %]
+    uart-spi-bench-gate.py /dev/ttyUSB0 baseline.json --update
+
+Record the baseline on the reference board with --update and commit it.
+Configure the port first:
+
+    stty -F /dev/ttyUSB0 115200 raw
+"""
+
+import json
+import os
+import select
+import sys
+import time
+
+PREFIX = b"\x10\x10"
+
+# name: (direction, count, length min, length max, gap ms, window). None - idle
+SCENARIOS = {
+    "spi-flood": ("u2s", 2000, 100, 128, 0, 16),
+    "tiny-strings": ("u2s", 5000, 5, 8, 0, 16),
+    "mixed-lengths": ("u2s", 2000, 5, 256, 0, 8),
+    "paced": ("u2s", 500, 16, 64, 2, 1),
+    "uart-tiny": ("s2u", 1000, 5, 8, 10, 4),
+    "both-dirs": ("s2u", 1000, 32, 64, 20, 8),
+    "idle": None,
+}
+
+BENCH_FIELDS = ("byte_rate", "latency_p99_us")
+LOAD_FIELDS = ("uart_task_load", "spi_task_load", "isr_load")
+
+TOLERANCE_DEFAULT = 10
+
+# The load rise allowed over a near zero baseline, in 0.1 % units
+LOAD_SLACK = 5
+
+# The benchmark string sequence number length in hex digits
+HEADER_LENGTH = 4
+
+# The slave echoes the fragments of the forwarded strings as well. A fragment that looks like
+# a benchmark string is taken only this close ahead of the last looped one
+LOOP_AHEAD_MAX = 256
+
+# The time to wait for the command reply and for the benchmark end
+REPLY_TIMEOUT_S = 2
+BENCH_TIMEOUT_S = 120
+
+# The load is measured over the last complete 1 s window, so two of them pass without the traffic
+IDLE_TIME_S = 2.5
+
+
+class Port:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        self.rx = b""
+        self.loop = False
+        self.looped = None
+
+    def close(self):
+        os.close(self.fd)
+
+    def command(self, command):
+        """Send the management command. Return the reply lines and the ok status"""
+        os.write(self.fd, PREFIX + command.encode() + b"\0")
+
+        lines = []
+        deadline = time.monotonic() + REPLY_TIMEOUT_S
+
+        while True:
+            string = self.string(deadline)
+            if string is None:
+                raise TimeoutError("no reply to '%s'" % command)
+
+            # The forwarded strings are mixed with the replies
+            if not string.startswith(PREFIX):
+                self.forwarded(string)
+                continue
+
+            line = string[len(PREFIX):].decode(errors="replace").strip()
+            if line in ("ok", "err"):
+                return lines, line == "ok"
+
+            lines.append(line)
+
+    def pump(self, duration):
+        """Receive the forwarded strings for the given time"""
+        deadline = time.monotonic() + duration
+
+        while True:
+            string = self.string(deadline)
+            if string is None:
+                return
+            if not string.startswith(PREFIX):
+                self.forwarded(string)
+
+    def forwarded(self, string):
+        """Loop the benchmark string back once: its slave echo comes back too"""
+        if not self.loop:
+            return
+
+        header = string[:HEADER_LENGTH]
+        if len(header) < HEADER_LENGTH or any(digit not in b"0123456789abcdef" for digit in header):
+            return
+
+        # The sequence numbers are 16-bit
+        seq = int(header, 16)
+        if self.looped is not None and not 0 < (seq - self.looped) & 0xFFFF <= LOOP_AHEAD_MAX:
+            return
+
+        self.looped = seq
+        os.write(self.fd, string + b"\0")
+
+    def string(self, deadline):
+        while b"\0" not in self.rx:
+            timeout = deadline - time.monotonic()
+            if timeout <= 0 or not select.select([self.fd], [], [], timeout)[0]:
+                return None
+            self.rx += os.read(self.fd, 4096)
+
+        string, _, self.rx = self.rx.partition(b"\0")
+        return string
+
+
+def fields(lines):
+    return {name: int(value) for name, _, value in (line.partition("=") for line in lines)}
+
+
+def run(port, scenario):
+    if scenario is None:
+        port.pump(IDLE_TIME_S)
+
+        lines, ok = port.command("stats")
+        if not ok:
+            raise RuntimeError("stats: rejected")
+        return fields(lines)
+
+    args = " ".join(str(arg) for arg in scenario)
+
+    port.loop = scenario[0] == "s2u"
+    port.looped = None
+
+    try:
+        _, ok = port.command("bench " + args)
+        if not ok:
+            raise RuntimeError("bench %s: rejected" % args)
+
+        deadline = time.monotonic() + BENCH_TIMEOUT_S
+
+        while time.monotonic() < deadline:
+            port.pump(0.5)
+
+            lines, ok = port.command("bench")
+            if ok:
+                return fields(lines)
+    finally:
+        port.loop = False
+
+    raise TimeoutError("bench %s: not finished" % args)
+
+
+def check_idle(result, baseline, tolerance):
+    failures = []
+
+    for field in LOAD_FIELDS:
+        load_max = baseline[field] + max(baseline[field] * tolerance // 100, LOAD_SLACK)
+        if result[field] > load_max:
+            failures.append("%s %d > %d" % (field, result[field], load_max))
+
+    return failures
+
+
+def check(name, result, baseline, tolerance):
+    if SCENARIOS[name] is None:
+        return check_idle(result, baseline, tolerance) if baseline is not None else ["no baseline"]
+
+    failures = []
+
+    if result["corrupted"] or result["lost"]:
+        failures.append("%d corrupted, %d lost" % (result["corrupted"], result["lost"]))
+
+    if baseline is None:
+        return failures + ["no baseline"]
+
+    rate_min = baseline["byte_rate"] * (100 - tolerance) // 100
+    if result["byte_rate"] < rate_min:
+        failures.append("byte rate %d < %d" % (result["byte_rate"], rate_min))
+
+    if SCENARIOS[name][0] == "s2u":
+        return failures
+
+    p99_max = baseline["latency_p99_us"] * (100 + tolerance) // 100
+    if result["latency_p99_us"] > p99_max:
+        failures.append("p99 latency %d us > %d us" % (result["latency_p99_us"], p99_max))
+
+    return failures
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) not in (2, 3):
+        print(__doc__, file=sys.stderr)
+        return 2
+
+    port_path, baseline_path = args[0], args[1]
+    update = len(args) == 3 and args[2] == "--update"
+    tolerance = int(args[2]) if len(args) == 3 and not update else TOLERANCE_DEFAULT
+
+    port = Port(port_path)
+    try:
+        results = {name: run(port, scenario) for name, scenario in SCENARIOS.items()}
+    finally:
+        port.close()
+
+    if update:
+        with open(baseline_path, "w") as baseline_file:
+            json.dump({name: {field: result[field] for field in (BENCH_FIELDS if SCENARIOS[name] else LOAD_FIELDS)}
+                       for name, result in results.items()}, baseline_file, indent=4, sort_keys=True)
+            baseline_file.write("\n")
+        return 0
+
+    with open(baseline_path) as baseline_file:
+        baseline = json.load(baseline_file)
+
+    failed = False
+
+    for name, result in results.items():
+        failures = check(name, result, baseline.get(name), tolerance)
+        failed = failed or bool(failures)
+
+        if SCENARIOS[name] is None:
+            summary = "load uart %d  spi %d  isr %d (0.1 %%)" % tuple(result[field] for field in LOAD_FIELDS)
+        else:
+            summary = "%8d B/s  p50 %6d us  p99 %6d us" % (
+                result["byte_rate"], result["latency_p50_us"], result["latency_p99_us"])
+
+        print("%-14s %-40s %s" % (name, summary, "; ".join(failures) if failures else "ok"))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Convert and replay the uart-spi traffic capture.
+
+The dump is produced by uart_spi_capture_dump() (the `capture` management command).
+The capture file is the magic b"USC1" followed by the span records:
+
+    <timestamp us: 4 bytes LE> <direction << 15 | length: 2 bytes LE> <data>
+
+The direction is 0 for UART-to-SPI and 1 for SPI-to-UART.
+
+Usage:
+    uart-spi-capture.py convert dump.txt capture.usc
+    uart-spi-capture.py show capture.usc
+    uart-spi-capture.py replay capture.usc /dev/ttyUSB0 [scale]
+
+The replay writes the UART-to-SPI spans to the port keeping the original gaps
+multiplied by the scale (1 by default, 0 - back to back). Configure the port first:
+
+    stty -F /dev/ttyUSB0 115200 raw
+"""
+
+import struct
+import sys
+import time
+
+MAGIC = b"USC1"
+HEADER = struct.Struct("<IH")
+
+DIRECTIONS = {0: "u2s", 1: "s2u"}
+
+
+def parse_dump(lines):
+    """Return the spans as (timestamp, direction, data) and the number of the lost spans"""
+    spans = []
+    lost = 0
+
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+
+        kind, _, rest = line.partition(" ")
+        if kind == "L":
+            lost = int(rest)
+        elif kind == "S":
+            timestamp, direction, length = rest.split()
+            spans.append([int(timestamp, 16), int(direction), int(length), bytearray()])
+        elif kind == "D" and spans:
+            spans[-1][3] += bytes.fromhex(rest)
+
+    result = []
+    for timestamp, direction, length, data in spans:
+        if len(data) != length:
+            raise ValueError("span at %08x: %d bytes of %d" % (timestamp, len(data), length))
+        result.append((timestamp, direction, bytes(data)))
+
+    return result, lost
+
+
+def write_capture(path, spans):
+    with open(path, "wb") as capture:
+        capture.write(MAGIC)
+        for timestamp, direction, data in spans:
+            capture.write(HEADER.pack(timestamp, direction << 15 | len(data)))
+            capture.write(data)
+
+
+def read_capture(path):
+    with open(path, "rb") as capture:
+        content = capture.read()
+
+    if content[:len(MAGIC)] != MAGIC:
+        raise ValueError("%s: not a capture file" % path)
+
+    spans = []
+    offset = len(MAGIC)
+
+    while offset < len(content):
+        timestamp, info = HEADER.unpack_from(content, offset)
+        offset += HEADER.size
+        length = info & 0x7FFF
+        spans.append((timestamp, info >> 15, content[offset:offset + length]))
+        offset += length
+
+    return unwrap(spans)
+
+
+def unwrap(spans):
+    """Extend the 32-bit microsecond timestamps"""
+    result = []
+    offset = 0
+    prev = None
+
+    for timestamp, direction, data in spans:
+        if prev is not None and timestamp < prev:
+            offset += 1 << 32
+        prev = timestamp
+        result.append((timestamp + offset, direction, data))
+
+    return result
+
+
+def convert(dump_path, capture_path):
+    with open(dump_path) as dump:
+        spans, lost = parse_dump(dump)
+
+    write_capture(capture_path, spans)
+
+    print("%d spans, %d lost" % (len(spans), lost), file=sys.stderr)
+
+
+def show(capture_path):
+    spans = read_capture(capture_path)
+    start = spans[0][0] if spans else 0
+
+    for timestamp, direction, data in spans:
+        print("%12.6f %s %4d %r" % ((timestamp - start) / 1e6, DIRECTIONS[direction], len(data), data))
+
+
+def replay(capture_path, port_path, scale):
+    spans = [span for span in read_capture(capture_path) if span[1] == 0]
+    if not spans:
+        return
+
+    sent = 0
+    first = spans[0][0]
+    start = time.monotonic()
+
+    with open(port_path, "wb", buffering=0) as port:
+        for timestamp, _, data in spans:
+            delay = start + (timestamp - first) * scale / 1e6 - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+            port.write(data)
+            sent += len(data)
+
+    elapsed = time.monotonic() - start
+    print("%d spans, %d bytes in %.3f s" % (len(spans), sent, elapsed), file=sys.stderr)
+
+
+def main():
+    args = sys.argv[1:]
+
+    if len(args) == 3 and args[0] == "convert":
+        convert(args[1], args[2])
+    elif len(args) == 2 and args[0] == "show":
+        show(args[1])
+    elif len(args) in (3, 4) and args[0] == "replay":
+        replay(args[1], args[2], float(args[3]) if len(args) == 4 else 1.0)
+    else:
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
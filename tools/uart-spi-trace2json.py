@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Convert the uart-spi trace dump to the Chrome trace JSON.
+
+The dump is produced by uart_spi_trace_dump(). Open the result
+in chrome://tracing or https://ui.perfetto.dev
+
+Usage: uart-spi-trace2json.py dump.txt > trace.json
+"""
+
+import json
+import sys
+
+ISR_ENTER = 1
+ISR_EXIT = 2
+DMA_START = 3
+DMA_COMPLETE = 4
+STREAM_SEND = 5
+STREAM_RECEIVE = 6
+TASK_SWITCH = 7
+
+DIRECTIONS = {0: "UART-to-SPI", 1: "SPI-to-UART"}
+
+PID = 1
+TID_TASKS = 1
+TID_ISR = 2
+TID_DMA = 10        # + direction
+TID_STREAM = 20     # + direction
+
+
+def parse(lines):
+    tasks = {}
+    events = []
+
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+
+        kind, _, rest = line.partition(" ")
+        if kind == "T":
+            number, _, name = rest.partition(" ")
+            tasks[int(number)] = name
+        elif kind == "E":
+            timestamp = int(rest[0:8], 16)
+            events.append((timestamp, int(rest[8:10], 16), int(rest[10:12], 16), int(rest[12:16], 16)))
+
+    return tasks, events
+
+
+def unwrap(events):
+    """Extend the 32-bit microsecond timestamps"""
+    result = []
+    offset = 0
+    prev = None
+
+    for timestamp, kind, arg8, arg16 in events:
+        if prev is not None and timestamp < prev:
+            offset += 1 << 32
+        prev = timestamp
+        result.append((timestamp + offset, kind, arg8, arg16))
+
+    return result
+
+
+def convert(tasks, events):
+    trace = [
+        {"ph": "M", "pid": PID, "name": "process_name", "args": {"name": "uart-spi"}},
+        {"ph": "M", "pid": PID, "tid": TID_TASKS, "name": "thread_name", "args": {"name": "Tasks"}},
+        {"ph": "M", "pid": PID, "tid": TID_ISR, "name": "thread_name", "args": {"name": "Interrupts"}},
+    ]
+
+    for direction, name in DIRECTIONS.items():
+        trace.append({"ph": "M", "pid": PID, "tid": TID_DMA + direction,
+                      "name": "thread_name", "args": {"name": "DMA " + name}})
+        trace.append({"ph": "M", "pid": PID, "tid": TID_STREAM + direction,
+                      "name": "thread_name", "args": {"name": "Ring " + name}})
+
+    running = None
+    dma_started = {}
+
+    for timestamp, kind, arg8, arg16 in events:
+        if kind == TASK_SWITCH:
+            if running is not None:
+                number, start = running
+                trace.append({"ph": "X", "pid": PID, "tid": TID_TASKS, "ts": start, "dur": timestamp - start,
+                              "name": tasks.get(number, "task %d" % number)})
+            running = (arg8, timestamp)
+
+        elif kind == ISR_ENTER:
+            trace.append({"ph": "B", "pid": PID, "tid": TID_ISR, "ts": timestamp, "name": "IRQ %d" % (arg8 - 16)})
+
+        elif kind == ISR_EXIT:
+            trace.append({"ph": "E", "pid": PID, "tid": TID_ISR, "ts": timestamp})
+
+        elif kind == DMA_START:
+            dma_started[arg8] = (timestamp, arg16)
+
+        elif kind == DMA_COMPLETE:
+            if arg8 in dma_started:
+                start, length = dma_started.pop(arg8)
+                trace.append({"ph": "X", "pid": PID, "tid": TID_DMA + arg8, "ts": start, "dur": timestamp - start,
+                              "name": "DMA %d bytes" % length, "args": {"length": length}})
+
+        elif kind in (STREAM_SEND, STREAM_RECEIVE):
+            name = "send" if kind == STREAM_SEND else "receive"
+            trace.append({"ph": "i", "s": "t", "pid": PID, "tid": TID_STREAM + arg8, "ts": timestamp,
+                          "name": "%s %d" % (name, arg16), "args": {"length": arg16}})
+
+    return trace
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    with open(sys.argv[1]) as dump:
+        tasks, events = parse(dump)
+
+    json.dump({"traceEvents": convert(tasks, unwrap(events)), "displayTimeUnit": "ns"}, sys.stdout)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())